@@ -0,0 +1,136 @@
+// The batch kernels of LieAlgebraf as compute shaders. Every buffer is a
+// structure of arrays like the CPU views, component k of element i is at
+// k * params.stride + i.
+
+struct Params {
+	count: u32,
+	stride: u32,
+};
+
+@group(0) @binding(0) var<uniform> params: Params;
+@group(0) @binding(1) var<storage, read> lhs: array<f32>;
+@group(0) @binding(2) var<storage, read> rhs: array<f32>;
+@group(0) @binding(3) var<storage, read_write> result: array<f32>;
+
+const WORKGROUP_SIZE = 64u;
+
+// The single precision tolerances of LieAlgebraf
+const TOLERANCE = 0.000001;
+const SMALL_ANGLE = 0.01;
+
+// Batches of more than 65535 workgroups carry on along y
+fn elementIndex(id: vec3u, groups: vec3u) -> u32 {
+	return id.x + id.y * groups.x * WORKGROUP_SIZE;
+}
+
+// Rotation vector of each row major matrix in lhs
+@compute @workgroup_size(WORKGROUP_SIZE)
+fn logarithmic_map(@builtin(global_invocation_id) id: vec3u,
+                   @builtin(num_workgroups) groups: vec3u) {
+	let i = elementIndex(id, groups);
+	if (i >= params.count) {
+		return;
+	}
+	var R: array<f32, 9>;
+	for (var k = 0u; k < 9u; k++) {
+		R[k] = lhs[k * params.stride + i];
+	}
+
+	// The skew part is sin(theta) axis and the trace gives cos(theta)
+	let cosTheta = (R[0] + R[4] + R[8] - 1.0) * 0.5;
+	let a = vec3f(R[7] - R[5], R[2] - R[6], R[3] - R[1]) * 0.5;
+	let sinTheta = length(a);
+	let theta = atan2(sinTheta, cosTheta);
+
+	var w: vec3f;
+	if (cosTheta >= -0.5) {
+		// theta / sin(theta), which is 0 / 0 at the identity
+		let theta2 = theta * theta;
+		let series = 1.0 + theta2 * (1.0 / 6.0 + theta2 * (7.0 / 360.0));
+		w = select(theta / max(sinTheta, TOLERANCE), series,
+		           theta < SMALL_ANGLE) * a;
+	} else {
+		// Near pi the axis comes from the symmetric part, pivoting on its
+		// largest diagonal term
+		let inverseOneMinusCos = 1.0 / max(1.0 - cosTheta, TOLERANCE);
+		let d = max((vec3f(R[0], R[4], R[8]) - cosTheta) * inverseOneMinusCos,
+		            vec3f(0.0));
+		let pivot = sqrt(max(d.x, max(d.y, d.z)));
+		let inverseDenom = 0.5 * inverseOneMinusCos / pivot;
+		let u01 = (R[1] + R[3]) * inverseDenom;
+		let u02 = (R[2] + R[6]) * inverseDenom;
+		let u12 = (R[5] + R[7]) * inverseDenom;
+		var u: vec3f;
+		if (d.x >= d.y && d.x >= d.z) {
+			u = vec3f(pivot, u01, u02);
+		} else if (d.y >= d.z) {
+			u = vec3f(u01, pivot, u12);
+		} else {
+			u = vec3f(u02, u12, pivot);
+		}
+		// Oriented to agree with whatever skew part is left
+		w = select(theta, -theta, dot(u, a) < 0.0) * u;
+	}
+
+	for (var k = 0u; k < 3u; k++) {
+		result[k * params.stride + i] = w[k];
+	}
+}
+
+// Rodrigues' formula R = I + A [w]x + B [w]x^2 of each rotation vector in lhs
+@compute @workgroup_size(WORKGROUP_SIZE)
+fn exponential_map(@builtin(global_invocation_id) id: vec3u,
+                   @builtin(num_workgroups) groups: vec3u) {
+	let i = elementIndex(id, groups);
+	if (i >= params.count) {
+		return;
+	}
+	let w = vec3f(lhs[i], lhs[params.stride + i], lhs[2u * params.stride + i]);
+
+	// Series for small angles, where A and B are both 0 / 0, and
+	// sin^2 / (1 + cos) where 1 - cos cancels
+	let theta2 = dot(w, w);
+	let theta = sqrt(theta2);
+	let sinTheta = sin(theta);
+	let cosTheta = cos(theta);
+	let small = theta < SMALL_ANGLE;
+	let safeTheta = max(theta, SMALL_ANGLE);
+	let A = select(sinTheta / safeTheta, 1.0 - theta2 / 6.0, small);
+	let oneMinusCos = select(1.0 - cosTheta,
+	                         sinTheta * sinTheta / (1.0 + cosTheta),
+	                         cosTheta > 0.0);
+	let B = select(oneMinusCos / (safeTheta * safeTheta),
+	               0.5 - theta2 / 24.0, small);
+
+	// [w]x^2 = w w^T - theta^2 I
+	let Bxy = B * w.x * w.y;
+	let Bxz = B * w.x * w.z;
+	let Byz = B * w.y * w.z;
+	let Aw = A * w;
+	var R = array<f32, 9>(
+		1.0 + B * (w.x * w.x - theta2), Bxy - Aw.z, Bxz + Aw.y,
+		Bxy + Aw.z, 1.0 + B * (w.y * w.y - theta2), Byz - Aw.x,
+		Bxz - Aw.y, Byz + Aw.x, 1.0 + B * (w.z * w.z - theta2));
+
+	for (var k = 0u; k < 9u; k++) {
+		result[k * params.stride + i] = R[k];
+	}
+}
+
+// Hamilton product lhs * rhs of w, x, y, z quaternions
+@compute @workgroup_size(WORKGROUP_SIZE)
+fn compose(@builtin(global_invocation_id) id: vec3u,
+           @builtin(num_workgroups) groups: vec3u) {
+	let i = elementIndex(id, groups);
+	if (i >= params.count) {
+		return;
+	}
+	let s = params.stride;
+	let a = vec4f(lhs[i], lhs[s + i], lhs[2u * s + i], lhs[3u * s + i]);
+	let b = vec4f(rhs[i], rhs[s + i], rhs[2u * s + i], rhs[3u * s + i]);
+
+	result[i] = a.x * b.x - a.y * b.y - a.z * b.z - a.w * b.w;
+	result[s + i] = a.x * b.y + a.y * b.x + a.z * b.w - a.w * b.z;
+	result[2u * s + i] = a.x * b.z - a.y * b.w + a.z * b.x + a.w * b.y;
+	result[3u * s + i] = a.x * b.w + a.y * b.z - a.z * b.y + a.w * b.x;
+}
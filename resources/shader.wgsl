@@ -2,6 +2,10 @@ struct VertexInput {
 	@location(0) position: vec3f,
 	@location(1) normal: vec3f, // new attribute
 	@location(2) color: vec3f,
+	// Per instance w, x, y, z quaternion, the identity unless glyphs are drawn
+	@location(3) orientation: vec4f,
+	// Per instance stretch along z, on top of the uniform one
+	@location(4) length: f32,
 };
 
 struct VertexOutput {
@@ -17,7 +21,9 @@ struct MyUniforms {
     projectionMatrix: mat4x4f,
     viewMatrix: mat4x4f,
     modelMatrix: mat4x4f,
-	rotation: mat4x4f,
+	// Rigid transform as a w, x, y, z dual quaternion real + eps dual
+	real: vec4f,
+	dual: vec4f,
     color: vec4f,
     zScalar: f32,
 };
@@ -25,15 +31,28 @@ struct MyUniforms {
 // Instead of the simple uTime variable, our uniform variable is a struct
 @group(0) @binding(0) var<uniform> uMyUniforms: MyUniforms;
 
+// Rotates v by the unit quaternion q = (w, x, y, z)
+fn rotate(q: vec4f, v: vec3f) -> vec3f {
+	let t = 2.0 * cross(q.yzw, v);
+	return v + q.x * t + cross(q.yzw, t);
+}
+
+// Translation of the unit dual quaternion r + eps d, the vector part of 2 d r*
+fn translation(r: vec4f, d: vec4f) -> vec3f {
+	return 2.0 * (r.x * d.yzw - d.x * r.yzw + cross(r.yzw, d.yzw));
+}
+
 @vertex
 fn vs_main(in: VertexInput) -> VertexOutput {
 	var pos: vec3f;
 	pos = in.position;
-	pos.z = pos.z * uMyUniforms.zScalar;
+	pos.z = pos.z * uMyUniforms.zScalar * in.length;
+	pos = rotate(in.orientation, pos);
+	pos = rotate(uMyUniforms.real, pos) + translation(uMyUniforms.real, uMyUniforms.dual);
 	var out: VertexOutput;
-	out.position = uMyUniforms.projectionMatrix * uMyUniforms.viewMatrix * uMyUniforms.modelMatrix * uMyUniforms.rotation * vec4f(pos, 1.0);
-	// Forward the normal
-    out.normal = (uMyUniforms.modelMatrix * uMyUniforms.rotation * vec4f(in.normal, 0.0)).xyz;
+	out.position = uMyUniforms.projectionMatrix * uMyUniforms.viewMatrix * uMyUniforms.modelMatrix * vec4f(pos, 1.0);
+	// Forward the normal, which only turns with the rotation
+    out.normal = (uMyUniforms.modelMatrix * vec4f(rotate(uMyUniforms.real, rotate(in.orientation, in.normal)), 0.0)).xyz;
 	out.color = in.color;
 	return out;
 }
@@ -0,0 +1,201 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <Eigen/QR>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Angular velocity of a stream of orientations sampled every dt, body frame
+// log(R_{k-1}^T R_k) / dt and world frame R_k times that, optionally smoothed
+// by a Savitzky-Golay filter on the tangent vectors. Orientations can be fed
+// in chunks of any size. The scratch is sized once at construction, so
+// process allocates nothing of its own.
+template <class Scalar> class BasicAngularVelocityEstimator {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+
+  // Orientations per pass of the kernels
+  static constexpr std::size_t CHUNK_SIZE = 1 << 12;
+
+public:
+  template <class T> using SO3Arrays = typename SO3::template SO3Arrays<T>;
+  template <class T>
+  using TangentArrays = typename SO3::template TangentArrays<T>;
+
+  // Smoothing fits a polynomial of polynomialOrder to the 2 halfWindow + 1
+  // velocities around each one, a halfWindow of 0 turns it off
+  BasicAngularVelocityEstimator(Scalar dt, std::size_t halfWindow = 0,
+                                std::size_t polynomialOrder = 2)
+      : mInverseDt(1 / dt), mHalfWindow(halfWindow) {
+    if (!(dt > 0)) {
+      throw std::runtime_error("Angular velocity needs a positive dt!");
+    }
+    if (halfWindow > 0 && 2 * halfWindow + 1 <= polynomialOrder) {
+      throw std::runtime_error(
+          "Savitzky-Golay smoothing needs more samples than coefficients!");
+    }
+    mCoefficients = savitzkyGolay(halfWindow, polynomialOrder);
+
+    // The history the window reaches back into is kept in front of the chunk,
+    // with one orientation more for the first velocity of the chunk
+    for (std::vector<Scalar> &entry : mOrientations) {
+      entry.resize(2 * halfWindow + 1 + CHUNK_SIZE);
+    }
+    for (std::vector<Scalar> &component : mVelocities) {
+      component.resize(2 * halfWindow + CHUNK_SIZE);
+    }
+    reset();
+  }
+
+  // Outputs lag the orientations by this many samples, the half window the
+  // smoothing needs ahead of each one
+  std::size_t delay() const { return mHalfWindow; }
+
+  // Writes count velocities, the i-th of which belongs to orientation
+  // i - delay() of this call. The stream is taken to be at rest before its
+  // first orientation, so smoothed velocities take a window to settle.
+  void process(const SO3Arrays<const Scalar> &orientations,
+               const TangentArrays<Scalar> &body,
+               const TangentArrays<Scalar> &world, std::size_t count) {
+    std::size_t history = 2 * mHalfWindow;
+    for (std::size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+      std::size_t size = std::min(CHUNK_SIZE, count - begin);
+
+      // The first orientation of the stream stands in for the ones before it,
+      // which makes their velocities 0
+      for (std::size_t k = 0; k < 9; ++k) {
+        const Scalar *source = orientations.entries[k] + begin;
+        if (!mIsStarted) {
+          std::fill_n(mOrientations[k].begin(), history + 1, *source);
+        }
+        std::copy(source, source + size,
+                  mOrientations[k].begin() + history + 1);
+      }
+      mIsStarted = true;
+
+      Kernels::parallelForEachPack(size, 21, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P previous[9];
+        P current[9];
+        P w[3];
+        for (std::size_t k = 0; k < 9; ++k) {
+          previous[k] = P::load(mOrientations[k].data() + history + index);
+          current[k] = P::load(mOrientations[k].data() + history + 1 + index);
+        }
+        velocityKernel(previous, current, P(mInverseDt), w);
+        for (std::size_t k = 0; k < 3; ++k) {
+          w[k].store(mVelocities[k].data() + history + index);
+        }
+      });
+
+      std::size_t numCoefficients = mCoefficients.size();
+      Kernels::parallelForEachPack(size, 15, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P w[3] = {P(0.0), P(0.0), P(0.0)};
+        for (std::size_t j = 0; j < numCoefficients; ++j) {
+          P coefficient = P(mCoefficients[j]);
+          for (std::size_t k = 0; k < 3; ++k) {
+            w[k] = w[k] +
+                   coefficient * P::load(mVelocities[k].data() + index + j);
+          }
+        }
+        P R[9];
+        for (std::size_t k = 0; k < 9; ++k) {
+          R[k] = P::load(mOrientations[k].data() + mHalfWindow + 1 + index);
+        }
+        P rotated[3];
+        rotateKernel(R, w, rotated);
+        for (std::size_t k = 0; k < 3; ++k) {
+          w[k].store(body.components[k] + begin + index);
+          rotated[k].store(world.components[k] + begin + index);
+        }
+      });
+
+      // The end of this chunk is the history of the next one
+      for (std::vector<Scalar> &entry : mOrientations) {
+        std::copy(entry.begin() + size, entry.begin() + size + history + 1,
+                  entry.begin());
+      }
+      for (std::vector<Scalar> &component : mVelocities) {
+        std::copy(component.begin() + size,
+                  component.begin() + size + history, component.begin());
+      }
+    }
+  }
+
+  // Starts a new stream
+  void reset() {
+    mIsStarted = false;
+    for (std::vector<Scalar> &component : mVelocities) {
+      std::fill(component.begin(), component.end(), Scalar(0));
+    }
+  }
+
+private:
+  Scalar mInverseDt;
+  std::size_t mHalfWindow;
+  std::vector<Scalar> mCoefficients;
+  bool mIsStarted = false;
+  std::array<std::vector<Scalar>, 9> mOrientations;
+  std::array<std::vector<Scalar>, 3> mVelocities;
+
+  // Weights that evaluate the least squares polynomial through 2 halfWindow + 1
+  // evenly spaced samples at the middle one, the first row of the
+  // pseudoinverse of the Vandermonde matrix
+  static std::vector<Scalar> savitzkyGolay(std::size_t halfWindow,
+                                           std::size_t order) {
+    if (halfWindow == 0) {
+      return {Scalar(1)};
+    }
+    std::size_t size = 2 * halfWindow + 1;
+    Eigen::MatrixXd vandermonde(size, order + 1);
+    for (std::size_t row = 0; row < size; ++row) {
+      double x = static_cast<double>(row) - static_cast<double>(halfWindow);
+      double power = 1;
+      for (std::size_t column = 0; column <= order; ++column) {
+        vandermonde(row, column) = power;
+        power *= x;
+      }
+    }
+    Eigen::MatrixXd pseudoinverse =
+        vandermonde.colPivHouseholderQr().solve(Eigen::MatrixXd::Identity(
+            static_cast<Eigen::Index>(size), static_cast<Eigen::Index>(size)));
+
+    std::vector<Scalar> coefficients(size);
+    for (std::size_t j = 0; j < size; ++j) {
+      coefficients[j] = static_cast<Scalar>(pseudoinverse(0, j));
+    }
+    return coefficients;
+  }
+
+  template <class P>
+  static void velocityKernel(const P (&previous)[9], const P (&current)[9],
+                             P inverseDt, P (&w)[3]) {
+    P transpose[9];
+    P relative[9];
+    for (std::size_t k = 0; k < 9; ++k) {
+      transpose[k] = previous[(k % 3) * 3 + k / 3];
+    }
+    Kernels::multiplyKernel(transpose, current, relative);
+    Kernels::logarithmicMapKernel(relative, w);
+    for (std::size_t k = 0; k < 3; ++k) {
+      w[k] = w[k] * inverseDt;
+    }
+  }
+
+  template <class P>
+  static void rotateKernel(const P (&R)[9], const P (&v)[3], P (&result)[3]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      result[row] =
+          R[3 * row] * v[0] + R[3 * row + 1] * v[1] + R[3 * row + 2] * v[2];
+    }
+  }
+};
+
+using AngularVelocityEstimator = BasicAngularVelocityEstimator<double>;
+using AngularVelocityEstimatorf = BasicAngularVelocityEstimator<float>;
@@ -0,0 +1,392 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "Parallel.hpp"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Tuning of the attitude filters, each only reads its own
+template <class Scalar> struct AttitudeFilterParameters {
+  // Madgwick step along the normalised gradient, in rad/s
+  Scalar beta = Scalar(0.1);
+  // Mahony proportional and integral gains, in 1/s and 1/s^2
+  Scalar kp = Scalar(1.0);
+  Scalar ki = Scalar(0.05);
+  // Kalman gyro noise density in rad/s/sqrt(Hz), gyro bias random walk in
+  // rad/s^2/sqrt(Hz) and the spread of the measured directions, which also has
+  // to cover accelerations other than gravity and magnetic disturbances
+  Scalar gyroNoise = Scalar(0.005);
+  Scalar gyroBiasNoise = Scalar(0.0001);
+  Scalar accelerometerNoise = Scalar(0.1);
+  Scalar magnetometerNoise = Scalar(0.2);
+};
+
+// Orientation of an IMU from its gyro, accelerometer and optionally
+// magnetometer, sampled every dt. The orientation takes the body frame to a
+// world frame with z up and x towards magnetic north. Every method propagates
+// with the exponential map of the corrected rate and differs in how it pulls
+// the predicted gravity and north towards the measured ones. A step works on
+// fixed size values only, so filtering allocates nothing.
+template <class Scalar> class BasicAttitudeFilter {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Matrix6 = Eigen::Matrix<Scalar, 6, 6>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+public:
+  using Parameters = AttitudeFilterParameters<Scalar>;
+
+  enum class Method {
+    // Gradient descent on the direction errors, taken on the manifold so each
+    // step of size beta is a rotation about the steepest axis
+    Madgwick,
+    // Complementary filter, feeds the direction errors back into the rate
+    // through a PI controller whose integral tracks the gyro bias
+    Mahony,
+    // Error state Kalman filter on the local rotation error and the gyro bias,
+    // with the covariance carried in the tangent space
+    ErrorStateKalman
+  };
+
+  // Structure of arrays view over a batch of IMU samples in the body frame.
+  // Leave the magnetometer null when there is none.
+  template <class T> struct ImuArrays {
+    std::array<T *, 3> gyro;
+    std::array<T *, 3> accelerometer;
+    std::array<T *, 3> magnetometer;
+  };
+
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  BasicAttitudeFilter(Scalar dt, Method method,
+                      const Parameters &parameters = Parameters(),
+                      const Quaternion &initial = Quaternion::Identity())
+      : mDt(dt), mMethod(method), mParameters(parameters) {
+    if (!(dt > 0)) {
+      throw std::runtime_error("Attitude filters need a positive dt!");
+    }
+    reset(initial);
+  }
+
+  Method method() const { return mMethod; }
+
+  // One sample, gyro in rad/s and the others in any unit. A zero accelerometer
+  // or magnetometer is left out, so the step falls back on the gyro.
+  void update(const Vector3 &gyro, const Vector3 &accelerometer,
+              const Vector3 &magnetometer) {
+    switch (mMethod) {
+    case Method::Madgwick:
+      madgwick(gyro, accelerometer, magnetometer);
+      break;
+    case Method::Mahony:
+      mahony(gyro, accelerometer, magnetometer);
+      break;
+    case Method::ErrorStateKalman:
+      errorStateKalman(gyro, accelerometer, magnetometer);
+      break;
+    }
+  }
+
+  // Writes the orientation after each of count samples
+  void process(const ImuArrays<const Scalar> &imu,
+               const QuaternionArrays<Scalar> &orientations,
+               std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      update(sample(imu.gyro, i), sample(imu.accelerometer, i),
+             sample(imu.magnetometer, i));
+      orientations.components[0][i] = mOrientation.w();
+      orientations.components[1][i] = mOrientation.x();
+      orientations.components[2][i] = mOrientation.y();
+      orientations.components[3][i] = mOrientation.z();
+    }
+  }
+
+  // Runs numFilters filters over the same samples side by side, each on its
+  // own thread, writing into the orientations of the same index
+  static void processAll(BasicAttitudeFilter *filters,
+                         const QuaternionArrays<Scalar> *orientations,
+                         std::size_t numFilters,
+                         const ImuArrays<const Scalar> &imu,
+                         std::size_t count) {
+    ParallelDispatch::forEachChunk(numFilters, [&](std::size_t filter) {
+      filters[filter].process(imu, orientations[filter], count);
+    });
+  }
+
+  Quaternion orientation() const { return mOrientation; }
+
+  // Gyro bias the filter has settled on, zero for Madgwick which keeps none
+  Vector3 bias() const { return mBias; }
+
+  // Orientation that puts the measured gravity on z and the measured north in
+  // the xz plane, a starting point that spares the filters the time it takes
+  // them to converge from far away
+  static Quaternion align(const Vector3 &accelerometer,
+                          const Vector3 &magnetometer) {
+    if (accelerometer.squaredNorm() == 0) {
+      return Quaternion::Identity();
+    }
+    // The rows of the orientation are the world axes seen from the body
+    Vector3 up = accelerometer.normalized();
+    Vector3 north = magnetometer - magnetometer.dot(up) * up;
+    if (north.squaredNorm() == 0) {
+      north = up.unitOrthogonal();
+    }
+    north.normalize();
+    Matrix3 R;
+    R.row(0) = north.transpose();
+    R.row(1) = up.cross(north).transpose();
+    R.row(2) = up.transpose();
+    return SO3::matrixToQuaternion(R);
+  }
+
+  void reset(const Quaternion &initial = Quaternion::Identity()) {
+    mOrientation = initial.normalized();
+    mBias.setZero();
+    mCovariance.setZero();
+    mCovariance.diagonal() << Vector3::Constant(Scalar(0.1)),
+        Vector3::Constant(Scalar(0.0001));
+  }
+
+private:
+  Scalar mDt;
+  Method mMethod;
+  Parameters mParameters;
+  Quaternion mOrientation;
+  Vector3 mBias;
+  // Of the rotation error and then the bias error, Kalman only
+  Matrix6 mCovariance;
+
+  static Vector3 sample(const std::array<const Scalar *, 3> &components,
+                        std::size_t index) {
+    if (components[0] == nullptr) {
+      return Vector3::Zero();
+    }
+    return Vector3(components[0][index], components[1][index],
+                   components[2][index]);
+  }
+
+  static Matrix3 skew(const Vector3 &v) {
+    Matrix3 result;
+    result << 0, -v.z(), v.y(), v.z(), 0, -v.x(), -v.y(), v.x(), 0;
+    return result;
+  }
+
+  // Measured and predicted body frame directions of gravity and north, false
+  // for a sensor that reads zero
+  struct Directions {
+    bool hasGravity;
+    Vector3 measuredGravity;
+    Vector3 predictedGravity;
+    bool hasNorth;
+    Vector3 measuredNorth;
+    Vector3 predictedNorth;
+  };
+
+  Directions directions(const Vector3 &accelerometer,
+                        const Vector3 &magnetometer) const {
+    Matrix3 R = mOrientation.toRotationMatrix();
+    Directions result;
+    result.hasGravity = accelerometer.squaredNorm() > 0;
+    if (result.hasGravity) {
+      result.measuredGravity = accelerometer.normalized();
+      result.predictedGravity = R.row(2).transpose();
+    }
+    result.hasNorth = magnetometer.squaredNorm() > 0;
+    if (result.hasNorth) {
+      // The field dips into the ground, so north is wherever the measured
+      // field points once turned into the world and flattened onto xz
+      result.measuredNorth = magnetometer.normalized();
+      Vector3 field = R * result.measuredNorth;
+      Vector3 reference(std::hypot(field.x(), field.y()), 0, field.z());
+      result.predictedNorth = R.transpose() * reference;
+    }
+    return result;
+  }
+
+  // Sum of measured x predicted, the axis that turns the predictions onto the
+  // measurements in the body frame
+  static Vector3 directionError(const Directions &directions) {
+    Vector3 error = Vector3::Zero();
+    if (directions.hasGravity) {
+      error += directions.measuredGravity.cross(directions.predictedGravity);
+    }
+    if (directions.hasNorth) {
+      error += directions.measuredNorth.cross(directions.predictedNorth);
+    }
+    return error;
+  }
+
+  void propagate(const Vector3 &rate) {
+    mOrientation = SO3::compose(mOrientation,
+                                SO3::quaternionExponentialMap(rate * mDt))
+                       .normalized();
+  }
+
+  void madgwick(const Vector3 &gyro, const Vector3 &accelerometer,
+                const Vector3 &magnetometer) {
+    // The gradient of the squared direction errors over the right
+    // perturbation is minus the error axis
+    Vector3 error = directionError(directions(accelerometer, magnetometer));
+    Scalar norm = error.norm();
+    Vector3 rate = gyro;
+    if (norm > 0) {
+      rate += 2 * mParameters.beta / norm * error;
+    }
+    propagate(rate);
+  }
+
+  void mahony(const Vector3 &gyro, const Vector3 &accelerometer,
+              const Vector3 &magnetometer) {
+    Vector3 error = directionError(directions(accelerometer, magnetometer));
+    mBias -= mParameters.ki * mDt * error;
+    propagate(gyro - mBias + mParameters.kp * error);
+  }
+
+  void errorStateKalman(const Vector3 &gyro, const Vector3 &accelerometer,
+                        const Vector3 &magnetometer) {
+    // The error is local, q_true = q exp(error), so it turns back by the step
+    // and picks up minus the bias error times dt
+    Vector3 rate = gyro - mBias;
+    Quaternion step = SO3::quaternionExponentialMap(rate * mDt);
+    Matrix6 F = Matrix6::Identity();
+    F.template topLeftCorner<3, 3>() = step.toRotationMatrix().transpose();
+    F.template topRightCorner<3, 3>() = -mDt * Matrix3::Identity();
+    mCovariance = F * mCovariance * F.transpose();
+    mCovariance.template topLeftCorner<3, 3>().diagonal().array() +=
+        mParameters.gyroNoise * mParameters.gyroNoise * mDt;
+    mCovariance.template bottomRightCorner<3, 3>().diagonal().array() +=
+        mParameters.gyroBiasNoise * mParameters.gyroBiasNoise * mDt;
+    mOrientation = SO3::compose(mOrientation, step).normalized();
+
+    // The directions are corrected one after the other, each through the
+    // predicted one as R^T d, whose Jacobian over the error is [R^T d]x
+    Directions first = directions(accelerometer, magnetometer);
+    if (first.hasGravity) {
+      correct(first.measuredGravity, first.predictedGravity,
+              mParameters.accelerometerNoise);
+    }
+    Directions second = directions(accelerometer, magnetometer);
+    if (second.hasNorth) {
+      correct(second.measuredNorth, second.predictedNorth,
+              mParameters.magnetometerNoise);
+    }
+  }
+
+  void correct(const Vector3 &measured, const Vector3 &predicted,
+               Scalar noise) {
+    Eigen::Matrix<Scalar, 3, 6> H = Eigen::Matrix<Scalar, 3, 6>::Zero();
+    H.template leftCols<3>() = skew(predicted);
+    Matrix3 S = H * mCovariance * H.transpose() +
+                noise * noise * Matrix3::Identity();
+    Eigen::Matrix<Scalar, 6, 3> K = mCovariance * H.transpose() * S.inverse();
+    Eigen::Matrix<Scalar, 6, 1> error = K * (measured - predicted);
+
+    mCovariance = (Matrix6::Identity() - K * H) * mCovariance;
+    mCovariance = Scalar(0.5) * (mCovariance + mCovariance.transpose());
+    mOrientation = SO3::compose(mOrientation, SO3::quaternionExponentialMap(
+                                                  error.template head<3>()))
+                       .normalized();
+    mBias += error.template tail<3>();
+  }
+};
+
+// A raw IMU recording, one sample per line of a text file: the time in
+// seconds, the gyro in rad/s, the accelerometer and optionally the
+// magnetometer in any unit, separated by spaces, tabs or commas. Lines that
+// do not start with a number, like a header, are skipped.
+template <class Scalar> class BasicImuLog {
+public:
+  template <class T>
+  using ImuArrays =
+      typename BasicAttitudeFilter<Scalar>::template ImuArrays<T>;
+
+  explicit BasicImuLog(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      throw std::runtime_error("IMU log did not open!");
+    }
+
+    double firstTime = 0;
+    double lastTime = 0;
+    std::string line;
+    std::vector<double> values;
+    while (std::getline(file, line)) {
+      for (char &character : line) {
+        if (character == ',') {
+          character = ' ';
+        }
+      }
+      std::istringstream stream(line);
+      values.clear();
+      double value;
+      while (stream >> value) {
+        values.push_back(value);
+      }
+      if (values.empty()) {
+        continue;
+      }
+      if (values.size() != 7 && values.size() != 10) {
+        throw std::runtime_error("IMU log lines need 7 or 10 values!");
+      }
+      if (size() == 0) {
+        firstTime = values[0];
+        mHasMagnetometer = values.size() == 10;
+      } else if (mHasMagnetometer != (values.size() == 10)) {
+        throw std::runtime_error(
+            "IMU log lines all need a magnetometer or none!");
+      }
+      lastTime = values[0];
+      for (std::size_t k = 0; k < 3; ++k) {
+        mGyro[k].push_back(static_cast<Scalar>(values[1 + k]));
+        mAccelerometer[k].push_back(static_cast<Scalar>(values[4 + k]));
+        if (mHasMagnetometer) {
+          mMagnetometer[k].push_back(static_cast<Scalar>(values[7 + k]));
+        }
+      }
+    }
+    if (size() < 2 || !(lastTime > firstTime)) {
+      throw std::runtime_error("IMU log needs two samples forward in time!");
+    }
+    // Filters step at a fixed rate, the average one of the log
+    mDt = static_cast<Scalar>((lastTime - firstTime) / (size() - 1));
+  }
+
+  std::size_t size() const { return mGyro[0].size(); }
+
+  Scalar dt() const { return mDt; }
+
+  // The samples from begin on
+  ImuArrays<const Scalar> arrays(std::size_t begin = 0) const {
+    ImuArrays<const Scalar> result;
+    for (std::size_t k = 0; k < 3; ++k) {
+      result.gyro[k] = mGyro[k].data() + begin;
+      result.accelerometer[k] = mAccelerometer[k].data() + begin;
+      result.magnetometer[k] =
+          mHasMagnetometer ? mMagnetometer[k].data() + begin : nullptr;
+    }
+    return result;
+  }
+
+private:
+  Scalar mDt;
+  bool mHasMagnetometer = false;
+  std::array<std::vector<Scalar>, 3> mGyro;
+  std::array<std::vector<Scalar>, 3> mAccelerometer;
+  std::array<std::vector<Scalar>, 3> mMagnetometer;
+};
+
+using AttitudeFilter = BasicAttitudeFilter<double>;
+using AttitudeFilterf = BasicAttitudeFilter<float>;
+using ImuLog = BasicImuLog<double>;
+using ImuLogf = BasicImuLog<float>;
@@ -0,0 +1,188 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <Eigen/SVD>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// Mean and dispersion of large sets of rotations
+template <class Scalar> class BasicRotationAveraging {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+
+  // Every chunk is summed on its own and the chunk sums are then added in
+  // order, so the result does not depend on how many threads there are
+  static constexpr std::size_t CHUNK_SIZE = 1 << 14;
+
+public:
+  template <class T> using SO3Arrays = typename SO3::template SO3Arrays<T>;
+
+  struct Statistics {
+    Matrix3 mean;
+    // Covariance of log(mean^T R) over the set, the spread in the body frame
+    // of the mean
+    Matrix3 covariance;
+    int iterations;
+  };
+
+  // Projection of the arithmetic mean of the matrices back onto SO3, which
+  // minimises the sum of squared Frobenius (chordal) distances
+  static Matrix3 chordalMean(const SO3Arrays<const Scalar> &SO3Set,
+                             std::size_t count) {
+    std::array<Scalar, 9> sums = parallelSum<9>(
+        count, [&](auto tag, std::size_t index, auto &accumulators) {
+          using P = typename decltype(tag)::type;
+          P R[9];
+          Kernels::load(SO3Set.entries, index, R);
+          for (std::size_t k = 0; k < 9; ++k) {
+            accumulators[k] = accumulators[k] + R[k];
+          }
+        });
+
+    Matrix3 sum;
+    for (std::size_t k = 0; k < 9; ++k) {
+      sum(k / 3, k % 3) = sums[k];
+    }
+    return project(sum);
+  }
+
+  // Karcher (geodesic L2) mean by Gauss-Newton on the tangent space of the
+  // current estimate, starting from the chordal mean. Each iteration is one
+  // parallel pass over the set.
+  static Statistics
+  karcherMean(const SO3Arrays<const Scalar> &SO3Set, std::size_t count,
+              int maxIterations = 20,
+              Scalar convergence =
+                  std::sqrt(std::numeric_limits<Scalar>::epsilon())) {
+    Statistics statistics;
+    statistics.mean = chordalMean(SO3Set, count);
+    statistics.covariance = Matrix3::Zero();
+    statistics.iterations = 0;
+    if (count == 0) {
+      return statistics;
+    }
+
+    for (int iteration = 0; iteration < maxIterations; ++iteration) {
+      // First and second moments of the tangent vectors in one pass
+      Scalar meanTranspose[9];
+      for (std::size_t k = 0; k < 9; ++k) {
+        meanTranspose[k] = statistics.mean(k % 3, k / 3);
+      }
+      std::array<Scalar, 9> sums = parallelSum<9>(
+          count, [&](auto tag, std::size_t index, auto &accumulators) {
+            using P = typename decltype(tag)::type;
+            P R[9];
+            P M[9];
+            P relative[9];
+            P w[3];
+            Kernels::load(SO3Set.entries, index, R);
+            for (std::size_t k = 0; k < 9; ++k) {
+              M[k] = P(meanTranspose[k]);
+            }
+            Kernels::multiplyKernel(M, R, relative);
+            Kernels::logarithmicMapKernel(relative, w);
+            accumulators[0] = accumulators[0] + w[0];
+            accumulators[1] = accumulators[1] + w[1];
+            accumulators[2] = accumulators[2] + w[2];
+            accumulators[3] = accumulators[3] + w[0] * w[0];
+            accumulators[4] = accumulators[4] + w[0] * w[1];
+            accumulators[5] = accumulators[5] + w[0] * w[2];
+            accumulators[6] = accumulators[6] + w[1] * w[1];
+            accumulators[7] = accumulators[7] + w[1] * w[2];
+            accumulators[8] = accumulators[8] + w[2] * w[2];
+          });
+
+      Scalar inverseCount = Scalar(1) / static_cast<Scalar>(count);
+      Vector3 step(sums[0], sums[1], sums[2]);
+      step *= inverseCount;
+      Matrix3 moment;
+      moment << sums[3], sums[4], sums[5], sums[4], sums[6], sums[7], sums[5],
+          sums[7], sums[8];
+      moment *= inverseCount;
+
+      statistics.covariance = moment - step * step.transpose();
+      statistics.mean = statistics.mean * SO3::exponentialMap(step);
+      statistics.iterations = iteration + 1;
+      if (step.norm() < convergence) {
+        break;
+      }
+    }
+    return statistics;
+  }
+
+private:
+  // Closest rotation in the Frobenius norm, U diag(1, 1, det(U V^T)) V^T
+  static Matrix3 project(const Matrix3 &matrix) {
+    Eigen::JacobiSVD<Matrix3> svd(matrix, Eigen::ComputeFullU |
+                                              Eigen::ComputeFullV);
+    Matrix3 U = svd.matrixU();
+    const Matrix3 &V = svd.matrixV();
+    if ((U * V.transpose()).determinant() < 0) {
+      U.col(2) = -U.col(2);
+    }
+    return U * V.transpose();
+  }
+
+  // Sums N values produced by kernel(tag, index, accumulators) over [0, count)
+  // on every hardware thread. Chunks go to whichever thread is free but are
+  // always the same chunks and always added in the same order, so the sum is
+  // bit identical across runs and thread counts.
+  template <std::size_t N, class Kernel>
+  static std::array<Scalar, N> parallelSum(std::size_t count,
+                                           Kernel &&kernel) {
+    using P = NativePack<Scalar>;
+    std::size_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<std::array<Scalar, N>> partials(numChunks);
+
+    ParallelDispatch::forEachChunk(numChunks, [&](std::size_t chunk) {
+      std::size_t begin = chunk * CHUNK_SIZE;
+      std::size_t end = std::min(count, begin + CHUNK_SIZE);
+
+      // Whole registers and the tail keep separate accumulators
+      P packSums[N];
+      Pack<Scalar, 1> tailSums[N];
+      for (std::size_t k = 0; k < N; ++k) {
+        packSums[k] = P(Scalar(0));
+        tailSums[k] = Pack<Scalar, 1>(Scalar(0));
+      }
+      Kernels::forEachPack(end - begin, [&](auto tag, std::size_t offset) {
+        using Q = typename decltype(tag)::type;
+        if constexpr (std::is_same_v<Q, P>) {
+          kernel(tag, begin + offset, packSums);
+        } else {
+          kernel(tag, begin + offset, tailSums);
+        }
+      });
+
+      for (std::size_t k = 0; k < N; ++k) {
+        Scalar lanes[P::width];
+        packSums[k].store(lanes);
+        Scalar sum = tailSums[k].v;
+        for (std::size_t lane = 0; lane < P::width; ++lane) {
+          sum += lanes[lane];
+        }
+        partials[chunk][k] = sum;
+      }
+    });
+
+    std::array<Scalar, N> sums{};
+    for (const std::array<Scalar, N> &partial : partials) {
+      for (std::size_t k = 0; k < N; ++k) {
+        sums[k] += partial[k];
+      }
+    }
+    return sums;
+  }
+};
+
+using RotationAveraging = BasicRotationAveraging<double>;
+using RotationAveragingf = BasicRotationAveraging<float>;
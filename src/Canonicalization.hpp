@@ -0,0 +1,181 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// First stage for quaternions coming in from outside, typed in or streamed.
+// Each is normalized and then flipped onto the hemisphere of the one before,
+// since q and -q are the same rotation but interpolation, averaging and delta
+// encoding all assume neighbours are close in R^4. The stream starts out next
+// to the identity, so the first quaternion ends up with w >= 0. Quaternions
+// whose norm is zero, tiny, huge or not finite are degenerate: they are
+// flagged and the last good rotation is held in their place.
+//
+// Normalizing and the dot products of neighbours run on whole registers, in
+// parallel. Only the signs are chained, which is a compare per sample.
+template <class Scalar> class BasicQuaternionCanonicalizer {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+  // Samples per pass of the kernels, which also bounds the scratch memory
+  static constexpr std::size_t CHUNK_SIZE = 1 << 12;
+
+public:
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  explicit BasicQuaternionCanonicalizer(
+      const Quaternion &reference = Quaternion::Identity()) {
+    for (std::vector<Scalar> *scratch : {&mScales, &mDots}) {
+      scratch->resize(CHUNK_SIZE);
+    }
+    mHeld.reserve(CHUNK_SIZE);
+    reset(reference);
+  }
+
+  // Writes the unit quaternion of each of the count inputs, on the hemisphere
+  // of the one before. in and out may be the same arrays. When degenerate is
+  // given it gets 1 for every degenerate input and 0 otherwise. Returns the
+  // number of degenerate inputs.
+  std::size_t canonicalize(const QuaternionArrays<const Scalar> &in,
+                           const QuaternionArrays<Scalar> &out,
+                           std::size_t count,
+                           std::uint8_t *degenerate = nullptr) {
+    std::size_t numDegenerate = 0;
+    for (std::size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+      std::size_t size = std::min(CHUNK_SIZE, count - begin);
+
+      // 1 / |q|, or 0 when degenerate, and q . the input before it. Lane 0 of
+      // the first pack has no input before it in the chunk, the chain
+      // compares it with the last output instead.
+      Kernels::parallelForEachPack(size, 6, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P q[4];
+        P previous[4];
+        for (std::size_t k = 0; k < 4; ++k) {
+          const Scalar *component = in.components[k] + begin + index;
+          q[k] = P::load(component);
+          if (index == 0) {
+            Scalar lanes[P::width];
+            lanes[0] = 0;
+            for (std::size_t lane = 1; lane < P::width; ++lane) {
+              lanes[lane] = component[lane - 1];
+            }
+            previous[k] = P::load(lanes);
+          } else {
+            previous[k] = P::load(component - 1);
+          }
+        }
+        P norm2 = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+        P dot = q[0] * previous[0] + q[1] * previous[1] +
+                q[2] * previous[2] + q[3] * previous[3];
+        // Fails for nan as well
+        P scale = select(norm2 > P(Kernels::tolerance),
+                         select(norm2 < P(1 / Kernels::tolerance),
+                                P(1.0) / sqrt(norm2), P(0.0)),
+                         P(0.0));
+        scale.store(mScales.data() + index);
+        dot.store(mDots.data() + index);
+      });
+
+      // The sign of each output is that of the one before times the sign of
+      // their dot product. Next to a held rotation the dot product is taken
+      // again against what is held.
+      std::array<Scalar, 4> start = mLast;
+      mHeld.clear();
+      for (std::size_t i = 0; i < size; ++i) {
+        bool isPreviousGood = i > 0 && mScales[i - 1] != 0;
+        if (mScales[i] == 0) {
+          if (isPreviousGood) {
+            for (std::size_t k = 0; k < 4; ++k) {
+              mLast[k] = mScales[i - 1] * in.components[k][begin + i - 1];
+            }
+          }
+          mHeld.push_back(i);
+          continue;
+        }
+        bool isFlipped;
+        if (isPreviousGood) {
+          isFlipped = (mDots[i] < 0) != (mScales[i - 1] < 0);
+        } else {
+          Scalar dot = 0;
+          for (std::size_t k = 0; k < 4; ++k) {
+            dot += in.components[k][begin + i] * mLast[k];
+          }
+          isFlipped = dot < 0;
+        }
+        mScales[i] = isFlipped ? -mScales[i] : mScales[i];
+      }
+
+      Kernels::parallelForEachPack(size, 9, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P scale = P::load(mScales.data() + index);
+        for (std::size_t k = 0; k < 4; ++k) {
+          (P::load(in.components[k] + begin + index) * scale)
+              .store(out.components[k] + begin + index);
+        }
+      });
+
+      // In order, so a run of degenerate inputs all hold the same rotation
+      for (std::size_t i : mHeld) {
+        for (std::size_t k = 0; k < 4; ++k) {
+          out.components[k][begin + i] =
+              i > 0 ? out.components[k][begin + i - 1] : start[k];
+        }
+      }
+      for (std::size_t k = 0; k < 4; ++k) {
+        mLast[k] = out.components[k][begin + size - 1];
+      }
+
+      if (degenerate != nullptr) {
+        std::fill(degenerate + begin, degenerate + begin + size,
+                  std::uint8_t(0));
+        for (std::size_t i : mHeld) {
+          degenerate[begin + i] = 1;
+        }
+      }
+      numDegenerate += mHeld.size();
+    }
+    return numDegenerate;
+  }
+
+  // A single quaternion, such as one typed in
+  Quaternion canonicalize(const Quaternion &q, bool &isDegenerate) {
+    std::array<Scalar, 4> components = {q.w(), q.x(), q.y(), q.z()};
+    QuaternionArrays<Scalar> arrays;
+    QuaternionArrays<const Scalar> constArrays;
+    for (std::size_t k = 0; k < 4; ++k) {
+      arrays.components[k] = &components[k];
+      constArrays.components[k] = &components[k];
+    }
+    isDegenerate = canonicalize(constArrays, arrays, 1) > 0;
+    return last();
+  }
+
+  // The last output, or the reference before any
+  Quaternion last() const {
+    return Quaternion(mLast[0], mLast[1], mLast[2], mLast[3]);
+  }
+
+  // Starts a new stream next to reference, a unit quaternion
+  void reset(const Quaternion &reference = Quaternion::Identity()) {
+    mLast = {reference.w(), reference.x(), reference.y(), reference.z()};
+  }
+
+private:
+  std::array<Scalar, 4> mLast;
+  std::vector<Scalar> mScales;
+  std::vector<Scalar> mDots;
+  // Degenerate samples of the chunk
+  std::vector<std::size_t> mHeld;
+};
+
+using QuaternionCanonicalizer = BasicQuaternionCanonicalizer<double>;
+using QuaternionCanonicalizerf = BasicQuaternionCanonicalizer<float>;
@@ -0,0 +1,413 @@
+#pragma once
+#include "Canonicalization.hpp"
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Unit quaternions in 7 bytes each instead of 4 scalars. Of the four
+// components the largest in magnitude is dropped, after flipping the quaternion
+// so that it is positive, and comes back as sqrt(1 - a^2 - b^2 - c^2). The
+// other three lie in [-1 / sqrt(2), 1 / sqrt(2)] and are each rounded to 16
+// bits, kept in one plane per slot next to a plane of the dropped index.
+template <class Scalar> class BasicPackedQuaternions {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+  static constexpr double RANGE = M_SQRT1_2;
+  static constexpr double LEVELS = 65535.0;
+
+public:
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  // Bound on the angle between a decoded rotation and the one encoded. Each
+  // component is off by at most h = RANGE / LEVELS and the dropped one, being
+  // at least 1 / 2, by no more than twice as much again, so the quaternion
+  // moves by 2 sqrt(3) h and the rotation by twice that, 7.5e-5 with room for
+  // float rounding.
+  static constexpr Scalar MAX_ERROR = Scalar(7.6e-5);
+
+  BasicPackedQuaternions() = default;
+
+  // The quaternions need not be normalized, nor on either hemisphere
+  BasicPackedQuaternions(const QuaternionArrays<const Scalar> &q,
+                         std::size_t count) {
+    resize(count);
+    encode(q, 0, count);
+  }
+
+  std::size_t size() const { return mLargest.size(); }
+
+  std::size_t bytes() const {
+    return size() * (3 * sizeof(std::uint16_t) + sizeof(std::uint8_t));
+  }
+
+  // Leaves the new rotations as the identity
+  void resize(std::size_t count) {
+    for (std::vector<std::uint16_t> &plane : mCodes) {
+      plane.resize(count, quantize(0));
+    }
+    mLargest.resize(count, 0);
+  }
+
+  // Overwrites count rotations starting at begin
+  void encode(const QuaternionArrays<const Scalar> &q, std::size_t begin,
+              std::size_t count) {
+    if (begin + count > size()) {
+      throw std::runtime_error("Packed quaternions written past the end!");
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      Scalar components[4];
+      std::size_t largest = 0;
+      for (std::size_t k = 0; k < 4; ++k) {
+        components[k] = q.components[k][i];
+        if (std::abs(components[k]) > std::abs(components[largest])) {
+          largest = k;
+        }
+      }
+      // A zero quaternion has no rotation to keep, the identity stands in
+      Scalar norm = std::sqrt(components[0] * components[0] +
+                              components[1] * components[1] +
+                              components[2] * components[2] +
+                              components[3] * components[3]);
+      Scalar scale = norm > 0 ? std::copysign(1 / norm, components[largest])
+                              : Scalar(0);
+      for (std::size_t slot = 0; slot < 3; ++slot) {
+        mCodes[slot][begin + i] =
+            quantize(scale * components[slot + (slot >= largest)]);
+      }
+      mLargest[begin + i] = static_cast<std::uint8_t>(norm > 0 ? largest : 0);
+    }
+  }
+
+  // Unit quaternions of count rotations starting at begin, with the largest
+  // component positive
+  void decode(std::size_t begin, const QuaternionArrays<Scalar> &q,
+              std::size_t count) const {
+    if (begin + count > size()) {
+      throw std::runtime_error("Packed quaternions read past the end!");
+    }
+    Kernels::parallelForEachPack(count, 6, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      // Widened a lane at a time, which compilers turn into vector
+      // conversions, then rebuilt in registers
+      P small[3];
+      for (std::size_t slot = 0; slot < 3; ++slot) {
+        const std::uint16_t *codes = mCodes[slot].data() + begin + index;
+        Scalar values[P::width];
+        for (std::size_t lane = 0; lane < P::width; ++lane) {
+          values[lane] = dequantize(codes[lane]);
+        }
+        small[slot] = P::load(values);
+      }
+      Scalar indices[P::width];
+      for (std::size_t lane = 0; lane < P::width; ++lane) {
+        indices[lane] = mLargest[begin + index + lane];
+      }
+      P largest = P::load(indices);
+      P quaternion[4];
+      decodeKernel(small, largest, quaternion);
+      Kernels::store(quaternion, index, q.components);
+    });
+  }
+
+  Quaternion operator[](std::size_t i) const {
+    Pack<Scalar, 1> small[3];
+    for (std::size_t slot = 0; slot < 3; ++slot) {
+      small[slot] = dequantize(mCodes[slot][i]);
+    }
+    Pack<Scalar, 1> q[4];
+    decodeKernel(small, Pack<Scalar, 1>(mLargest[i]), q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+private:
+  std::array<std::vector<std::uint16_t>, 3> mCodes;
+  std::vector<std::uint8_t> mLargest;
+
+  static std::uint16_t quantize(Scalar value) {
+    Scalar code = std::round((value / Scalar(RANGE) + 1) * Scalar(LEVELS / 2));
+    return static_cast<std::uint16_t>(
+        std::clamp(code, Scalar(0), Scalar(LEVELS)));
+  }
+
+  static Scalar dequantize(std::uint16_t code) {
+    return Scalar(code) * Scalar(2 * RANGE / LEVELS) - Scalar(RANGE);
+  }
+
+  // Puts the dropped component back in front of the three that follow it,
+  // comparing the index against half way points since packs have no equality
+  template <class P>
+  static void decodeKernel(const P (&small)[3], P largest, P (&q)[4]) {
+    P dropped = sqrt(max(P(1.0) - small[0] * small[0] - small[1] * small[1] -
+                             small[2] * small[2],
+                         P(0.0)));
+    q[0] = select(largest < P(0.5), dropped, small[0]);
+    q[1] = select(largest < P(0.5), small[0],
+                  select(largest < P(1.5), dropped, small[1]));
+    q[2] = select(largest < P(1.5), small[1],
+                  select(largest < P(2.5), dropped, small[2]));
+    q[3] = select(largest < P(2.5), small[2], dropped);
+  }
+};
+
+// A stream of rotations that change little from one sample to the next, such
+// as the orientations of an IMU, kept as the rotation vector of each sample
+// relative to the first of its block, log(key^-1 q). The vectors are rounded
+// onto a grid and each is stored as its difference from the one before in
+// zigzag varints, a byte per 7 bits, so slow motion costs a byte or two per
+// component. The rounding happens on absolute vectors, so errors never pile
+// up along the stream, and the blocks decode independently of each other.
+template <class Scalar> class BasicDeltaLogStream {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+  // Samples per pass of the log kernel while encoding
+  static constexpr std::size_t CHUNK_SIZE = 1 << 12;
+
+  // Left over for the rounding of the log, exp and composition
+  static constexpr Scalar ROUNDING_ERROR =
+      Scalar(16) * std::numeric_limits<Scalar>::epsilon();
+
+public:
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  // Every decoded rotation is within maxError radians of the one encoded. A
+  // grid step of s moves a rotation vector by at most sqrt(3) s / 2, and exp
+  // never turns that into a larger rotation.
+  explicit BasicDeltaLogStream(Scalar maxError, std::size_t blockSize = 1024)
+      : mMaxError(maxError), mBlockSize(blockSize) {
+    if (!(maxError > 2 * ROUNDING_ERROR)) {
+      throw std::runtime_error(
+          "Delta log streams need an error bound above rounding!");
+    }
+    if (blockSize == 0) {
+      throw std::runtime_error(
+          "Delta log streams need blocks of at least one sample!");
+    }
+    mStep = 2 * (maxError - ROUNDING_ERROR) / std::sqrt(Scalar(3));
+    for (std::vector<Scalar> &component : mCanonical) {
+      component.resize(CHUNK_SIZE);
+    }
+    for (std::vector<Scalar> &component : mScaled) {
+      component.resize(CHUNK_SIZE);
+    }
+  }
+
+  std::size_t size() const { return mCount; }
+
+  // Everything the stream holds on to but the encoding scratch
+  std::size_t bytes() const {
+    return mBytes.size() + mKeys.size() * sizeof(mKeys[0]) +
+           mBlockOffsets.size() * sizeof(mBlockOffsets[0]);
+  }
+
+  Scalar maxError() const { return mMaxError; }
+
+  // Appends the next count rotations of the stream. They go through a
+  // canonicalizer first, so a degenerate quaternion repeats the last good one.
+  void append(const QuaternionArrays<const Scalar> &q, std::size_t count) {
+    QuaternionArrays<Scalar> canonical;
+    QuaternionArrays<const Scalar> unit;
+    for (std::size_t k = 0; k < 4; ++k) {
+      canonical.components[k] = mCanonical[k].data();
+      unit.components[k] = mCanonical[k].data();
+    }
+    for (std::size_t begin = 0; begin < count;) {
+      // Up to the end of the chunk or of the block, whichever comes first
+      std::size_t offset = mCount % mBlockSize;
+      std::size_t size =
+          std::min({CHUNK_SIZE, count - begin, mBlockSize - offset});
+      QuaternionArrays<const Scalar> input;
+      for (std::size_t k = 0; k < 4; ++k) {
+        input.components[k] = q.components[k] + begin;
+      }
+      mCanonicalizer.canonicalize(input, canonical, size);
+      if (offset == 0) {
+        mKeys.push_back({mCanonical[0][0], mCanonical[1][0], mCanonical[2][0],
+                         mCanonical[3][0]});
+        mBlockOffsets.push_back(mBytes.size());
+        mPrevious = {0, 0, 0};
+      }
+
+      // Rotation vectors relative to the key in units of the grid
+      const std::array<Scalar, 4> &key = mKeys.back();
+      Scalar inverseStep = 1 / mStep;
+      Kernels::forEachPack(size, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P inverse[4] = {P(key[0]), P(-key[1]), P(-key[2]), P(-key[3])};
+        P quaternion[4];
+        P relative[4];
+        P w[3];
+        for (std::size_t k = 0; k < 4; ++k) {
+          quaternion[k] = P::load(unit.components[k] + index);
+        }
+        Kernels::composeKernel(inverse, quaternion, relative);
+        Kernels::quaternionLogarithmicMapKernel(relative, w);
+        for (std::size_t k = 0; k < 3; ++k) {
+          (w[k] * P(inverseStep)).store(mScaled[k].data() + index);
+        }
+      });
+
+      for (std::size_t i = 0; i < size; ++i) {
+        for (std::size_t k = 0; k < 3; ++k) {
+          std::int64_t code = std::llround(mScaled[k][i]);
+          writeVarint(zigzag(code - mPrevious[k]));
+          mPrevious[k] = code;
+        }
+      }
+      mCount += size;
+      begin += size;
+    }
+  }
+
+  // Writes count rotations starting at begin, each on the hemisphere of the
+  // key of its block. Blocks are decoded in parallel.
+  void decode(std::size_t begin, const QuaternionArrays<Scalar> &q,
+              std::size_t count) const {
+    if (begin + count > mCount) {
+      throw std::runtime_error("Delta log stream read past its end!");
+    }
+    if (count == 0) {
+      return;
+    }
+    std::size_t firstBlock = begin / mBlockSize;
+    std::size_t lastBlock = (begin + count - 1) / mBlockSize;
+    ParallelDispatch::forEachChunk(
+        lastBlock - firstBlock + 1, [&](std::size_t chunk) {
+          std::size_t block = firstBlock + chunk;
+          std::size_t blockBegin = block * mBlockSize;
+          std::size_t first = std::max(begin, blockBegin);
+          std::size_t last = std::min(
+              {begin + count, blockBegin + mBlockSize, mCount});
+          decodeBlock(block, first - blockBegin, last - first,
+                      offset(q, first - begin));
+        });
+  }
+
+  Quaternion operator[](std::size_t i) const {
+    std::array<Scalar, 4> components;
+    QuaternionArrays<Scalar> q;
+    for (std::size_t k = 0; k < 4; ++k) {
+      q.components[k] = &components[k];
+    }
+    decode(i, q, 1);
+    return Quaternion(components[0], components[1], components[2],
+                      components[3]);
+  }
+
+  void clear() {
+    mCount = 0;
+    mBytes.clear();
+    mKeys.clear();
+    mBlockOffsets.clear();
+    mCanonicalizer.reset();
+  }
+
+private:
+  Scalar mMaxError;
+  std::size_t mBlockSize;
+  Scalar mStep;
+  std::size_t mCount = 0;
+
+  std::vector<std::uint8_t> mBytes;
+  std::vector<std::array<Scalar, 4>> mKeys;
+  std::vector<std::size_t> mBlockOffsets;
+
+  // Grid coordinates of the last sample encoded
+  std::array<std::int64_t, 3> mPrevious = {0, 0, 0};
+
+  BasicQuaternionCanonicalizer<Scalar> mCanonicalizer;
+  std::array<std::vector<Scalar>, 4> mCanonical;
+  std::array<std::vector<Scalar>, 3> mScaled;
+
+  // Small magnitudes of either sign into small unsigned values
+  static std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^
+           static_cast<std::uint64_t>(value >> 63);
+  }
+
+  static std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+  }
+
+  void writeVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+      mBytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    mBytes.push_back(static_cast<std::uint8_t>(value));
+  }
+
+  static std::uint64_t readVarint(const std::uint8_t *&byte) {
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      std::uint8_t bits = *byte++;
+      value |= static_cast<std::uint64_t>(bits & 0x7f) << shift;
+      if (bits < 0x80) {
+        return value;
+      }
+    }
+  }
+
+  static QuaternionArrays<Scalar> offset(const QuaternionArrays<Scalar> &q,
+                                         std::size_t begin) {
+    QuaternionArrays<Scalar> result;
+    for (std::size_t k = 0; k < 4; ++k) {
+      result.components[k] = q.components[k] + begin;
+    }
+    return result;
+  }
+
+  // Samples [first, first + count) of block, counted from its start. The
+  // varints only decode in order, their rotation vectors go through the
+  // vector part of q and come back out as quaternions.
+  void decodeBlock(std::size_t block, std::size_t first, std::size_t count,
+                   const QuaternionArrays<Scalar> &q) const {
+    const std::uint8_t *byte = mBytes.data() + mBlockOffsets[block];
+    std::array<std::int64_t, 3> code = {0, 0, 0};
+    for (std::size_t i = 0; i < first + count; ++i) {
+      for (std::size_t k = 0; k < 3; ++k) {
+        code[k] += unzigzag(readVarint(byte));
+        if (i >= first) {
+          q.components[k + 1][i - first] = static_cast<Scalar>(code[k]);
+        }
+      }
+    }
+
+    const std::array<Scalar, 4> &key = mKeys[block];
+    Scalar step = mStep;
+    Kernels::forEachPack(count, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P keyPack[4] = {P(key[0]), P(key[1]), P(key[2]), P(key[3])};
+      P w[3];
+      P relative[4];
+      P quaternion[4];
+      for (std::size_t k = 0; k < 3; ++k) {
+        w[k] = P::load(q.components[k + 1] + index) * P(step);
+      }
+      Kernels::quaternionExponentialMapKernel(w, relative);
+      Kernels::composeKernel(keyPack, relative, quaternion);
+      Kernels::store(quaternion, index, q.components);
+    });
+  }
+};
+
+using PackedQuaternions = BasicPackedQuaternions<double>;
+using PackedQuaternionsf = BasicPackedQuaternions<float>;
+using DeltaLogStream = BasicDeltaLogStream<double>;
+using DeltaLogStreamf = BasicDeltaLogStream<float>;
@@ -0,0 +1,387 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <array>
+#include <cstddef>
+
+// Conversions between the common ways of writing down a rotation. Every
+// representation converts to and from a row major rotation matrix, and convert
+// chains the two in one pass over the batch, so any pair of representations
+// converts without a temporary buffer.
+template <class Scalar> class BasicRotationConversion {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Vector6 = Eigen::Matrix<Scalar, 6, 1>;
+  using AngleAxis = Eigen::AngleAxis<Scalar>;
+
+  static constexpr Scalar tolerance = LieAlgebraTolerances<Scalar>::tolerance;
+
+public:
+  // Intrinsic Euler sequences. XYZ is R = Rx(a) Ry(b) Rz(c) for the angles (a,
+  // b, c), a turn about x, then about the new y and then about the newest z,
+  // which is the same as the extrinsic sequence z, y, x. ZYX is the yaw, pitch,
+  // roll of aerospace and ZXZ the classical Euler angles.
+  enum class EulerOrder {
+    XYZ,
+    XZY,
+    YXZ,
+    YZX,
+    ZXY,
+    ZYX,
+    XYX,
+    XZX,
+    YXY,
+    YZY,
+    ZXZ,
+    ZYZ
+  };
+
+  static constexpr int NUM_EULER_ORDERS = 12;
+
+  template <class T> using SO3Arrays = typename SO3::template SO3Arrays<T>;
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  // Structure of arrays view over a batch of Euler angles in the order they
+  // are applied, all in the same convention
+  template <class T> struct EulerArrays {
+    std::array<T *, 3> angles;
+    EulerOrder order;
+  };
+
+  // Structure of arrays view over a batch of unit axes and angles, ordered x,
+  // y, z, angle
+  template <class T> struct AxisAngleArrays {
+    std::array<T *, 4> components;
+  };
+
+  // Structure of arrays view over the continuous 6D representation of Zhou et
+  // al., the first two columns of the rotation matrix stacked
+  template <class T> struct SixDArrays {
+    std::array<T *, 6> components;
+  };
+
+  static Matrix3 eulerToMatrix(const Vector3 &angles, EulerOrder order) {
+    Pack<Scalar, 1> a[3] = {angles.x(), angles.y(), angles.z()};
+    Pack<Scalar, 1> R[9];
+    eulerToMatrixKernel(a, order, R);
+    return toMatrix(R);
+  }
+
+  // The middle angle is in [-pi / 2, pi / 2] for the Tait-Bryan orders and in
+  // [0, pi] for the proper Euler orders, the outer two in [-pi, pi]. In gimbal
+  // lock only their sum or difference is defined, so the last angle is 0.
+  static Vector3 matrixToEuler(const Matrix3 &SO3, EulerOrder order) {
+    Pack<Scalar, 1> R[9];
+    fromMatrix(SO3, R);
+    Pack<Scalar, 1> a[3];
+    matrixToEulerKernel(R, order, a);
+    return Vector3(a[0].v, a[1].v, a[2].v);
+  }
+
+  static Matrix3 axisAngleToMatrix(const AngleAxis &axisAngle) {
+    Pack<Scalar, 1> a[4] = {axisAngle.axis().x(), axisAngle.axis().y(),
+                            axisAngle.axis().z(), axisAngle.angle()};
+    Pack<Scalar, 1> R[9];
+    axisAngleToMatrixKernel(a, R);
+    return toMatrix(R);
+  }
+
+  // The angle is in [0, pi], the identity has the x axis
+  static AngleAxis matrixToAxisAngle(const Matrix3 &SO3) {
+    Pack<Scalar, 1> R[9];
+    fromMatrix(SO3, R);
+    Pack<Scalar, 1> a[4];
+    matrixToAxisAngleKernel(R, a);
+    return AngleAxis(a[3].v, Vector3(a[0].v, a[1].v, a[2].v));
+  }
+
+  // The two columns only need to be independent, the matrix is their Gram
+  // Schmidt basis
+  static Matrix3 sixDToMatrix(const Vector6 &sixD) {
+    Pack<Scalar, 1> c[6];
+    for (std::size_t k = 0; k < 6; ++k) {
+      c[k] = sixD.coeff(k);
+    }
+    Pack<Scalar, 1> R[9];
+    sixDToMatrixKernel(c, R);
+    return toMatrix(R);
+  }
+
+  static Vector6 matrixToSixD(const Matrix3 &SO3) {
+    Pack<Scalar, 1> R[9];
+    fromMatrix(SO3, R);
+    Pack<Scalar, 1> c[6];
+    matrixToSixDKernel(R, c);
+
+    Vector6 sixD;
+    for (std::size_t k = 0; k < 6; ++k) {
+      sixD(k) = c[k].v;
+    }
+    return sixD;
+  }
+
+  // Converts a batch from any of the array views to any other, e.g.
+  // convert(EulerArrays<const float>{...}, QuaternionArrays<float>{...}, n).
+  // Inputs use a const Scalar, outputs a mutable one.
+  template <class From, class To>
+  static void convert(const From &from, const To &to, std::size_t count) {
+    // No view holds more than a matrix
+    Kernels::parallelForEachPack(count, 18, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P R[9];
+      read(from, index, R);
+      write(R, index, to);
+    });
+  }
+
+private:
+  // Axes of each Euler order, indexed by EulerOrder
+  static constexpr int EULER_AXES[NUM_EULER_ORDERS][3] = {
+      {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0},
+      {0, 1, 0}, {0, 2, 0}, {1, 0, 1}, {1, 2, 1}, {2, 0, 2}, {2, 1, 2}};
+
+  static void fromMatrix(const Matrix3 &SO3, Pack<Scalar, 1> (&R)[9]) {
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = SO3.coeff(k / 3, k % 3);
+    }
+  }
+
+  static Matrix3 toMatrix(const Pack<Scalar, 1> (&R)[9]) {
+    Matrix3 SO3;
+    SO3 << R[0].v, R[1].v, R[2].v, R[3].v, R[4].v, R[5].v, R[6].v, R[7].v,
+        R[8].v;
+    return SO3;
+  }
+
+  // Every view reads into and writes out of a row major matrix
+  template <class P>
+  static void read(const SO3Arrays<const Scalar> &SO3, std::size_t index,
+                   P (&R)[9]) {
+    Kernels::load(SO3.entries, index, R);
+  }
+
+  template <class P>
+  static void write(const P (&R)[9], std::size_t index,
+                    const SO3Arrays<Scalar> &SO3) {
+    Kernels::store(R, index, SO3.entries);
+  }
+
+  template <class P>
+  static void read(const QuaternionArrays<const Scalar> &q, std::size_t index,
+                   P (&R)[9]) {
+    P quaternion[4];
+    Kernels::load(q.components, index, quaternion);
+    Kernels::quaternionToMatrixKernel(quaternion, R);
+  }
+
+  template <class P>
+  static void write(const P (&R)[9], std::size_t index,
+                    const QuaternionArrays<Scalar> &q) {
+    P quaternion[4];
+    Kernels::matrixToQuaternionKernel(R, quaternion);
+    Kernels::store(quaternion, index, q.components);
+  }
+
+  template <class P>
+  static void read(const EulerArrays<const Scalar> &euler, std::size_t index,
+                   P (&R)[9]) {
+    P a[3];
+    Kernels::load(euler.angles, index, a);
+    eulerToMatrixKernel(a, euler.order, R);
+  }
+
+  template <class P>
+  static void write(const P (&R)[9], std::size_t index,
+                    const EulerArrays<Scalar> &euler) {
+    P a[3];
+    matrixToEulerKernel(R, euler.order, a);
+    Kernels::store(a, index, euler.angles);
+  }
+
+  template <class P>
+  static void read(const AxisAngleArrays<const Scalar> &axisAngle,
+                   std::size_t index, P (&R)[9]) {
+    P a[4];
+    Kernels::load(axisAngle.components, index, a);
+    axisAngleToMatrixKernel(a, R);
+  }
+
+  template <class P>
+  static void write(const P (&R)[9], std::size_t index,
+                    const AxisAngleArrays<Scalar> &axisAngle) {
+    P a[4];
+    matrixToAxisAngleKernel(R, a);
+    Kernels::store(a, index, axisAngle.components);
+  }
+
+  template <class P>
+  static void read(const SixDArrays<const Scalar> &sixD, std::size_t index,
+                   P (&R)[9]) {
+    P c[6];
+    Kernels::load(sixD.components, index, c);
+    sixDToMatrixKernel(c, R);
+  }
+
+  template <class P>
+  static void write(const P (&R)[9], std::size_t index,
+                    const SixDArrays<Scalar> &sixD) {
+    P c[6];
+    matrixToSixDKernel(R, c);
+    Kernels::store(c, index, sixD.components);
+  }
+
+  // Row major rotation by angle about the coordinate axis
+  template <class P>
+  static constexpr void axisRotationKernel(int axis, P angle, P (&R)[9]) {
+    P sine;
+    P cosine;
+    SimdMath::sincos(angle, sine, cosine);
+    int next = (axis + 1) % 3;
+    int last = (axis + 2) % 3;
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = P(0.0);
+    }
+    R[4 * axis] = P(1.0);
+    R[4 * next] = cosine;
+    R[3 * next + last] = -sine;
+    R[3 * last + next] = sine;
+    R[4 * last] = cosine;
+  }
+
+  template <class P>
+  static constexpr void eulerToMatrixKernel(const P (&a)[3], EulerOrder order,
+                                            P (&R)[9]) {
+    const int(&axes)[3] = EULER_AXES[static_cast<int>(order)];
+    P first[9];
+    P second[9];
+    P third[9];
+    axisRotationKernel(axes[0], a[0], first);
+    axisRotationKernel(axes[1], a[1], second);
+    axisRotationKernel(axes[2], a[2], third);
+    P partial[9];
+    Kernels::multiplyKernel(first, second, partial);
+    Kernels::multiplyKernel(partial, third, R);
+  }
+
+  // With i, j the first two axes, k the remaining one and s = +1 when i, j, k
+  // is cyclic, row i of R gives the middle angle and column i or k the first.
+  // The last angle is then read off row j of Ri(first)^T R rather than off R,
+  // so it absorbs the error of the first one, which grows as the middle angle
+  // nears gimbal lock. In the lock itself column i or k is zero, the first
+  // angle takes the whole turn about the locked axis from the j, k block and
+  // the last comes out as 0.
+  template <class P>
+  static constexpr void matrixToEulerKernel(const P (&R)[9], EulerOrder order,
+                                            P (&a)[3]) {
+    const int(&axes)[3] = EULER_AXES[static_cast<int>(order)];
+    int i = axes[0];
+    int j = axes[1];
+    int k = 3 - i - j;
+    bool isProper = axes[2] == i;
+    P s = P((j - i + 3) % 3 == 1 ? 1.0 : -1.0);
+    auto at = [&R](int row, int col) { return R[3 * row + col]; };
+
+    P first;
+    typename P::Mask locked;
+    if (isProper) {
+      // The middle angle is acos(R_ii)
+      P sine = sqrt(at(i, j) * at(i, j) + at(i, k) * at(i, k));
+      locked = sine < P(tolerance);
+      a[1] = SimdMath::atan2(sine, at(i, i));
+      first = SimdMath::atan2(at(j, i), -s * at(k, i));
+    } else {
+      // The middle angle is asin(s R_ik)
+      P cosine = sqrt(at(i, i) * at(i, i) + at(i, j) * at(i, j));
+      locked = cosine < P(tolerance);
+      a[1] = SimdMath::atan2(s * at(i, k), cosine);
+      first = SimdMath::atan2(-s * at(j, k), at(k, k));
+    }
+    a[0] = select(locked, SimdMath::atan2(s * at(k, j), at(j, j)), first);
+
+    P sine;
+    P cosine;
+    SimdMath::sincos(a[0], sine, cosine);
+    auto unwound = [&](int col) {
+      return cosine * at(j, col) + s * sine * at(k, col);
+    };
+    a[2] = isProper ? SimdMath::atan2(-s * unwound(k), unwound(j))
+                    : SimdMath::atan2(s * unwound(i), unwound(j));
+  }
+
+  // Rodrigues' formula with half angles, 1 - cos(angle) = 2 sin^2(angle / 2)
+  // keeps its digits for small angles
+  template <class P>
+  static constexpr void axisAngleToMatrixKernel(const P (&a)[4], P (&R)[9]) {
+    P axis[3] = {a[0], a[1], a[2]};
+    P sine;
+    P cosine;
+    SimdMath::sincos(P(0.5) * a[3], sine, cosine);
+    P norm2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    Kernels::skewPolynomialKernel(axis, norm2, P(2.0) * sine * cosine,
+                                  P(2.0) * sine * sine, R);
+  }
+
+  template <class P>
+  static constexpr void matrixToAxisAngleKernel(const P (&R)[9], P (&a)[4]) {
+    P w[3];
+    Kernels::logarithmicMapKernel(R, w);
+    P angle = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    typename P::Mask identity = angle < P(tolerance);
+    P inverseAngle = P(1.0) / max(angle, P(tolerance));
+    a[0] = select(identity, P(1.0), w[0] * inverseAngle);
+    a[1] = select(identity, P(0.0), w[1] * inverseAngle);
+    a[2] = select(identity, P(0.0), w[2] * inverseAngle);
+    a[3] = angle;
+  }
+
+  // Gram Schmidt on the two columns, the third is their cross product
+  template <class P>
+  static constexpr void sixDToMatrixKernel(const P (&c)[6], P (&R)[9]) {
+    P first[3] = {c[0], c[1], c[2]};
+    P second[3] = {c[3], c[4], c[5]};
+    P inverseNorm =
+        P(1.0) / max(sqrt(first[0] * first[0] + first[1] * first[1] +
+                          first[2] * first[2]),
+                     P(tolerance));
+    for (std::size_t k = 0; k < 3; ++k) {
+      first[k] = first[k] * inverseNorm;
+    }
+    P projection =
+        first[0] * second[0] + first[1] * second[1] + first[2] * second[2];
+    for (std::size_t k = 0; k < 3; ++k) {
+      second[k] = second[k] - projection * first[k];
+    }
+    inverseNorm =
+        P(1.0) / max(sqrt(second[0] * second[0] + second[1] * second[1] +
+                          second[2] * second[2]),
+                     P(tolerance));
+    for (std::size_t k = 0; k < 3; ++k) {
+      second[k] = second[k] * inverseNorm;
+    }
+    P third[3] = {first[1] * second[2] - first[2] * second[1],
+                  first[2] * second[0] - first[0] * second[2],
+                  first[0] * second[1] - first[1] * second[0]};
+    for (std::size_t row = 0; row < 3; ++row) {
+      R[3 * row] = first[row];
+      R[3 * row + 1] = second[row];
+      R[3 * row + 2] = third[row];
+    }
+  }
+
+  template <class P>
+  static constexpr void matrixToSixDKernel(const P (&R)[9], P (&c)[6]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      c[row] = R[3 * row];
+      c[row + 3] = R[3 * row + 1];
+    }
+  }
+};
+
+using RotationConversion = BasicRotationConversion<double>;
+using RotationConversionf = BasicRotationConversion<float>;
@@ -0,0 +1,413 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Rigid body transforms as unit dual quaternions q = r + eps d, with r the
+// rotation and d = t r / 2 for the translation t, so eight numbers do the work
+// of a 4x4 matrix. Unlike matrices, weighted sums of dual quaternions stay
+// close to rigid transforms, which is what makes them blend well.
+template <class Scalar> class BasicDualQuaternionAlgebra {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Matrix4 = Eigen::Matrix<Scalar, 4, 4>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+public:
+  struct DualQuaternion {
+    Quaternion real;
+    Quaternion dual;
+  };
+
+  // Structure of arrays view over a batch of dual quaternions, the w, x, y, z
+  // of the real part followed by those of the dual part
+  template <class T> struct DualQuaternionArrays {
+    std::array<T *, 8> components;
+  };
+
+  // Structure of arrays view over a batch of points
+  template <class T> struct PointArrays {
+    std::array<T *, 3> components;
+  };
+
+  // Bones and weights of every point, up to NUM_INFLUENCES of each. Unused
+  // influences get a weight of 0.
+  static constexpr std::size_t NUM_INFLUENCES = 4;
+  template <class T> struct InfluenceArrays {
+    std::array<const std::uint32_t *, NUM_INFLUENCES> bones;
+    std::array<T *, NUM_INFLUENCES> weights;
+  };
+
+  static DualQuaternion fromRotationTranslation(const Quaternion &rotation,
+                                                const Vector3 &translation) {
+    Quaternion t(Scalar(0), translation.x(), translation.y(), translation.z());
+    Quaternion dual = SO3::compose(t, rotation);
+    dual.coeffs() *= Scalar(0.5);
+    return {rotation, dual};
+  }
+
+  static DualQuaternion fromSE3(const Matrix4 &SE3) {
+    Matrix3 rotation = SE3.template topLeftCorner<3, 3>();
+    return fromRotationTranslation(SO3::matrixToQuaternion(rotation),
+                                   SE3.template topRightCorner<3, 1>());
+  }
+
+  static Vector3 translation(const DualQuaternion &dq) {
+    Pack<Scalar, 1> q[8];
+    Pack<Scalar, 1> t[3];
+    fromDualQuaternion(dq, q);
+    translationKernel(q, t);
+    return Vector3(t[0].v, t[1].v, t[2].v);
+  }
+
+  static Matrix4 toSE3(const DualQuaternion &dq) {
+    Matrix4 SE3 = Matrix4::Identity();
+    SE3.template topLeftCorner<3, 3>() = SO3::quaternionToMatrix(
+        dq.real.w(), dq.real.x(), dq.real.y(), dq.real.z());
+    SE3.template topRightCorner<3, 1>() = translation(dq);
+    return SE3;
+  }
+
+  // lhs * rhs, which applies rhs first like the product of the matrices
+  static DualQuaternion compose(const DualQuaternion &lhs,
+                                const DualQuaternion &rhs) {
+    Pack<Scalar, 1> a[8];
+    Pack<Scalar, 1> b[8];
+    Pack<Scalar, 1> q[8];
+    fromDualQuaternion(lhs, a);
+    fromDualQuaternion(rhs, b);
+    composeKernel(a, b, q);
+    return toDualQuaternion(q);
+  }
+
+  static void compose(const DualQuaternionArrays<const Scalar> &lhs,
+                      const DualQuaternionArrays<const Scalar> &rhs,
+                      const DualQuaternionArrays<Scalar> &result,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 24, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[8];
+      P b[8];
+      P q[8];
+      Kernels::load(lhs.components, index, a);
+      Kernels::load(rhs.components, index, b);
+      composeKernel(a, b, q);
+      Kernels::store(q, index, result.components);
+    });
+  }
+
+  // Scales the real part to unit length and takes the part of the dual along
+  // it out, so the result is a rigid transform again after drift or blending
+  static DualQuaternion normalize(const DualQuaternion &dq) {
+    Pack<Scalar, 1> q[8];
+    fromDualQuaternion(dq, q);
+    normalizeKernel(q);
+    return toDualQuaternion(q);
+  }
+
+  static void normalize(const DualQuaternionArrays<const Scalar> &dq,
+                        const DualQuaternionArrays<Scalar> &result,
+                        std::size_t count) {
+    Kernels::parallelForEachPack(count, 16, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P q[8];
+      Kernels::load(dq.components, index, q);
+      normalizeKernel(q);
+      Kernels::store(q, index, result.components);
+    });
+  }
+
+  // Screw linear interpolation, the constant speed screw motion from lhs at
+  // t = 0 to rhs at t = 1 along the shorter way round: lhs (lhs^-1 rhs)^t
+  static DualQuaternion sclerp(const DualQuaternion &lhs,
+                               const DualQuaternion &rhs, Scalar t) {
+    Pack<Scalar, 1> a[8];
+    Pack<Scalar, 1> b[8];
+    Pack<Scalar, 1> q[8];
+    fromDualQuaternion(lhs, a);
+    fromDualQuaternion(rhs, b);
+    sclerpKernel(a, b, Pack<Scalar, 1>(t), q);
+    return toDualQuaternion(q);
+  }
+
+  static void sclerp(const DualQuaternionArrays<const Scalar> &lhs,
+                     const DualQuaternionArrays<const Scalar> &rhs,
+                     const Scalar *t,
+                     const DualQuaternionArrays<Scalar> &result,
+                     std::size_t count) {
+    Kernels::parallelForEachPack(count, 25, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[8];
+      P b[8];
+      P q[8];
+      Kernels::load(lhs.components, index, a);
+      Kernels::load(rhs.components, index, b);
+      sclerpKernel(a, b, P::load(t + index), q);
+      Kernels::store(q, index, result.components);
+    });
+  }
+
+  static Vector3 transformPoint(const DualQuaternion &dq, const Vector3 &p) {
+    Pack<Scalar, 1> q[8];
+    Pack<Scalar, 1> point[3] = {p.x(), p.y(), p.z()};
+    Pack<Scalar, 1> result[3];
+    fromDualQuaternion(dq, q);
+    transformKernel(q, point, result);
+    return Vector3(result[0].v, result[1].v, result[2].v);
+  }
+
+  // Every point by the same transform
+  static void transformPoints(const DualQuaternion &dq,
+                              const PointArrays<const Scalar> &points,
+                              const PointArrays<Scalar> &result,
+                              std::size_t count) {
+    Pack<Scalar, 1> single[8];
+    fromDualQuaternion(dq, single);
+    Kernels::parallelForEachPack(count, 6, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P q[8];
+      P p[3];
+      P transformed[3];
+      for (std::size_t k = 0; k < 8; ++k) {
+        q[k] = P(single[k].v);
+      }
+      Kernels::load(points.components, index, p);
+      transformKernel(q, p, transformed);
+      Kernels::store(transformed, index, result.components);
+    });
+  }
+
+  // Dual quaternion linear blend skinning (Kavan et al.): each point moves by
+  // the weighted sum of its bones, each flipped onto the hemisphere of the
+  // first so that q and -q do not cancel, and normalised. The weights do not
+  // have to add up to 1.
+  static void skin(const std::vector<DualQuaternion> &bones,
+                   const InfluenceArrays<const Scalar> &influences,
+                   const PointArrays<const Scalar> &points,
+                   const PointArrays<Scalar> &result, std::size_t count) {
+    std::vector<std::array<Scalar, 8>> table(bones.size());
+    for (std::size_t i = 0; i < bones.size(); ++i) {
+      Pack<Scalar, 1> q[8];
+      fromDualQuaternion(bones[i], q);
+      for (std::size_t k = 0; k < 8; ++k) {
+        table[i][k] = q[k].v;
+      }
+    }
+
+    Kernels::parallelForEachPack(count, 14, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      // The bones of the lanes are gathered one lane at a time
+      auto gather = [&](std::size_t influence, P (&q)[8]) {
+        Scalar gathered[8][P::width];
+        for (std::size_t lane = 0; lane < P::width; ++lane) {
+          const std::array<Scalar, 8> &bone =
+              table[influences.bones[influence][index + lane]];
+          for (std::size_t k = 0; k < 8; ++k) {
+            gathered[k][lane] = bone[k];
+          }
+        }
+        for (std::size_t k = 0; k < 8; ++k) {
+          q[k] = P::load(gathered[k]);
+        }
+      };
+
+      P first[8];
+      gather(0, first);
+      P blended[8];
+      P weight = P::load(influences.weights[0] + index);
+      for (std::size_t k = 0; k < 8; ++k) {
+        blended[k] = weight * first[k];
+      }
+      for (std::size_t influence = 1; influence < NUM_INFLUENCES; ++influence) {
+        P q[8];
+        gather(influence, q);
+        P alignment = q[0] * first[0] + q[1] * first[1] + q[2] * first[2] +
+                      q[3] * first[3];
+        weight = P::load(influences.weights[influence] + index);
+        weight = select(alignment < P(0.0), -weight, weight);
+        for (std::size_t k = 0; k < 8; ++k) {
+          blended[k] = blended[k] + weight * q[k];
+        }
+      }
+
+      P p[3];
+      P transformed[3];
+      Kernels::load(points.components, index, p);
+      transformKernel(blended, p, transformed);
+      Kernels::store(transformed, index, result.components);
+    });
+  }
+
+private:
+  static void fromDualQuaternion(const DualQuaternion &dq,
+                                 Pack<Scalar, 1> (&q)[8]) {
+    const Quaternion *parts[2] = {&dq.real, &dq.dual};
+    for (std::size_t part = 0; part < 2; ++part) {
+      q[4 * part] = parts[part]->w();
+      q[4 * part + 1] = parts[part]->x();
+      q[4 * part + 2] = parts[part]->y();
+      q[4 * part + 3] = parts[part]->z();
+    }
+  }
+
+  static DualQuaternion toDualQuaternion(const Pack<Scalar, 1> (&q)[8]) {
+    return {Quaternion(q[0].v, q[1].v, q[2].v, q[3].v),
+            Quaternion(q[4].v, q[5].v, q[6].v, q[7].v)};
+  }
+
+  // Hamilton product of the quaternions at a and b, which may be either half
+  // of a dual quaternion
+  template <class P>
+  static void multiply(const P *a, const P *b, P *q) {
+    P lhs[4] = {a[0], a[1], a[2], a[3]};
+    P rhs[4] = {b[0], b[1], b[2], b[3]};
+    P product[4];
+    Kernels::composeKernel(lhs, rhs, product);
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[k] = product[k];
+    }
+  }
+
+  // (a_r + eps a_d)(b_r + eps b_d) = a_r b_r + eps (a_r b_d + a_d b_r)
+  template <class P>
+  static void composeKernel(const P (&a)[8], const P (&b)[8], P (&q)[8]) {
+    P cross[4];
+    multiply(a, b, q);
+    multiply(a, b + 4, q + 4);
+    multiply(a + 4, b, cross);
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[4 + k] = q[4 + k] + cross[k];
+    }
+  }
+
+  // t = 2 d r^* / |r|^2, which only needs the vector part, so it also holds
+  // for the unnormalised sums that skinning produces
+  template <class P>
+  static void translationKernel(const P (&q)[8], P (&t)[3]) {
+    const P *r = q;
+    const P *d = q + 4;
+    P scale = P(2.0) / (r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+    t[0] = scale * (r[0] * d[1] - d[0] * r[1] + r[2] * d[3] - r[3] * d[2]);
+    t[1] = scale * (r[0] * d[2] - d[0] * r[2] + r[3] * d[1] - r[1] * d[3]);
+    t[2] = scale * (r[0] * d[3] - d[0] * r[3] + r[1] * d[2] - r[2] * d[1]);
+  }
+
+  // r p r^* / |r|^2 + t
+  template <class P>
+  static void transformKernel(const P (&q)[8], const P (&p)[3],
+                              P (&result)[3]) {
+    const P *r = q;
+    P inverseNorm2 =
+        P(1.0) / (r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+
+    // p + 2 w (v x p) + 2 v x (v x p), divided through by |r|^2
+    P c[3] = {r[2] * p[2] - r[3] * p[1], r[3] * p[0] - r[1] * p[2],
+              r[1] * p[1] - r[2] * p[0]};
+    P cc[3] = {r[2] * c[2] - r[3] * c[1], r[3] * c[0] - r[1] * c[2],
+               r[1] * c[1] - r[2] * c[0]};
+    P t[3];
+    translationKernel(q, t);
+    P two = P(2.0) * inverseNorm2;
+    for (std::size_t k = 0; k < 3; ++k) {
+      result[k] = p[k] + two * (r[0] * c[k] + cc[k]) + t[k];
+    }
+  }
+
+  template <class P> static void normalizeKernel(P (&q)[8]) {
+    P norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    P inverseNorm = P(1.0) / max(norm, P(Kernels::tolerance));
+    for (std::size_t k = 0; k < 8; ++k) {
+      q[k] = q[k] * inverseNorm;
+    }
+    P alignment = q[0] * q[4] + q[1] * q[5] + q[2] * q[6] + q[3] * q[7];
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[4 + k] = q[4 + k] - alignment * q[k];
+    }
+  }
+
+  // Logarithm of a unit dual quaternion with w >= 0 as the half angle vector
+  // w = h u and its dual part v = h' u + h m, where h + eps h' is the dual half
+  // angle and u + eps m the screw axis. Written so that nothing divides by the
+  // vanishing sin(h) of a pure translation.
+  template <class P>
+  static void logarithmKernel(const P (&q)[8], P (&w)[3], P (&v)[3]) {
+    P sinH = sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    P h = SimdMath::atan2(sinH, q[0]);
+    P h2 = h * h;
+
+    // h / sin(h) and (1 - h cot(h)) / sin(h)^2, both 0 / 0 at h = 0
+    typename P::Mask small = h < P(Kernels::smallAngle);
+    P safeSin = max(sinH, P(Kernels::smallAngle));
+    P safeH = max(h, P(Kernels::smallAngle));
+    P ratio = select(small, P(1.0) + h2 * P(1.0 / 6.0), safeH / safeSin);
+    P correction =
+        select(small, P(1.0 / 3.0) + h2 * P(2.0 / 15.0),
+               (P(1.0) - safeH * q[0] / safeSin) / (safeSin * safeSin));
+    for (std::size_t k = 0; k < 3; ++k) {
+      w[k] = ratio * q[k + 1];
+      v[k] = ratio * q[k + 5] - correction * q[4] * q[k + 1];
+    }
+  }
+
+  // Inverse of logarithmKernel
+  template <class P>
+  static void exponentialKernel(const P (&w)[3], const P (&v)[3], P (&q)[8]) {
+    P h2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    P h = sqrt(h2);
+    P sinH;
+    P cosH;
+    SimdMath::sincos(h, sinH, cosH);
+
+    // sin(h) / h and its derivative over h, (cos(h) - sin(h) / h) / h^2
+    typename P::Mask small = h < P(Kernels::smallAngle);
+    P safeH = max(h, P(Kernels::smallAngle));
+    P sinc = select(small, P(1.0) - h2 * P(1.0 / 6.0), sinH / safeH);
+    P slope = select(small, P(-1.0 / 3.0) + h2 * P(1.0 / 30.0),
+                     (cosH - sinc) / (safeH * safeH));
+    P wv = w[0] * v[0] + w[1] * v[1] + w[2] * v[2];
+
+    q[0] = cosH;
+    q[4] = -sinc * wv;
+    for (std::size_t k = 0; k < 3; ++k) {
+      q[k + 1] = sinc * w[k];
+      q[k + 5] = sinc * v[k] + slope * wv * w[k];
+    }
+  }
+
+  template <class P>
+  static void sclerpKernel(const P (&a)[8], const P (&b)[8], P t, P (&q)[8]) {
+    // The conjugate of a unit dual quaternion is its inverse, and b or -b,
+    // whichever is nearer, keeps the step short and the logarithm's w >= 0
+    P alignment = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    P sign = select(alignment < P(0.0), P(-1.0), P(1.0));
+    P inverse[8];
+    P target[8];
+    for (std::size_t k = 0; k < 8; ++k) {
+      inverse[k] = k % 4 == 0 ? a[k] : -a[k];
+      target[k] = sign * b[k];
+    }
+    P step[8];
+    composeKernel(inverse, target, step);
+
+    P w[3];
+    P v[3];
+    logarithmKernel(step, w, v);
+    for (std::size_t k = 0; k < 3; ++k) {
+      w[k] = t * w[k];
+      v[k] = t * v[k];
+    }
+    exponentialKernel(w, v, step);
+    composeKernel(a, step, q);
+  }
+};
+
+using DualQuaternionAlgebra = BasicDualQuaternionAlgebra<double>;
+using DualQuaternionAlgebraf = BasicDualQuaternionAlgebra<float>;
@@ -0,0 +1,287 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+// Error of an estimated rotation series against a ground truth sampled at the
+// same times, streamed through in chunks so that hours of data take no more
+// memory than a few seconds of it
+template <class Scalar> class BasicRotationErrorMetrics {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+
+  // Samples per pass of the kernels, which also bounds the scratch memory
+  static constexpr std::size_t CHUNK_SIZE = 1 << 16;
+
+  // Percentiles come out of a histogram with logarithmic bins from
+  // MIN_ANGLE to pi, each 0.4% wider than the last, so they are good to 0.4%
+  // of their value. Anything smaller falls into the first bin.
+  static constexpr std::size_t NUM_BINS = 4096;
+  static constexpr double MIN_ANGLE = 1e-6;
+
+public:
+  template <class T> using SO3Arrays = typename SO3::template SO3Arrays<T>;
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  struct Summary {
+    std::size_t count;
+    // Angle of estimate^T truth in radians
+    Scalar rmsGeodesic;
+    Scalar meanGeodesic;
+    Scalar maxGeodesic;
+    // Frobenius norm of estimate - truth, 2 sqrt(2) sin(angle / 2)
+    Scalar rmsChordal;
+    Scalar maxChordal;
+  };
+
+  // Statistics of windowLength consecutive samples starting at begin
+  struct Window {
+    std::size_t begin;
+    Scalar rmsGeodesic;
+    Scalar meanGeodesic;
+    Scalar maxGeodesic;
+    Scalar rmsChordal;
+  };
+
+  // Keeps the statistics of the last maxWindows windows of windowLength
+  // samples, older ones are dropped
+  explicit BasicRotationErrorMetrics(std::size_t windowLength,
+                                     std::size_t maxWindows = 1024)
+      : mWindowLength(windowLength), mMaxWindows(maxWindows) {
+    if (windowLength == 0 || maxWindows == 0) {
+      throw std::runtime_error(
+          "Error metrics need windows of at least one sample!");
+    }
+    reset();
+  }
+
+  // Per sample geodesic angle, through the logarithmic map of the relative
+  // rotation, and chordal distance
+  static void errors(const SO3Arrays<const Scalar> &estimate,
+                     const SO3Arrays<const Scalar> &truth, Scalar *geodesic,
+                     Scalar *chordal, std::size_t count) {
+    Kernels::parallelForEachPack(count, 20, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P E[9];
+      P T[9];
+      P angle;
+      P distance;
+      Kernels::load(estimate.entries, index, E);
+      Kernels::load(truth.entries, index, T);
+      errorKernel(E, T, angle, distance);
+      angle.store(geodesic + index);
+      distance.store(chordal + index);
+    });
+  }
+
+  // Appends the next count samples of both series
+  void add(const SO3Arrays<const Scalar> &estimate,
+           const SO3Arrays<const Scalar> &truth, std::size_t count) {
+    for (std::size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+      std::size_t size = std::min(CHUNK_SIZE, count - begin);
+      errors(offset(estimate, begin), offset(truth, begin), mGeodesic.data(),
+             mChordal.data(), size);
+      for (std::size_t i = 0; i < size; ++i) {
+        accumulate(mGeodesic[i], mChordal[i]);
+      }
+    }
+  }
+
+  // Appends every sample of two series of the same length held in one of the
+  // compressed forms of Compression.hpp, which are decoded a chunk at a time
+  template <class Compressed>
+  void add(const Compressed &estimate, const Compressed &truth) {
+    if (estimate.size() != truth.size()) {
+      throw std::runtime_error("Error metrics need series of equal length!");
+    }
+    std::array<std::array<std::vector<Scalar>, 4>, 2> components;
+    std::array<QuaternionArrays<Scalar>, 2> decoded;
+    for (std::size_t series = 0; series < 2; ++series) {
+      for (std::size_t k = 0; k < 4; ++k) {
+        components[series][k].resize(CHUNK_SIZE);
+        decoded[series].components[k] = components[series][k].data();
+      }
+    }
+    for (std::size_t begin = 0; begin < estimate.size(); begin += CHUNK_SIZE) {
+      std::size_t size = std::min(CHUNK_SIZE, estimate.size() - begin);
+      estimate.decode(begin, decoded[0], size);
+      truth.decode(begin, decoded[1], size);
+      Kernels::parallelForEachPack(size, 10, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P q[4];
+        P E[9];
+        P T[9];
+        P angle;
+        P distance;
+        Kernels::load(decoded[0].components, index, q);
+        Kernels::quaternionToMatrixKernel(q, E);
+        Kernels::load(decoded[1].components, index, q);
+        Kernels::quaternionToMatrixKernel(q, T);
+        errorKernel(E, T, angle, distance);
+        angle.store(mGeodesic.data() + index);
+        distance.store(mChordal.data() + index);
+      });
+      for (std::size_t i = 0; i < size; ++i) {
+        accumulate(mGeodesic[i], mChordal[i]);
+      }
+    }
+  }
+
+  Summary summary() const {
+    Summary summary;
+    summary.count = mTotal.count;
+    summary.rmsGeodesic = mTotal.rmsGeodesic();
+    summary.meanGeodesic = mTotal.meanGeodesic();
+    summary.maxGeodesic = mTotal.maxGeodesic;
+    summary.rmsChordal = mTotal.rmsChordal();
+    summary.maxChordal = mTotal.maxChordal;
+    return summary;
+  }
+
+  // Geodesic angle below which fraction of the samples lie
+  Scalar geodesicPercentile(Scalar fraction) const {
+    if (!(fraction >= 0 && fraction <= 1)) {
+      throw std::runtime_error("Percentiles need a fraction in [0, 1]!");
+    }
+    if (mTotal.count == 0) {
+      return 0;
+    }
+
+    // Rank among the samples, found in the histogram and placed within its
+    // bin as if the bin were evenly filled in the logarithm
+    double rank = static_cast<double>(fraction) * (mTotal.count - 1);
+    std::uint64_t below = 0;
+    std::size_t bin = 0;
+    while (bin + 1 < NUM_BINS && below + mHistogram[bin] <= rank) {
+      below += mHistogram[bin];
+      ++bin;
+    }
+    double within = (rank - below + 0.5) / std::max<std::uint64_t>(
+                                                mHistogram[bin], 1);
+    double angle = MIN_ANGLE * std::exp((bin + std::min(within, 1.0)) /
+                                        binsPerLog());
+    return static_cast<Scalar>(std::min<double>(angle, mTotal.maxGeodesic));
+  }
+
+  // The chordal distance grows with the angle, so its percentiles follow
+  Scalar chordalPercentile(Scalar fraction) const {
+    return chordalOf(geodesicPercentile(fraction));
+  }
+
+  // Completed windows, oldest first
+  const std::deque<Window> &windows() const { return mWindows; }
+
+  void reset() {
+    mGeodesic.resize(CHUNK_SIZE);
+    mChordal.resize(CHUNK_SIZE);
+    mHistogram.fill(0);
+    mTotal = Moments();
+    mWindow = Moments();
+    mWindows.clear();
+  }
+
+private:
+  // Sums are kept in double, in float they would stop picking up small
+  // errors after a few million samples
+  struct Moments {
+    std::size_t count = 0;
+    double sumGeodesic = 0;
+    double sumSquaredGeodesic = 0;
+    double sumSquaredChordal = 0;
+    Scalar maxGeodesic = 0;
+    Scalar maxChordal = 0;
+
+    Scalar rmsGeodesic() const {
+      return count == 0 ? 0 : std::sqrt(sumSquaredGeodesic / count);
+    }
+    Scalar meanGeodesic() const { return count == 0 ? 0 : sumGeodesic / count; }
+    Scalar rmsChordal() const {
+      return count == 0 ? 0 : std::sqrt(sumSquaredChordal / count);
+    }
+
+    void add(Scalar geodesic, Scalar chordal) {
+      ++count;
+      sumGeodesic += geodesic;
+      sumSquaredGeodesic += static_cast<double>(geodesic) * geodesic;
+      sumSquaredChordal += static_cast<double>(chordal) * chordal;
+      maxGeodesic = std::max(maxGeodesic, geodesic);
+      maxChordal = std::max(maxChordal, chordal);
+    }
+  };
+
+  std::size_t mWindowLength;
+  std::size_t mMaxWindows;
+  std::vector<Scalar> mGeodesic;
+  std::vector<Scalar> mChordal;
+  std::array<std::uint64_t, NUM_BINS> mHistogram;
+  Moments mTotal;
+  // The window being filled
+  Moments mWindow;
+  std::deque<Window> mWindows;
+
+  static double binsPerLog() {
+    static const double value = NUM_BINS / std::log(M_PI / MIN_ANGLE);
+    return value;
+  }
+
+  static Scalar chordalOf(Scalar angle) {
+    return static_cast<Scalar>(2 * M_SQRT2) * std::sin(angle / 2);
+  }
+
+  static SO3Arrays<const Scalar> offset(const SO3Arrays<const Scalar> &arrays,
+                                        std::size_t begin) {
+    SO3Arrays<const Scalar> shifted;
+    for (std::size_t k = 0; k < 9; ++k) {
+      shifted.entries[k] = arrays.entries[k] + begin;
+    }
+    return shifted;
+  }
+
+  void accumulate(Scalar geodesic, Scalar chordal) {
+    double bins = std::log(std::max<double>(geodesic, MIN_ANGLE) / MIN_ANGLE) *
+                  binsPerLog();
+    ++mHistogram[std::min(static_cast<std::size_t>(bins), NUM_BINS - 1)];
+
+    mTotal.add(geodesic, chordal);
+    mWindow.add(geodesic, chordal);
+    if (mWindow.count == mWindowLength) {
+      if (mWindows.size() == mMaxWindows) {
+        mWindows.pop_front();
+      }
+      mWindows.push_back({mTotal.count - mWindowLength, mWindow.rmsGeodesic(),
+                          mWindow.meanGeodesic(), mWindow.maxGeodesic,
+                          mWindow.rmsChordal()});
+      mWindow = Moments();
+    }
+  }
+
+  template <class P>
+  static void errorKernel(const P (&E)[9], const P (&T)[9], P &geodesic,
+                          P &chordal) {
+    P transpose[9];
+    P relative[9];
+    P w[3];
+    P squared = P(0.0);
+    for (std::size_t k = 0; k < 9; ++k) {
+      transpose[k] = T[(k % 3) * 3 + k / 3];
+      P difference = E[k] - T[k];
+      squared = squared + difference * difference;
+    }
+    Kernels::multiplyKernel(transpose, E, relative);
+    Kernels::logarithmicMapKernel(relative, w);
+    geodesic = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    chordal = sqrt(squared);
+  }
+};
+
+using RotationErrorMetrics = BasicRotationErrorMetrics<double>;
+using RotationErrorMetricsf = BasicRotationErrorMetrics<float>;
@@ -0,0 +1,287 @@
+#include "GpuLieAlgebra.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+using namespace wgpu;
+
+GpuLieAlgebra::GpuLieAlgebra(Device device, ShaderModule module)
+    : mDevice(device), mQueue(device.getQueue()) {
+  // Every plane of the largest input or output has to fit in one binding
+  SupportedLimits limits;
+  mDevice.getLimits(&limits);
+  std::uint64_t bytes = std::min(limits.limits.maxStorageBufferBindingSize,
+                                 limits.limits.maxBufferSize);
+  mMaxCount = static_cast<std::size_t>(bytes / (9 * sizeof(float)));
+
+  // The uniforms, the two inputs and the output, shared by every kernel
+  std::array<BindGroupLayoutEntry, 4> entries;
+  for (std::size_t binding = 0; binding < entries.size(); ++binding) {
+    entries[binding] = Default;
+    entries[binding].binding = static_cast<std::uint32_t>(binding);
+    entries[binding].visibility = ShaderStage::Compute;
+  }
+  entries[0].buffer.type = BufferBindingType::Uniform;
+  entries[0].buffer.minBindingSize = sizeof(Params);
+  entries[1].buffer.type = BufferBindingType::ReadOnlyStorage;
+  entries[2].buffer.type = BufferBindingType::ReadOnlyStorage;
+  entries[3].buffer.type = BufferBindingType::Storage;
+
+  BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+  bindGroupLayoutDesc.entryCount = entries.size();
+  bindGroupLayoutDesc.entries = entries.data();
+  mBindGroupLayout = mDevice.createBindGroupLayout(bindGroupLayoutDesc);
+
+  PipelineLayoutDescriptor layoutDesc{};
+  layoutDesc.bindGroupLayoutCount = 1;
+  layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout *)&mBindGroupLayout;
+  mPipelineLayout = mDevice.createPipelineLayout(layoutDesc);
+
+  const char *entryPoints[NUM_KERNELS] = {"logarithmic_map", "exponential_map",
+                                          "compose"};
+  for (std::size_t kernel = 0; kernel < NUM_KERNELS; ++kernel) {
+    ComputePipelineDescriptor pipelineDesc;
+    pipelineDesc.layout = mPipelineLayout;
+    pipelineDesc.compute.module = module;
+    pipelineDesc.compute.entryPoint = entryPoints[kernel];
+    pipelineDesc.compute.constantCount = 0;
+    pipelineDesc.compute.constants = nullptr;
+    mPipelines[kernel] = mDevice.createComputePipeline(pipelineDesc);
+  }
+
+  BufferDescriptor bufferDesc;
+  bufferDesc.size = sizeof(Params);
+  bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+  bufferDesc.mappedAtCreation = false;
+  mParams = mDevice.createBuffer(bufferDesc);
+}
+
+GpuLieAlgebra::~GpuLieAlgebra() {
+  wait();
+  releaseBuffers();
+  mParams.destroy();
+  mParams.release();
+  for (ComputePipeline &pipeline : mPipelines) {
+    pipeline.release();
+  }
+  mPipelineLayout.release();
+  mBindGroupLayout.release();
+  mQueue.release();
+}
+
+void GpuLieAlgebra::logarithmicMap(const SO3Arrays<const float> &SO3,
+                                   std::size_t count) {
+  upload(SO3.entries.data(), nullptr, 9, count);
+  dispatch(LOGARITHMIC_MAP, count, 3);
+}
+
+void GpuLieAlgebra::exponentialMap(const TangentArrays<const float> &so3,
+                                   std::size_t count) {
+  upload(so3.components.data(), nullptr, 3, count);
+  dispatch(EXPONENTIAL_MAP, count, 9);
+}
+
+void GpuLieAlgebra::compose(const QuaternionArrays<const float> &lhs,
+                            const QuaternionArrays<const float> &rhs,
+                            std::size_t count) {
+  upload(lhs.components.data(), rhs.components.data(), 4, count);
+  dispatch(COMPOSE, count, 4);
+}
+
+void GpuLieAlgebra::readBack(const TangentArrays<float> &so3,
+                             std::function<void(bool)> done) {
+  if (mNumComponents != 3) {
+    throw std::runtime_error("GPU result is not a batch of tangent vectors!");
+  }
+  readBack(so3.components.data(), 3, std::move(done));
+}
+
+void GpuLieAlgebra::readBack(const SO3Arrays<float> &SO3,
+                             std::function<void(bool)> done) {
+  if (mNumComponents != 9) {
+    throw std::runtime_error("GPU result is not a batch of matrices!");
+  }
+  readBack(SO3.entries.data(), 9, std::move(done));
+}
+
+void GpuLieAlgebra::readBack(const QuaternionArrays<float> &q,
+                             std::function<void(bool)> done) {
+  if (mNumComponents != 4) {
+    throw std::runtime_error("GPU result is not a batch of quaternions!");
+  }
+  readBack(q.components.data(), 4, std::move(done));
+}
+
+void GpuLieAlgebra::poll() {
+#ifdef WEBGPU_BACKEND_DAWN
+  mDevice.tick();
+#else
+  wgpuDevicePoll(mDevice, false, nullptr);
+#endif
+}
+
+void GpuLieAlgebra::wait() {
+  while (mIsReadingBack) {
+#ifdef WEBGPU_BACKEND_DAWN
+    mDevice.tick();
+#else
+    wgpuDevicePoll(mDevice, true, nullptr);
+#endif
+  }
+}
+
+void GpuLieAlgebra::upload(const float *const *lhs, const float *const *rhs,
+                           std::size_t numInputs, std::size_t count) {
+  if (mIsReadingBack) {
+    throw std::runtime_error("GPU batch started before the read back ended!");
+  }
+  if (count > mMaxCount) {
+    throw std::runtime_error("GPU batch does not fit in a storage buffer!");
+  }
+
+  // Rounded up to whole workgroups, every buffer holds 9 planes but the rhs
+  // which only ever holds quaternions
+  if (count > mCapacity) {
+    releaseBuffers();
+    mCapacity = std::min<std::size_t>(
+        (count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE * WORKGROUP_SIZE,
+        mMaxCount);
+    std::size_t plane = mCapacity * sizeof(float);
+
+    BufferDescriptor bufferDesc;
+    bufferDesc.mappedAtCreation = false;
+    bufferDesc.size = 9 * plane;
+    bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Storage;
+    mLhs = mDevice.createBuffer(bufferDesc);
+    bufferDesc.size = 4 * plane;
+    mRhs = mDevice.createBuffer(bufferDesc);
+    bufferDesc.size = 9 * plane;
+    bufferDesc.usage = BufferUsage::CopySrc | BufferUsage::Storage;
+    mOutput = mDevice.createBuffer(bufferDesc);
+    bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+    mStaging = mDevice.createBuffer(bufferDesc);
+
+    std::array<BindGroupEntry, 4> bindings;
+    Buffer buffers[4] = {mParams, mLhs, mRhs, mOutput};
+    std::size_t sizes[4] = {sizeof(Params), 9 * plane, 4 * plane, 9 * plane};
+    for (std::size_t binding = 0; binding < bindings.size(); ++binding) {
+      bindings[binding].binding = static_cast<std::uint32_t>(binding);
+      bindings[binding].buffer = buffers[binding];
+      bindings[binding].offset = 0;
+      bindings[binding].size = sizes[binding];
+    }
+    BindGroupDescriptor bindGroupDesc;
+    bindGroupDesc.layout = mBindGroupLayout;
+    bindGroupDesc.entryCount = bindings.size();
+    bindGroupDesc.entries = bindings.data();
+    mBindGroup = mDevice.createBindGroup(bindGroupDesc);
+  }
+
+  // Straight from the structure of arrays, one write per plane
+  for (std::size_t k = 0; k < numInputs && count > 0; ++k) {
+    std::size_t offset = k * mCapacity * sizeof(float);
+    mQueue.writeBuffer(mLhs, offset, lhs[k], count * sizeof(float));
+    if (rhs != nullptr) {
+      mQueue.writeBuffer(mRhs, offset, rhs[k], count * sizeof(float));
+    }
+  }
+  Params params = {static_cast<std::uint32_t>(count),
+                   static_cast<std::uint32_t>(mCapacity),
+                   {0, 0}};
+  mQueue.writeBuffer(mParams, 0, &params, sizeof(params));
+}
+
+void GpuLieAlgebra::dispatch(Kernel kernel, std::size_t count,
+                             std::size_t numComponents) {
+  mCount = count;
+  mNumComponents = numComponents;
+  if (count == 0) {
+    return;
+  }
+
+  // Along x as far as it goes, then wrapping into y
+  std::size_t workgroups = (count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+  std::uint32_t x = static_cast<std::uint32_t>(
+      std::min<std::size_t>(workgroups, MAX_WORKGROUPS));
+  std::uint32_t y = static_cast<std::uint32_t>((workgroups + x - 1) / x);
+
+  CommandEncoder encoder = mDevice.createCommandEncoder();
+  ComputePassEncoder computePass = encoder.beginComputePass();
+  computePass.setPipeline(mPipelines[kernel]);
+  computePass.setBindGroup(0, mBindGroup, 0, nullptr);
+  computePass.dispatchWorkgroups(x, y, 1);
+  computePass.end();
+  computePass.release();
+
+  CommandBuffer command = encoder.finish();
+  encoder.release();
+  mQueue.submit(command);
+  command.release();
+}
+
+void GpuLieAlgebra::readBack(float *const *components,
+                             std::size_t numComponents,
+                             std::function<void(bool)> done) {
+  if (mIsReadingBack) {
+    throw std::runtime_error("GPU read back started before the last ended!");
+  }
+  if (mCount == 0) {
+    done(true);
+    return;
+  }
+
+  // Up to the end of the last plane, the copy and the mapping need sizes that
+  // are multiples of 4 bytes, which floats always are
+  std::size_t plane = mCapacity * sizeof(float);
+  std::size_t size = (numComponents - 1) * plane + mCount * sizeof(float);
+  CommandEncoder encoder = mDevice.createCommandEncoder();
+  encoder.copyBufferToBuffer(mOutput, 0, mStaging, 0, size);
+  CommandBuffer command = encoder.finish();
+  encoder.release();
+  mQueue.submit(command);
+  command.release();
+
+  std::array<float *, 9> destinations;
+  std::copy(components, components + numComponents, destinations.begin());
+  mIsReadingBack = true;
+  mMapCallback = mStaging.mapAsync(
+      MapMode::Read, 0, size,
+      [this, destinations, numComponents, size,
+       done = std::move(done)](BufferMapAsyncStatus status) {
+        mIsReadingBack = false;
+        if (status != BufferMapAsyncStatus::Success) {
+          std::cerr << "GPU read back failed: " << status << std::endl;
+          done(false);
+          return;
+        }
+        const float *mapped =
+            static_cast<const float *>(mStaging.getConstMappedRange(0, size));
+        for (std::size_t k = 0; k < numComponents; ++k) {
+          const float *source = mapped + k * mCapacity;
+          std::copy(source, source + mCount, destinations[k]);
+        }
+        mStaging.unmap();
+        done(true);
+      });
+}
+
+void GpuLieAlgebra::releaseBuffers() {
+  if (mBindGroup) {
+    mBindGroup.release();
+    mBindGroup = nullptr;
+  }
+  for (Buffer *buffer : {&mLhs, &mRhs, &mOutput, &mStaging}) {
+    if (*buffer) {
+      buffer->destroy();
+      buffer->release();
+      *buffer = nullptr;
+    }
+  }
+  mCapacity = 0;
+}
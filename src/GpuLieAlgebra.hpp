@@ -0,0 +1,110 @@
+#pragma once
+#include <webgpu/webgpu.hpp>
+
+#include "LieAlgebra.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// The batch logarithmic map, exponential map and composition of LieAlgebraf as
+// compute shaders (resources/lie_algebra.wgsl) on a WebGPU device. Inputs are
+// uploaded into storage buffers laid out like the structure of arrays views,
+// one plane of stride() floats per component, and the result stays on the
+// device in output() until it is read back, so draws and further passes can
+// use it without a round trip through the CPU. WGSL has no double, so there is
+// no double precision version.
+class GpuLieAlgebra {
+public:
+  template <class T> using SO3Arrays = LieAlgebraf::SO3Arrays<T>;
+  template <class T> using TangentArrays = LieAlgebraf::TangentArrays<T>;
+  template <class T>
+  using QuaternionArrays = LieAlgebraf::QuaternionArrays<T>;
+
+  // module is lie_algebra.wgsl, loaded like any other shader
+  GpuLieAlgebra(wgpu::Device device, wgpu::ShaderModule module);
+  ~GpuLieAlgebra();
+
+  // The read back callback holds on to this
+  GpuLieAlgebra(const GpuLieAlgebra &) = delete;
+  GpuLieAlgebra &operator=(const GpuLieAlgebra &) = delete;
+
+  // Each uploads count inputs and queues the kernel over them. The buffers
+  // only grow, up to maxCount().
+  void logarithmicMap(const SO3Arrays<const float> &SO3, std::size_t count);
+  void exponentialMap(const TangentArrays<const float> &so3,
+                      std::size_t count);
+  void compose(const QuaternionArrays<const float> &lhs,
+               const QuaternionArrays<const float> &rhs, std::size_t count);
+
+  // Result of the last kernel, component k of element i is float
+  // k * stride() + i
+  wgpu::Buffer output() const { return mOutput; }
+  std::size_t stride() const { return mCapacity; }
+
+  // Copies the result of the last kernel into arrays once the device is done
+  // with it, then calls done with true. When the device fails to map the
+  // result done gets false and the arrays are left alone. Either happens in
+  // poll(), so the arrays have to outlive it.
+  void readBack(const TangentArrays<float> &so3,
+                std::function<void(bool)> done);
+  void readBack(const SO3Arrays<float> &SO3, std::function<void(bool)> done);
+  void readBack(const QuaternionArrays<float> &q,
+                std::function<void(bool)> done);
+
+  bool isReadingBack() const { return mIsReadingBack; }
+
+  // Finishes a read back the device is done with without blocking, for a frame
+  // loop to call once a frame
+  void poll();
+
+  // Blocks until the read back is done
+  void wait();
+
+  // Largest batch the storage buffers of the device can hold
+  std::size_t maxCount() const { return mMaxCount; }
+
+private:
+  static constexpr std::uint32_t WORKGROUP_SIZE = 64;
+  static constexpr std::uint32_t MAX_WORKGROUPS = 65535;
+
+  enum Kernel { LOGARITHMIC_MAP, EXPONENTIAL_MAP, COMPOSE, NUM_KERNELS };
+
+  // Matches Params in the shader, padded to a multiple of 16 bytes
+  struct Params {
+    std::uint32_t count;
+    std::uint32_t stride;
+    std::uint32_t padding[2];
+  };
+
+  wgpu::Device mDevice;
+  wgpu::Queue mQueue;
+  wgpu::BindGroupLayout mBindGroupLayout = nullptr;
+  wgpu::PipelineLayout mPipelineLayout = nullptr;
+  std::array<wgpu::ComputePipeline, NUM_KERNELS> mPipelines;
+  wgpu::Buffer mParams = nullptr;
+  wgpu::Buffer mLhs = nullptr;
+  wgpu::Buffer mRhs = nullptr;
+  wgpu::Buffer mOutput = nullptr;
+  wgpu::Buffer mStaging = nullptr;
+  wgpu::BindGroup mBindGroup = nullptr;
+  std::size_t mMaxCount = 0;
+  std::size_t mCapacity = 0;
+
+  // Of the last kernel
+  std::size_t mCount = 0;
+  std::size_t mNumComponents = 0;
+
+  bool mIsReadingBack = false;
+  std::unique_ptr<wgpu::BufferMapCallback> mMapCallback;
+
+  // Makes room for count elements and uploads numInputs planes of each input
+  void upload(const float *const *lhs, const float *const *rhs,
+              std::size_t numInputs, std::size_t count);
+  void dispatch(Kernel kernel, std::size_t count,
+                std::size_t numComponents);
+  void readBack(float *const *components, std::size_t numComponents,
+                std::function<void(bool)> done);
+  void releaseBuffers();
+};
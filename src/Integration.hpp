@@ -0,0 +1,233 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Orientation from a stream of body frame angular rates sampled every dt, such
+// as a gyro. The rate is taken to vary linearly between samples. Every method
+// is left invariant, so each step is a quaternion increment that does not
+// depend on the orientation it starts from: the increments of a chunk are
+// worked out in parallel and then chained one after another.
+template <class Scalar> class BasicRotationIntegrator {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+  // Samples per pass of the increment kernel
+  static constexpr std::size_t CHUNK_SIZE = 1 << 12;
+
+public:
+  enum class Method {
+    // exp of the rate at the start of the step, first order
+    ExponentialEuler,
+    // Classical Runge-Kutta on the quaternion kinematics, projected back onto
+    // the unit quaternions after every step
+    RK4,
+    // Fourth order Magnus expansion, the mean rate plus the coning term
+    Magnus
+  };
+
+  template <class T>
+  using TangentArrays = typename SO3::template TangentArrays<T>;
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  BasicRotationIntegrator(Scalar dt, Method method,
+                          const Quaternion &initial = Quaternion::Identity())
+      : mDt(dt), mMethod(method) {
+    if (!(dt > 0)) {
+      throw std::runtime_error("Integration needs a positive dt!");
+    }
+    for (std::vector<Scalar> &component : mIncrements) {
+      component.resize(CHUNK_SIZE);
+    }
+    reset(initial);
+  }
+
+  // Writes the orientation at the time of each of the count rates. The first
+  // rate of the stream is where it starts, so its orientation is the initial
+  // one.
+  void integrate(const TangentArrays<const Scalar> &rates,
+                 const QuaternionArrays<Scalar> &orientations,
+                 std::size_t count) {
+    for (std::size_t begin = 0; begin < count; begin += CHUNK_SIZE) {
+      std::size_t size = std::min(CHUNK_SIZE, count - begin);
+
+      // Each step ends on a rate of this chunk and starts on the one before,
+      // the first from the previous chunk
+      Scalar first[3];
+      for (std::size_t k = 0; k < 3; ++k) {
+        first[k] = mIsStarted ? mRate[k] : rates.components[k][begin];
+      }
+      Kernels::parallelForEachPack(size, 10, [&](auto tag, std::size_t index) {
+        using P = typename decltype(tag)::type;
+        P start[3];
+        P end[3];
+        P increment[4];
+        for (std::size_t k = 0; k < 3; ++k) {
+          const Scalar *rate = rates.components[k] + begin + index;
+          end[k] = P::load(rate);
+          // Lane 0 of the first pack reaches back into the previous chunk
+          if (index == 0) {
+            Scalar previous[P::width];
+            previous[0] = first[k];
+            for (std::size_t lane = 1; lane < P::width; ++lane) {
+              previous[lane] = rate[lane - 1];
+            }
+            start[k] = P::load(previous);
+          } else {
+            start[k] = P::load(rate - 1);
+          }
+        }
+        incrementKernel(start, end, P(mDt), increment);
+        for (std::size_t k = 0; k < 4; ++k) {
+          increment[k].store(mIncrements[k].data() + index);
+        }
+      });
+
+      // Nothing turns before the first rate of the stream
+      if (!mIsStarted) {
+        for (std::size_t k = 0; k < 4; ++k) {
+          mIncrements[k][0] = k == 0 ? Scalar(1) : Scalar(0);
+        }
+      }
+
+      // The chain is serial, each step is a product and a renormalisation so
+      // that rounding does not build up over hours of samples
+      Pack<Scalar, 1> q[4] = {mOrientation[0], mOrientation[1],
+                              mOrientation[2], mOrientation[3]};
+      for (std::size_t i = 0; i < size; ++i) {
+        Pack<Scalar, 1> increment[4];
+        for (std::size_t k = 0; k < 4; ++k) {
+          increment[k] = mIncrements[k][i];
+        }
+        Pack<Scalar, 1> next[4];
+        Kernels::composeKernel(q, increment, next);
+        normalizeKernel(next);
+        for (std::size_t k = 0; k < 4; ++k) {
+          q[k] = next[k];
+          orientations.components[k][begin + i] = next[k].v;
+        }
+      }
+
+      for (std::size_t k = 0; k < 4; ++k) {
+        mOrientation[k] = q[k].v;
+      }
+      for (std::size_t k = 0; k < 3; ++k) {
+        mRate[k] = rates.components[k][begin + size - 1];
+      }
+      mIsStarted = true;
+    }
+  }
+
+  // Orientation at the last rate integrated so far
+  Quaternion orientation() const {
+    return Quaternion(mOrientation[0], mOrientation[1], mOrientation[2],
+                      mOrientation[3]);
+  }
+
+  // Starts a new stream from initial
+  void reset(const Quaternion &initial = Quaternion::Identity()) {
+    Quaternion unit = initial.normalized();
+    mOrientation = {unit.w(), unit.x(), unit.y(), unit.z()};
+    mIsStarted = false;
+  }
+
+private:
+  Scalar mDt;
+  Method mMethod;
+  bool mIsStarted = false;
+  std::array<Scalar, 4> mOrientation;
+  std::array<Scalar, 3> mRate;
+  std::array<std::vector<Scalar>, 4> mIncrements;
+
+  template <class P>
+  void incrementKernel(const P (&start)[3], const P (&end)[3], P dt,
+                       P (&q)[4]) const {
+    switch (mMethod) {
+    case Method::ExponentialEuler: {
+      P w[3] = {start[0] * dt, start[1] * dt, start[2] * dt};
+      Kernels::quaternionExponentialMapKernel(w, q);
+      break;
+    }
+    case Method::RK4:
+      rungeKuttaKernel(start, end, dt, q);
+      break;
+    // The default is never taken, it lets the compiler see q is always set
+    case Method::Magnus:
+    default: {
+      // Off by the fifth power of dt for a rate that is linear in time, the
+      // cross product accounts for its axis turning over the step
+      P coning = dt * dt * P(1.0 / 12.0);
+      P w[3] = {
+          dt * P(0.5) * (start[0] + end[0]) +
+              coning * (start[1] * end[2] - start[2] * end[1]),
+          dt * P(0.5) * (start[1] + end[1]) +
+              coning * (start[2] * end[0] - start[0] * end[2]),
+          dt * P(0.5) * (start[2] + end[2]) +
+              coning * (start[0] * end[1] - start[1] * end[0])};
+      Kernels::quaternionExponentialMapKernel(w, q);
+      break;
+    }
+    }
+  }
+
+  // q' = q (0, w) / 2 from the identity, with the rate at the start, middle and
+  // end of the step
+  template <class P>
+  static void rungeKuttaKernel(const P (&start)[3], const P (&end)[3], P dt,
+                               P (&q)[4]) {
+    P middle[3];
+    for (std::size_t k = 0; k < 3; ++k) {
+      middle[k] = P(0.5) * (start[k] + end[k]);
+    }
+    P identity[4] = {P(1.0), P(0.0), P(0.0), P(0.0)};
+    P k1[4];
+    P k2[4];
+    P k3[4];
+    P k4[4];
+    P stage[4];
+    derivative(identity, start, k1);
+    for (std::size_t k = 0; k < 4; ++k) {
+      stage[k] = identity[k] + P(0.5) * dt * k1[k];
+    }
+    derivative(stage, middle, k2);
+    for (std::size_t k = 0; k < 4; ++k) {
+      stage[k] = identity[k] + P(0.5) * dt * k2[k];
+    }
+    derivative(stage, middle, k3);
+    for (std::size_t k = 0; k < 4; ++k) {
+      stage[k] = identity[k] + dt * k3[k];
+    }
+    derivative(stage, end, k4);
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[k] = identity[k] +
+             dt * P(1.0 / 6.0) * (k1[k] + P(2.0) * (k2[k] + k3[k]) + k4[k]);
+    }
+    normalizeKernel(q);
+  }
+
+  template <class P>
+  static void derivative(const P (&q)[4], const P (&w)[3], P (&dq)[4]) {
+    P rate[4] = {P(0.0), P(0.5) * w[0], P(0.5) * w[1], P(0.5) * w[2]};
+    Kernels::composeKernel(q, rate, dq);
+  }
+
+  template <class P> static void normalizeKernel(P (&q)[4]) {
+    P inverseNorm =
+        P(1.0) / sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[k] = q[k] * inverseNorm;
+    }
+  }
+};
+
+using RotationIntegrator = BasicRotationIntegrator<double>;
+using RotationIntegratorf = BasicRotationIntegrator<float>;
@@ -0,0 +1,272 @@
+#pragma once
+#include "Canonicalization.hpp"
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+// Dense evaluation of a rotation trajectory through sparse keyframes.
+// Everything that only depends on the keyframes is folded into a per segment
+// table when the interpolator is built, so evaluating a time is a lookup into
+// that table followed by exp maps and quaternion products.
+template <class Scalar> class BasicRotationInterpolator {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+public:
+  enum class Method {
+    // Geodesic between neighbouring keyframes, one exp map per query
+    Slerp,
+    // Shoemake's spherical quadrangle, continuous angular velocity through the
+    // keyframes
+    Squad,
+    // Cumulative cubic B-spline, continuous angular acceleration but it only
+    // approximates the keyframes
+    BSpline
+  };
+
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  // times must be strictly increasing and hold one entry per keyframe
+  BasicRotationInterpolator(std::vector<Quaternion> keyframes,
+                            const std::vector<Scalar> &times, Method method)
+      : mMethod(method) {
+    if (keyframes.size() < 2 || keyframes.size() != times.size()) {
+      throw std::runtime_error(
+          "Interpolation needs at least two keyframes, each with a time!");
+    }
+
+    // q and -q are the same rotation, keep neighbours on the same hemisphere
+    // so the output quaternions are continuous too
+    BasicQuaternionCanonicalizer<Scalar> canonicalizer;
+    for (Quaternion &keyframe : keyframes) {
+      bool isDegenerate;
+      keyframe = canonicalizer.canonicalize(keyframe, isDegenerate);
+      if (isDegenerate) {
+        throw std::runtime_error("Interpolation keyframes need a unit norm!");
+      }
+    }
+
+    std::size_t numSegments = keyframes.size() - 1;
+    mSegments.resize(numSegments);
+    for (std::size_t i = 0; i < numSegments; ++i) {
+      Segment &segment = mSegments[i];
+      segment.start = times[i];
+      segment.inverseDuration = 1 / (times[i + 1] - times[i]);
+    }
+
+    switch (method) {
+    case Method::Slerp:
+      for (std::size_t i = 0; i < numSegments; ++i) {
+        setQuaternion(mSegments[i].base, keyframes[i]);
+        setTangent(mSegments[i].tangents[0],
+                   between(keyframes[i], keyframes[i + 1]));
+      }
+      break;
+    case Method::Squad: {
+      // Inner control points s_i = q_i exp(-(log(q_i^-1 q_i+1) + log(q_i^-1
+      // q_i-1)) / 4), the end keyframes are their own control points
+      std::vector<Quaternion> control(keyframes);
+      for (std::size_t i = 1; i < numSegments; ++i) {
+        Vector3 offset = -(between(keyframes[i], keyframes[i + 1]) +
+                           between(keyframes[i], keyframes[i - 1])) /
+                         4;
+        control[i] =
+            SO3::compose(keyframes[i], SO3::quaternionExponentialMap(offset));
+      }
+      for (std::size_t i = 0; i < numSegments; ++i) {
+        setQuaternion(mSegments[i].base, keyframes[i]);
+        setQuaternion(mSegments[i].control, control[i]);
+        setTangent(mSegments[i].tangents[0],
+                   between(keyframes[i], keyframes[i + 1]));
+        setTangent(mSegments[i].tangents[1],
+                   between(control[i], control[i + 1]));
+      }
+      break;
+    }
+    case Method::BSpline: {
+      // The keyframes are the control points, with the ends repeated so every
+      // segment has the four it needs
+      std::vector<Quaternion> control;
+      control.push_back(keyframes.front());
+      control.insert(control.end(), keyframes.begin(), keyframes.end());
+      control.push_back(keyframes.back());
+      for (std::size_t i = 0; i < numSegments; ++i) {
+        setQuaternion(mSegments[i].base, control[i]);
+        for (std::size_t j = 0; j < 3; ++j) {
+          setTangent(mSegments[i].tangents[j],
+                     between(control[i + j], control[i + j + 1]));
+        }
+      }
+      break;
+    }
+    }
+  }
+
+  // Times outside the keyframes are clamped to the first or last one
+  Quaternion evaluate(Scalar time) const {
+    Pack<Scalar, 1> q[4];
+    evaluateKernel(&time, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  void evaluate(const Scalar *times, const QuaternionArrays<Scalar> &result,
+                std::size_t count) const {
+    Kernels::parallelForEachPack(count, 5, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P q[4];
+      evaluateKernel(times + index, q);
+      Kernels::store(q, index, result.components);
+    });
+  }
+
+  Scalar startTime() const { return mSegments.front().start; }
+
+  Scalar endTime() const {
+    return mSegments.back().start + 1 / mSegments.back().inverseDuration;
+  }
+
+private:
+  // base is q_i for slerp and squad and the first control point for the
+  // B-spline, control is the squad control point s_i, and tangents holds the
+  // increments each method composes onto base
+  struct Segment {
+    Scalar start;
+    Scalar inverseDuration;
+    Scalar base[4];
+    Scalar control[4];
+    Scalar tangents[3][3];
+  };
+
+  Method mMethod;
+  std::vector<Segment> mSegments;
+
+  static void setQuaternion(Scalar (&destination)[4], const Quaternion &q) {
+    destination[0] = q.w();
+    destination[1] = q.x();
+    destination[2] = q.y();
+    destination[3] = q.z();
+  }
+
+  static void setTangent(Scalar (&destination)[3], const Vector3 &w) {
+    for (std::size_t k = 0; k < 3; ++k) {
+      destination[k] = w(k);
+    }
+  }
+
+  // log(from^-1 to)
+  static Vector3 between(const Quaternion &from, const Quaternion &to) {
+    return SO3::quaternionLogarithmicMap(
+        SO3::compose(SO3::inverse(from), to));
+  }
+
+  // Looks up the segment of every lane and gathers it into packs, the rest is
+  // the same arithmetic on every lane
+  template <class P>
+  void evaluateKernel(const Scalar *times, P (&q)[4]) const {
+    constexpr std::size_t width = P::width;
+    Scalar u[width];
+    Scalar base[4][width];
+    Scalar control[4][width];
+    Scalar tangents[9][width];
+    for (std::size_t lane = 0; lane < width; ++lane) {
+      Scalar time = times[lane];
+      auto next = std::upper_bound(
+          mSegments.begin(), mSegments.end(), time,
+          [](Scalar t, const Segment &segment) { return t < segment.start; });
+      const Segment &segment =
+          next == mSegments.begin() ? *next : *std::prev(next);
+      u[lane] = std::clamp((time - segment.start) * segment.inverseDuration,
+                           Scalar(0), Scalar(1));
+      for (std::size_t k = 0; k < 4; ++k) {
+        base[k][lane] = segment.base[k];
+        control[k][lane] = segment.control[k];
+      }
+      for (std::size_t k = 0; k < 9; ++k) {
+        tangents[k][lane] = segment.tangents[k / 3][k % 3];
+      }
+    }
+
+    P t = P::load(u);
+    P a[4];
+    for (std::size_t k = 0; k < 4; ++k) {
+      a[k] = P::load(base[k]);
+    }
+    switch (mMethod) {
+    case Method::Slerp:
+      composeExponential(a, t, tangents, q);
+      break;
+    case Method::Squad: {
+      P s[4];
+      for (std::size_t k = 0; k < 4; ++k) {
+        s[k] = P::load(control[k]);
+      }
+      P outer[4];
+      P inner[4];
+      composeExponential(a, t, tangents, outer);
+      composeExponential(s, t, tangents + 3, inner);
+
+      // slerp(outer, inner, 2 t (1 - t))
+      P conjugate[4] = {outer[0], -outer[1], -outer[2], -outer[3]};
+      P relative[4];
+      Kernels::composeKernel(conjugate, inner, relative);
+      P w[3];
+      Kernels::quaternionLogarithmicMapKernel(relative, w);
+      P h = P(2.0) * t * (P(1.0) - t);
+      for (std::size_t k = 0; k < 3; ++k) {
+        w[k] = h * w[k];
+      }
+      P step[4];
+      Kernels::quaternionExponentialMapKernel(w, step);
+      Kernels::composeKernel(outer, step, q);
+      break;
+    }
+    // The default is never taken, it lets the compiler see q is always set
+    case Method::BSpline:
+    default: {
+      // Cumulative basis of the uniform cubic B-spline
+      P t2 = t * t;
+      P t3 = t2 * t;
+      P weights[3] = {
+          (P(5.0) + P(3.0) * t - P(3.0) * t2 + t3) * P(1.0 / 6.0),
+          (P(1.0) + P(3.0) * t + P(3.0) * t2 - P(2.0) * t3) * P(1.0 / 6.0),
+          t3 * P(1.0 / 6.0)};
+      for (std::size_t j = 0; j < 3; ++j) {
+        P next[4];
+        composeExponential(a, weights[j], tangents + 3 * j, next);
+        for (std::size_t k = 0; k < 4; ++k) {
+          a[k] = next[k];
+        }
+      }
+      for (std::size_t k = 0; k < 4; ++k) {
+        q[k] = a[k];
+      }
+      break;
+    }
+    }
+  }
+
+  // q = a exp(weight w), with the three rows of w holding one lane each
+  template <class P>
+  static void composeExponential(const P (&a)[4], P weight,
+                                 const Scalar (*w)[P::width], P (&q)[4]) {
+    P scaled[3];
+    for (std::size_t k = 0; k < 3; ++k) {
+      scaled[k] = weight * P::load(w[k]);
+    }
+    P step[4];
+    Kernels::quaternionExponentialMapKernel(scaled, step);
+    Kernels::composeKernel(a, step, q);
+  }
+};
+
+using RotationInterpolator = BasicRotationInterpolator<double>;
+using RotationInterpolatorf = BasicRotationInterpolator<float>;
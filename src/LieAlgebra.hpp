@@ -1,45 +1,463 @@
 #pragma once
+#include "LieAlgebraKernels.hpp"
 #include "utils.hpp"
 #include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <math.h>
+#include <type_traits>
 
-class LieAlgebra {
+// Use LieAlgebra for double precision and LieAlgebraf for single precision,
+// which halves the memory traffic of the batch functions and doubles the number
+// of lanes per register
+template <class Scalar> class BasicLieAlgebra {
 private:
-  static constexpr double tolerance = 0.000000000001;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
 
-  // This is to prevent floating point errors
-  static bool equals(double val1, double val2) {
-    return abs(val1 - val2) < tolerance;
+  using Kernels = LieAlgebraKernels<Scalar>;
+
+public:
+  // Structure of arrays view over a batch of SO3 matrices, entries[3 * row +
+  // col] points at the contiguous values of that entry for every matrix. Inputs
+  // use a const Scalar, outputs a mutable one.
+  template <class T> struct SO3Arrays {
+    std::array<T *, 9> entries;
+  };
+
+  // The same layout for 3x3 matrices that are not rotations, like the Jacobians
+  template <class T> using Matrix3Arrays = SO3Arrays<T>;
+
+  // Structure of arrays view over a batch of so3 tangent vectors
+  template <class T> struct TangentArrays {
+    std::array<T *, 3> components;
+  };
+
+  // Structure of arrays view over a batch of unit quaternions, components are
+  // ordered w, x, y, z
+  template <class T> struct QuaternionArrays {
+    std::array<T *, 4> components;
+  };
+
+  // Through the same kernel as the batch, which stays accurate next to
+  // theta = 0 and theta = pi where acos of the trace does not
+  static Vector3 logarithmicMap(const Matrix3 &SO3) {
+    Pack<Scalar, 1> R[9];
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = SO3.coeff(k / 3, k % 3);
+    }
+    Pack<Scalar, 1> w[3];
+    Kernels::logarithmicMapKernel(R, w);
+    return Vector3(w[0].v, w[1].v, w[2].v);
   }
 
-  static double trace(const Eigen::Matrix3d &mat) {
-    return mat.coeff(0, 0) + mat.coeff(1, 1) + mat.coeff(2, 2);
+  // Batched logarithmic map over count matrices. Every lane takes the same
+  // instructions, so the theta = 0 and theta = pi cases are blended in rather
+  // than branched on. A lower accuracy trades the error bound of Accuracy for
+  // throughput.
+  template <Accuracy accuracy = Accuracy::Exact>
+  static void logarithmicMap(const SO3Arrays<const Scalar> &SO3,
+                             const TangentArrays<Scalar> &so3,
+                             std::size_t count) {
+    Kernels::parallelForEachPack(count, 12, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P R[9];
+      P w[3];
+      Kernels::load(SO3.entries, index, R);
+      Kernels::template logarithmicMapKernel<accuracy>(R, w);
+      Kernels::store(w, index, so3.components);
+    });
   }
 
-public:
-  static Eigen::Vector3d logarithmicMap(Eigen::Matrix3d SO3) {
-    // Compute the magnitude of the mapped vector
-    // This is a unique solution between the [0,pi]
-    double theta = acos((trace(SO3) - 1) / 2);
-
-    // This if statement prevents unguarded division for when sin(theta) = 0
-    if (equals(theta, 0)) {
-      // if theta = 0 we just produce the identity element
-      return Eigen::Vector3d(0, 0, 0);
-    } else if (equals(sin(theta), 0)) {
-      // By looking at the off diagonal entries of the orthogonal matrix we can
-      // determine what the signs of the entries should be
-      double wx = getSign(SO3.coeff(1, 2)) * M_PI *
-                  sqrt((1.0 / 2.0) * (SO3.coeff(0, 0) + 1));
-      double wy = -1 * getSign(SO3.coeff(0, 2)) * M_PI *
-                  sqrt((1.0 / 2.0) * (SO3.coeff(1, 1) + 1));
-      double wz = -1 * getSign(SO3.coeff(1, 0)) * M_PI *
-                  sqrt((1.0 / 2.0) * (SO3.coeff(2, 2) + 1));
-      return Eigen::Vector3d(wx, wy, wz);
-    } else {
-      // Do the proper logarithmic operation
-      Eigen::Matrix3d wx = (theta / (2 * sin(theta))) * (SO3 - SO3.transpose());
-      return Eigen::Vector3d(wx.coeff(2, 1), wx.coeff(0, 2), wx.coeff(1, 0));
+  // Rodrigues' formula, the inverse of logarithmicMap for |so3| <= pi
+  static Matrix3 exponentialMap(const Vector3 &so3) {
+    Pack<Scalar, 1> w[3] = {so3.x(), so3.y(), so3.z()};
+    Pack<Scalar, 1> R[9];
+    Kernels::exponentialMapKernel(w, R);
+
+    Matrix3 SO3;
+    SO3 << R[0].v, R[1].v, R[2].v, R[3].v, R[4].v, R[5].v, R[6].v, R[7].v,
+        R[8].v;
+    return SO3;
+  }
+
+  static void exponentialMap(const TangentArrays<const Scalar> &so3,
+                             const SO3Arrays<Scalar> &SO3, std::size_t count) {
+    Kernels::parallelForEachPack(count, 12, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P w[3];
+      P R[9];
+      Kernels::load(so3.components, index, w);
+      Kernels::exponentialMapKernel(w, R);
+      Kernels::store(R, index, SO3.entries);
+    });
+  }
+
+  // Lie add, SO3 (+) so3 = exp(so3) * SO3. This undoes the Lie subtract used by
+  // the visualizer: rhs (+) log(lhs * rhs^T) = lhs.
+  static Matrix3 plus(const Matrix3 &SO3, const Vector3 &so3) {
+    return exponentialMap(so3) * SO3;
+  }
+
+  static void plus(const SO3Arrays<const Scalar> &SO3,
+                   const TangentArrays<const Scalar> &so3,
+                   const SO3Arrays<Scalar> &result, std::size_t count) {
+    Kernels::parallelForEachPack(count, 21, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P w[3];
+      P exp[9];
+      P X[9];
+      P R[9];
+      Kernels::load(so3.components, index, w);
+      Kernels::load(SO3.entries, index, X);
+      Kernels::exponentialMapKernel(w, exp);
+      Kernels::multiplyKernel(exp, X, R);
+      Kernels::store(R, index, result.entries);
+    });
+  }
+
+  // Logarithmic map of a unit quaternion straight to the rotation vector. The
+  // half angle comes from atan2(|v|, w), which unlike acos(w) keeps full
+  // precision near the identity.
+  static Vector3 quaternionLogarithmicMap(const Quaternion &q) {
+    Pack<Scalar, 1> quaternion[4] = {q.w(), q.x(), q.y(), q.z()};
+    Pack<Scalar, 1> w[3];
+    Kernels::quaternionLogarithmicMapKernel(quaternion, w);
+    return Vector3(w[0].v, w[1].v, w[2].v);
+  }
+
+  template <Accuracy accuracy = Accuracy::Exact>
+  static void quaternionLogarithmicMap(const QuaternionArrays<const Scalar> &q,
+                                       const TangentArrays<Scalar> &so3,
+                                       std::size_t count) {
+    Kernels::parallelForEachPack(count, 7, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P quaternion[4];
+      P w[3];
+      Kernels::load(q.components, index, quaternion);
+      Kernels::template quaternionLogarithmicMapKernel<accuracy>(quaternion, w);
+      Kernels::store(w, index, so3.components);
+    });
+  }
+
+  static Quaternion quaternionExponentialMap(const Vector3 &so3) {
+    Pack<Scalar, 1> w[3] = {so3.x(), so3.y(), so3.z()};
+    Pack<Scalar, 1> q[4];
+    Kernels::quaternionExponentialMapKernel(w, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  static void quaternionExponentialMap(const TangentArrays<const Scalar> &so3,
+                                       const QuaternionArrays<Scalar> &q,
+                                       std::size_t count) {
+    Kernels::parallelForEachPack(count, 7, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P w[3];
+      P quaternion[4];
+      Kernels::load(so3.components, index, w);
+      Kernels::quaternionExponentialMapKernel(w, quaternion);
+      Kernels::store(quaternion, index, q.components);
+    });
+  }
+
+  // Hamilton product lhs * rhs, the quaternion equivalent of multiplying the
+  // rotation matrices
+  static Quaternion compose(const Quaternion &lhs, const Quaternion &rhs) {
+    Pack<Scalar, 1> a[4] = {lhs.w(), lhs.x(), lhs.y(), lhs.z()};
+    Pack<Scalar, 1> b[4] = {rhs.w(), rhs.x(), rhs.y(), rhs.z()};
+    Pack<Scalar, 1> q[4];
+    Kernels::composeKernel(a, b, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  static void compose(const QuaternionArrays<const Scalar> &lhs,
+                      const QuaternionArrays<const Scalar> &rhs,
+                      const QuaternionArrays<Scalar> &result,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 12, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[4];
+      P b[4];
+      P q[4];
+      Kernels::load(lhs.components, index, a);
+      Kernels::load(rhs.components, index, b);
+      Kernels::composeKernel(a, b, q);
+      Kernels::store(q, index, result.components);
+    });
+  }
+
+  // The conjugate, which is the inverse for unit quaternions
+  static Quaternion inverse(const Quaternion &q) {
+    return Quaternion(q.w(), -q.x(), -q.y(), -q.z());
+  }
+
+  static void inverse(const QuaternionArrays<const Scalar> &q,
+                      const QuaternionArrays<Scalar> &result,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 8, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P quaternion[4];
+      Kernels::load(q.components, index, quaternion);
+      for (std::size_t k = 1; k < 4; ++k) {
+        quaternion[k] = -quaternion[k];
+      }
+      Kernels::store(quaternion, index, result.components);
+    });
+  }
+
+  // Rotation matrix of a quaternion using only products, so the single
+  // precision path used for rendering never widens to double
+  static Matrix3 quaternionToMatrix(Scalar w, Scalar x, Scalar y, Scalar z) {
+    Scalar q[4] = {w, x, y, z};
+    Scalar R[9];
+    Kernels::quaternionToMatrixKernel(q, R);
+
+    Matrix3 SO3;
+    SO3 << R[0], R[1], R[2], R[3], R[4], R[5], R[6], R[7], R[8];
+    return SO3;
+  }
+
+  static void quaternionToMatrix(const QuaternionArrays<const Scalar> &q,
+                                 const SO3Arrays<Scalar> &SO3,
+                                 std::size_t count) {
+    Kernels::parallelForEachPack(count, 13, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P quaternion[4];
+      P R[9];
+      Kernels::load(q.components, index, quaternion);
+      Kernels::quaternionToMatrixKernel(quaternion, R);
+      Kernels::store(R, index, SO3.entries);
+    });
+  }
+
+  // Unit quaternion of a rotation matrix with w >= 0, the inverse of
+  // quaternionToMatrix
+  static Quaternion matrixToQuaternion(const Matrix3 &SO3) {
+    Pack<Scalar, 1> R[9];
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = SO3.coeff(k / 3, k % 3);
+    }
+    Pack<Scalar, 1> q[4];
+    Kernels::matrixToQuaternionKernel(R, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  static void matrixToQuaternion(const SO3Arrays<const Scalar> &SO3,
+                                 const QuaternionArrays<Scalar> &q,
+                                 std::size_t count) {
+    Kernels::parallelForEachPack(count, 13, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P R[9];
+      P quaternion[4];
+      Kernels::load(SO3.entries, index, R);
+      Kernels::matrixToQuaternionKernel(R, quaternion);
+      Kernels::store(quaternion, index, q.components);
+    });
+  }
+
+  // Closest rotation to matrix in the Frobenius norm. For the singular value
+  // decomposition U S V^T that is U V^T, the orthogonal factor of the polar
+  // decomposition, or U diag(1, 1, -1) V^T when the determinant is negative,
+  // which turns back only the direction that is stretched least. Use it on
+  // matrices that were typed in, logged or have drifted through many products.
+  // A singular matrix gives the identity. When the two smallest singular
+  // values of a reflection tie, every direction between them is as close.
+  static Matrix3 orthonormalize(const Matrix3 &matrix) {
+    Pack<Scalar, 1> M[9];
+    for (std::size_t k = 0; k < 9; ++k) {
+      M[k] = matrix.coeff(k / 3, k % 3);
+    }
+    Pack<Scalar, 1> R[9];
+    Kernels::orthonormalizeKernel(M, R);
+
+    Matrix3 SO3;
+    SO3 << R[0].v, R[1].v, R[2].v, R[3].v, R[4].v, R[5].v, R[6].v, R[7].v,
+        R[8].v;
+    return SO3;
+  }
+
+  static void orthonormalize(const Matrix3Arrays<const Scalar> &matrices,
+                             const SO3Arrays<Scalar> &SO3, std::size_t count) {
+    Kernels::parallelForEachPack(count, 18, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P M[9];
+      P R[9];
+      Kernels::load(matrices.entries, index, M);
+      Kernels::orthonormalizeKernel(M, R);
+      Kernels::store(R, index, SO3.entries);
+    });
+  }
+
+  // The single rotation functions on plain arrays, with quaternions ordered w,
+  // x, y, z and matrices row major. Unlike the Eigen forms these are
+  // constexpr, so fixed rotations can be tabulated at compile time.
+  using QuaternionValues = std::array<Scalar, 4>;
+  using MatrixValues = std::array<Scalar, 9>;
+  using TangentValues = std::array<Scalar, 3>;
+
+  static constexpr TangentValues logarithmicMap(const MatrixValues &SO3) {
+    return applyKernel<3>(SO3, [](const auto &R, auto &w) {
+      Kernels::logarithmicMapKernel(R, w);
+    });
+  }
+
+  static constexpr MatrixValues exponentialMap(const TangentValues &so3) {
+    return applyKernel<9>(so3, [](const auto &w, auto &R) {
+      Kernels::exponentialMapKernel(w, R);
+    });
+  }
+
+  static constexpr TangentValues
+  quaternionLogarithmicMap(const QuaternionValues &q) {
+    return applyKernel<3>(q, [](const auto &quaternion, auto &w) {
+      Kernels::quaternionLogarithmicMapKernel(quaternion, w);
+    });
+  }
+
+  static constexpr QuaternionValues
+  quaternionExponentialMap(const TangentValues &so3) {
+    return applyKernel<4>(so3, [](const auto &w, auto &q) {
+      Kernels::quaternionExponentialMapKernel(w, q);
+    });
+  }
+
+  static constexpr QuaternionValues compose(const QuaternionValues &lhs,
+                                            const QuaternionValues &rhs) {
+    Pack<Scalar, 1> b[4] = {rhs[0], rhs[1], rhs[2], rhs[3]};
+    return applyKernel<4>(lhs, [&b](const auto &a, auto &q) {
+      Kernels::composeKernel(a, b, q);
+    });
+  }
+
+  static constexpr QuaternionValues inverse(const QuaternionValues &q) {
+    return {q[0], -q[1], -q[2], -q[3]};
+  }
+
+  static constexpr MatrixValues quaternionToMatrix(const QuaternionValues &q) {
+    return applyKernel<9>(q, [](const auto &quaternion, auto &R) {
+      Kernels::quaternionToMatrixKernel(quaternion, R);
+    });
+  }
+
+  static constexpr QuaternionValues
+  matrixToQuaternion(const MatrixValues &SO3) {
+    return applyKernel<4>(SO3, [](const auto &R, auto &q) {
+      Kernels::matrixToQuaternionKernel(R, q);
+    });
+  }
+
+  // SO3 Jacobians, with Jl(w) the derivative of exp(w) in the left (global)
+  // frame and Jr(w) = Jl(-w) in the right (body) frame:
+  // exp(w + dw) = exp(Jl(w) dw) exp(w) = exp(w) exp(Jr(w) dw)
+  static Matrix3 leftJacobian(const Vector3 &so3) {
+    return tangentToMatrix(so3, [](const auto &w, auto &J) {
+      Kernels::leftJacobianKernel(w, J);
+    });
+  }
+
+  static Matrix3 rightJacobian(const Vector3 &so3) {
+    return tangentToMatrix(so3, [](const auto &w, auto &J) {
+      Kernels::rightJacobianKernel(w, J);
+    });
+  }
+
+  // Valid for |so3| < 2 pi
+  static Matrix3 leftJacobianInverse(const Vector3 &so3) {
+    return tangentToMatrix(so3, [](const auto &w, auto &J) {
+      Kernels::leftJacobianInverseKernel(w, J);
+    });
+  }
+
+  static Matrix3 rightJacobianInverse(const Vector3 &so3) {
+    return tangentToMatrix(so3, [](const auto &w, auto &J) {
+      Kernels::rightJacobianInverseKernel(w, J);
+    });
+  }
+
+  static void leftJacobian(const TangentArrays<const Scalar> &so3,
+                           const Matrix3Arrays<Scalar> &jacobian,
+                           std::size_t count) {
+    tangentToMatrix(so3, jacobian, count, [](const auto &w, auto &J) {
+      Kernels::leftJacobianKernel(w, J);
+    });
+  }
+
+  static void rightJacobian(const TangentArrays<const Scalar> &so3,
+                            const Matrix3Arrays<Scalar> &jacobian,
+                            std::size_t count) {
+    tangentToMatrix(so3, jacobian, count, [](const auto &w, auto &J) {
+      Kernels::rightJacobianKernel(w, J);
+    });
+  }
+
+  static void leftJacobianInverse(const TangentArrays<const Scalar> &so3,
+                                  const Matrix3Arrays<Scalar> &jacobian,
+                                  std::size_t count) {
+    tangentToMatrix(so3, jacobian, count, [](const auto &w, auto &J) {
+      Kernels::leftJacobianInverseKernel(w, J);
+    });
+  }
+
+  static void rightJacobianInverse(const TangentArrays<const Scalar> &so3,
+                                   const Matrix3Arrays<Scalar> &jacobian,
+                                   std::size_t count) {
+    tangentToMatrix(so3, jacobian, count, [](const auto &w, auto &J) {
+      Kernels::rightJacobianInverseKernel(w, J);
+    });
+  }
+
+private:
+  // Runs kernel on a single rotation held in a plain array, for the constexpr
+  // functions
+  template <std::size_t M, std::size_t N, class Kernel>
+  static constexpr std::array<Scalar, M>
+  applyKernel(const std::array<Scalar, N> &values, Kernel &&kernel) {
+    Pack<Scalar, 1> input[N];
+    for (std::size_t k = 0; k < N; ++k) {
+      input[k] = values[k];
+    }
+    Pack<Scalar, 1> output[M];
+    kernel(input, output);
+
+    std::array<Scalar, M> result;
+    for (std::size_t k = 0; k < M; ++k) {
+      result[k] = output[k].v;
     }
+    return result;
   }
+
+  // Shared by the functions that map a tangent vector to a 3x3 matrix. The
+  // kernel is a generic lambda so the same one serves every Pack width.
+  template <class Kernel>
+  static Matrix3 tangentToMatrix(const Vector3 &so3, Kernel &&kernel) {
+    Pack<Scalar, 1> w[3] = {so3.x(), so3.y(), so3.z()};
+    Pack<Scalar, 1> M[9];
+    kernel(w, M);
+
+    Matrix3 matrix;
+    matrix << M[0].v, M[1].v, M[2].v, M[3].v, M[4].v, M[5].v, M[6].v, M[7].v,
+        M[8].v;
+    return matrix;
+  }
+
+  template <class Kernel>
+  static void tangentToMatrix(const TangentArrays<const Scalar> &so3,
+                              const Matrix3Arrays<Scalar> &matrices,
+                              std::size_t count, Kernel &&kernel) {
+    Kernels::parallelForEachPack(count, 12, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P w[3];
+      P M[9];
+      Kernels::load(so3.components, index, w);
+      kernel(w, M);
+      Kernels::store(M, index, matrices.entries);
+    });
+  }
+
 };
+
+using LieAlgebra = BasicLieAlgebra<double>;
+using LieAlgebraf = BasicLieAlgebra<float>;
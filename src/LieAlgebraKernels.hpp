@@ -0,0 +1,553 @@
+#pragma once
+#include "Parallel.hpp"
+#include "Simd.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+// Tolerances matched to the precision of each scalar type
+template <class Scalar> struct LieAlgebraTolerances;
+
+template <> struct LieAlgebraTolerances<double> {
+  static constexpr double tolerance = 0.000000000001;
+  static constexpr double smallAngle = 0.0001;
+  static constexpr double polarTolerance = 1e-16;
+  static constexpr int maxPolarIterations = 32;
+};
+
+// The Taylor series below are still exact to float rounding at 0.01, while
+// 1e-12 would be lost entirely next to 1
+template <> struct LieAlgebraTolerances<float> {
+  static constexpr float tolerance = 0.000001f;
+  static constexpr float smallAngle = 0.01f;
+  static constexpr float polarTolerance = 1e-7f;
+  static constexpr int maxPolarIterations = 32;
+};
+
+// The kernels behind BasicLieAlgebra and the helpers that run them over
+// structure of arrays batches. Each kernel works on one rotation per lane of
+// whatever Pack it is given. SE3, interpolation, averaging and the other
+// modules build their own batch functions out of these, so they are public
+// here rather than private to BasicLieAlgebra.
+template <class Scalar> struct LieAlgebraKernels {
+  static constexpr Scalar tolerance = LieAlgebraTolerances<Scalar>::tolerance;
+
+  // Below this angle the ratios of theta and its trig functions are replaced
+  // by their Taylor series
+  static constexpr Scalar smallAngle = LieAlgebraTolerances<Scalar>::smallAngle;
+
+  // The polar decomposition takes scaled Newton steps until the squared
+  // Frobenius norm of a step is below polarTolerance, as the next would be off
+  // by about its square and so only move rounding. Two or three steps do for
+  // matrices near a rotation and about ten for ones near singular, the cap only
+  // stops matrices that hold nan.
+  static constexpr Scalar polarTolerance =
+      LieAlgebraTolerances<Scalar>::polarTolerance;
+  static constexpr int maxPolarIterations =
+      LieAlgebraTolerances<Scalar>::maxPolarIterations;
+
+  // Runs kernel on whole registers and then on the remainder a lane at a time.
+  // The kernel is handed a std::type_identity of the Pack it should use.
+  template <class Kernel>
+  static void forEachPack(std::size_t count, Kernel &&kernel) {
+    using P = NativePack<Scalar>;
+    std::size_t packed = count - count % P::width;
+    for (std::size_t i = 0; i < packed; i += P::width) {
+      kernel(std::type_identity<P>{}, i);
+    }
+    for (std::size_t i = packed; i < count; ++i) {
+      kernel(std::type_identity<Pack<Scalar, 1>>{}, i);
+    }
+  }
+
+  // forEachPack split into chunks sized to the L2 cache and spread across the
+  // hardware threads, for the element wise batch functions. scalarsPerElement
+  // counts what the kernel reads and writes for one element. The chunks start
+  // at multiples of the register width, so every element goes through the
+  // same lanes as in forEachPack and the results are bit identical to it.
+  template <class Kernel>
+  static void parallelForEachPack(std::size_t count,
+                                  std::size_t scalarsPerElement,
+                                  Kernel &&kernel) {
+    std::size_t chunkSize = ParallelDispatch::chunkSize(
+        scalarsPerElement * sizeof(Scalar), NativePack<Scalar>::width);
+    if (count <= chunkSize) {
+      forEachPack(count, kernel);
+      return;
+    }
+    std::size_t numChunks = (count + chunkSize - 1) / chunkSize;
+    ParallelDispatch::forEachChunk(numChunks, [&](std::size_t chunk) {
+      std::size_t begin = chunk * chunkSize;
+      std::size_t end = std::min(count, begin + chunkSize);
+      forEachPack(end - begin, [&](auto tag, std::size_t offset) {
+        kernel(tag, begin + offset);
+      });
+    });
+  }
+
+  template <class P, class T, std::size_t N>
+  static void load(const std::array<T *, N> &arrays, std::size_t index,
+                   P (&packs)[N]) {
+    for (std::size_t k = 0; k < N; ++k) {
+      packs[k] = P::load(arrays[k] + index);
+    }
+  }
+
+  template <class P, std::size_t N>
+  static void store(const P (&packs)[N], std::size_t index,
+                    const std::array<Scalar *, N> &arrays) {
+    for (std::size_t k = 0; k < N; ++k) {
+      packs[k].store(arrays[k] + index);
+    }
+  }
+
+  // Logarithmic map of the row major matrix R into w, one rotation per lane
+  template <Accuracy accuracy = Accuracy::Exact, class P>
+  static constexpr void logarithmicMapKernel(const P (&R)[9], P (&w)[3]) {
+    // The skew part of R is sin(theta) * axis and the trace gives cos(theta),
+    // atan2 recovers theta from both without the precision loss of acos
+    P cosTheta = (R[0] + R[4] + R[8] - P(1.0)) * P(0.5);
+    P a[3] = {(R[7] - R[5]) * P(0.5), (R[2] - R[6]) * P(0.5),
+              (R[3] - R[1]) * P(0.5)};
+    P sinTheta = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    P theta = SimdMath::atan2<accuracy>(sinTheta, cosTheta);
+
+    // theta / sin(theta), which is 0 / 0 at the identity
+    P theta2 = theta * theta;
+    P series = P(1.0) + theta2 * (P(1.0 / 6.0) + theta2 * P(7.0 / 360.0));
+    P scale = select(theta < P(smallAngle), series,
+                     theta / max(sinTheta, P(tolerance)));
+
+    // Near pi the skew part vanishes, so the axis comes from the symmetric
+    // part instead: R = cos(theta) I + (1 - cos(theta)) axis axis^T + skew.
+    // Dividing once and multiplying after keeps the divider out of the way.
+    P inverseOneMinusCos = P(1.0) / max(P(1.0) - cosTheta, P(tolerance));
+    P d[3];
+    for (std::size_t k = 0; k < 3; ++k) {
+      d[k] = max((R[4 * k] - cosTheta) * inverseOneMinusCos, P(0.0));
+    }
+
+    // The largest diagonal term gives a well conditioned pivot for the rest
+    typename P::Mask pivot0 = (d[0] >= d[1]) & (d[0] >= d[2]);
+    typename P::Mask pivot1 = (!pivot0) & (d[1] >= d[2]);
+    P pivot = sqrt(max(d[0], max(d[1], d[2])));
+    P inverseDenom = P(0.5) * inverseOneMinusCos / pivot;
+    P u01 = (R[1] + R[3]) * inverseDenom;
+    P u02 = (R[2] + R[6]) * inverseDenom;
+    P u12 = (R[5] + R[7]) * inverseDenom;
+    P u[3] = {select(pivot0, pivot, select(pivot1, u01, u02)),
+              select(pivot0, u01, select(pivot1, pivot, u12)),
+              select(pivot0, u02, select(pivot1, u12, pivot))};
+
+    // Orient the axis so it agrees with whatever skew part is left
+    P alignment = u[0] * a[0] + u[1] * a[1] + u[2] * a[2];
+    P orientedTheta = select(alignment < P(0.0), -theta, theta);
+
+    typename P::Mask nearPi = cosTheta < P(-0.5);
+    for (std::size_t k = 0; k < 3; ++k) {
+      w[k] = select(nearPi, orientedTheta * u[k], scale * a[k]);
+    }
+  }
+
+  // Rodrigues' formula R = I + A [w]x + B [w]x^2 into the row major R
+  template <class P>
+  static constexpr void exponentialMapKernel(const P (&w)[3], P (&R)[9]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    P theta = sqrt(theta2);
+    P sinTheta;
+    P cosTheta;
+    SimdMath::sincos(theta, sinTheta, cosTheta);
+
+    // A = sin(theta) / theta and B = (1 - cos(theta)) / theta^2 are both 0 / 0
+    // at the identity, so their series take over for small angles
+    typename P::Mask small = theta < P(smallAngle);
+    P safeTheta = max(theta, P(smallAngle));
+    P A = select(small, P(1.0) - theta2 * P(1.0 / 6.0), sinTheta / safeTheta);
+
+    // 1 - cos(theta) cancels for small angles, which costs float most of its
+    // digits just above smallAngle, so there it is sin^2 / (1 + cos) instead
+    P oneMinusCos = select(cosTheta > P(0.0),
+                           sinTheta * sinTheta / (P(1.0) + cosTheta),
+                           P(1.0) - cosTheta);
+    P B = select(small, P(0.5) - theta2 * P(1.0 / 24.0),
+                 oneMinusCos / (safeTheta * safeTheta));
+    skewPolynomialKernel(w, theta2, A, B, R);
+  }
+
+  // Row major M = I + A [w]x + B [w]x^2, the shape shared by Rodrigues'
+  // formula and the Jacobians
+  template <class P>
+  static constexpr void skewPolynomialKernel(const P (&w)[3], P theta2, P A,
+                                             P B, P (&M)[9]) {
+    // [w]x^2 = w w^T - theta^2 I
+    P Bxy = B * w[0] * w[1];
+    P Bxz = B * w[0] * w[2];
+    P Byz = B * w[1] * w[2];
+    P Ax = A * w[0];
+    P Ay = A * w[1];
+    P Az = A * w[2];
+
+    M[0] = P(1.0) + B * (w[0] * w[0] - theta2);
+    M[1] = Bxy - Az;
+    M[2] = Bxz + Ay;
+    M[3] = Bxy + Az;
+    M[4] = P(1.0) + B * (w[1] * w[1] - theta2);
+    M[5] = Byz - Ax;
+    M[6] = Bxz - Ay;
+    M[7] = Byz + Ax;
+    M[8] = P(1.0) + B * (w[2] * w[2] - theta2);
+  }
+
+  template <class P, std::size_t N>
+  static constexpr P polynomial(const double (&coefficients)[N], P x) {
+    P result = P(coefficients[0]);
+    for (std::size_t i = 1; i < N; ++i) {
+      result = fma(result, x, P(coefficients[i]));
+    }
+    return result;
+  }
+
+  // Taylor series in theta^2, highest order first, of
+  // B = (1 - cos(theta)) / theta^2,
+  // C = (theta - sin(theta)) / theta^3,
+  // D = 1 / theta^2 - sin(theta) / (2 theta (1 - cos(theta))).
+  // C and D cancel badly well above smallAngle, so the series are long enough
+  // to cover everything below jacobianSeries.
+  static constexpr double JACOBIAN_B[] = {
+      -4.779477332387385e-14, 1.1470745597729725e-11, -2.08767569878681e-09,
+      2.755731922398589e-07,  -2.48015873015873e-05,  1.388888888888889e-03,
+      -4.1666666666666664e-02, 0.5};
+  static constexpr double JACOBIAN_C[] = {
+      -2.8114572543455206e-15, 7.647163731819816e-13, -1.6059043836821613e-10,
+      2.505210838544172e-08,   -2.7557319223985893e-06, 1.984126984126984e-04,
+      -8.333333333333333e-03,  1.6666666666666666e-01};
+  static constexpr double JACOBIAN_D[] = {
+      3.3896802963225827e-13, 1.3382536530684679e-11, 5.284190138687493e-10,
+      2.08767569878681e-08,   8.267195767195768e-07,  3.306878306878307e-05,
+      1.388888888888889e-03,  8.333333333333333e-02};
+  static constexpr double jacobianSeries = 0.5;
+
+  // Coefficients of the left Jacobian I + B [w]x + C [w]x^2
+  template <class P>
+  static constexpr void jacobianCoefficients(P theta2, P &B, P &C) {
+    P theta = sqrt(theta2);
+    P sinTheta;
+    P cosTheta;
+    SimdMath::sincos(theta, sinTheta, cosTheta);
+
+    typename P::Mask series = theta < P(jacobianSeries);
+    P safeTheta = max(theta, P(jacobianSeries));
+    P safeTheta2 = safeTheta * safeTheta;
+    B = select(series, polynomial(JACOBIAN_B, theta2),
+               (P(1.0) - cosTheta) / safeTheta2);
+    C = select(series, polynomial(JACOBIAN_C, theta2),
+               (safeTheta - sinTheta) / (safeTheta2 * safeTheta));
+  }
+
+  // Coefficient of the inverse left Jacobian I - 1/2 [w]x + D [w]x^2, which is
+  // singular at theta = 2 pi
+  template <class P>
+  static constexpr P inverseJacobianCoefficient(P theta2) {
+    P theta = sqrt(theta2);
+    P sinTheta;
+    P cosTheta;
+    SimdMath::sincos(theta, sinTheta, cosTheta);
+
+    typename P::Mask series = theta < P(jacobianSeries);
+    P safeTheta = max(theta, P(jacobianSeries));
+    return select(series, polynomial(JACOBIAN_D, theta2),
+                  P(1.0) / (safeTheta * safeTheta) -
+                      sinTheta / (P(2.0) * safeTheta * (P(1.0) - cosTheta)));
+  }
+
+  // The right Jacobian of w is the left Jacobian of -w, which only flips the
+  // sign of the odd [w]x term
+  template <class P>
+  static constexpr void leftJacobianKernel(const P (&w)[3], P (&J)[9]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    P B;
+    P C;
+    jacobianCoefficients(theta2, B, C);
+    skewPolynomialKernel(w, theta2, B, C, J);
+  }
+
+  template <class P>
+  static constexpr void rightJacobianKernel(const P (&w)[3], P (&J)[9]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    P B;
+    P C;
+    jacobianCoefficients(theta2, B, C);
+    skewPolynomialKernel(w, theta2, -B, C, J);
+  }
+
+  template <class P>
+  static constexpr void leftJacobianInverseKernel(const P (&w)[3], P (&J)[9]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    skewPolynomialKernel(w, theta2, P(-0.5), inverseJacobianCoefficient(theta2),
+                         J);
+  }
+
+  template <class P>
+  static constexpr void rightJacobianInverseKernel(const P (&w)[3], P (&J)[9]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    skewPolynomialKernel(w, theta2, P(0.5), inverseJacobianCoefficient(theta2),
+                         J);
+  }
+
+  // Rotation vector of the quaternion q = (w, x, y, z). q and -q are the same
+  // rotation, so the sign of w picks the representative with theta <= pi.
+  template <Accuracy accuracy = Accuracy::Exact, class P>
+  static constexpr void quaternionLogarithmicMapKernel(const P (&q)[4],
+                                                       P (&w)[3]) {
+    P norm2 = q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+    P norm = sqrt(norm2);
+    P absW = abs(q[0]);
+    P halfTheta = SimdMath::atan2<accuracy>(norm, absW);
+
+    // 2 * atan(|v| / w) / |v| is 0 / 0 at the identity
+    P series = P(2.0) / absW * (P(1.0) - norm2 / (P(3.0) * absW * absW));
+    P scale = select(norm < P(smallAngle), series,
+                     P(2.0) * halfTheta / max(norm, P(tolerance)));
+    scale = select(q[0] < P(0.0), -scale, scale);
+    for (std::size_t k = 0; k < 3; ++k) {
+      w[k] = scale * q[k + 1];
+    }
+  }
+
+  // q = (cos(theta / 2), sin(theta / 2) * axis)
+  template <class P>
+  static constexpr void quaternionExponentialMapKernel(const P (&w)[3],
+                                                       P (&q)[4]) {
+    P theta2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+    P theta = sqrt(theta2);
+    P sinHalf;
+    P cosHalf;
+    SimdMath::sincos(P(0.5) * theta, sinHalf, cosHalf);
+
+    // sin(theta / 2) / theta is 0 / 0 at the identity
+    P scale = select(theta < P(smallAngle), P(0.5) - theta2 * P(1.0 / 48.0),
+                     sinHalf / max(theta, P(smallAngle)));
+    q[0] = cosHalf;
+    for (std::size_t k = 0; k < 3; ++k) {
+      q[k + 1] = scale * w[k];
+    }
+  }
+
+  template <class P>
+  static constexpr void composeKernel(const P (&a)[4], const P (&b)[4],
+                                      P (&q)[4]) {
+    q[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+    q[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+    q[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+    q[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+  }
+
+  // Same expansion the renderer has always used, with the diagonal written as
+  // 2 (w^2 + x^2) - 1
+  template <class P>
+  static constexpr void quaternionToMatrixKernel(const P (&q)[4], P (&R)[9]) {
+    P two = P(2.0);
+    P ww = q[0] * q[0];
+    P xx = q[1] * q[1];
+    P yy = q[2] * q[2];
+    P zz = q[3] * q[3];
+    P wx = q[0] * q[1];
+    P wy = q[0] * q[2];
+    P wz = q[0] * q[3];
+    P xy = q[1] * q[2];
+    P xz = q[1] * q[3];
+    P yz = q[2] * q[3];
+
+    R[0] = two * (ww + xx) - P(1.0);
+    R[1] = two * (xy - wz);
+    R[2] = two * (xz + wy);
+    R[3] = two * (xy + wz);
+    R[4] = two * (ww + yy) - P(1.0);
+    R[5] = two * (yz - wx);
+    R[6] = two * (xz - wy);
+    R[7] = two * (yz + wx);
+    R[8] = two * (ww + zz) - P(1.0);
+  }
+
+  // Shepperd's method: of 4 w^2, 4 x^2, 4 y^2 and 4 z^2, read off the trace
+  // and diagonal, the largest is the best conditioned. Its square root gives
+  // that component and the off diagonal sums and differences give the others
+  // as multiples of it. The result is flipped onto w >= 0.
+  template <class P>
+  static constexpr void matrixToQuaternionKernel(const P (&R)[9], P (&q)[4]) {
+    P t[4] = {P(1.0) + R[0] + R[4] + R[8], P(1.0) + R[0] - R[4] - R[8],
+              P(1.0) - R[0] + R[4] - R[8], P(1.0) - R[0] - R[4] + R[8]};
+    P skewX = R[7] - R[5];
+    P skewY = R[2] - R[6];
+    P skewZ = R[3] - R[1];
+    P xy = R[1] + R[3];
+    P xz = R[2] + R[6];
+    P yz = R[5] + R[7];
+
+    // Row i is 4 q_i times the quaternion
+    P rows[4][4] = {{t[0], skewX, skewY, skewZ},
+                    {skewX, t[1], xy, xz},
+                    {skewY, xy, t[2], yz},
+                    {skewZ, xz, yz, t[3]}};
+    typename P::Mask pivot0 = (t[0] >= t[1]) & (t[0] >= t[2]) & (t[0] >= t[3]);
+    typename P::Mask pivot1 = (!pivot0) & (t[1] >= t[2]) & (t[1] >= t[3]);
+    typename P::Mask pivot2 = (!pivot0) & (!pivot1) & (t[2] >= t[3]);
+    P largest = max(max(t[0], t[1]), max(t[2], t[3]));
+    P selected[4];
+    for (std::size_t k = 0; k < 4; ++k) {
+      selected[k] = select(pivot0, rows[0][k],
+                           select(pivot1, rows[1][k],
+                                  select(pivot2, rows[2][k], rows[3][k])));
+    }
+    P scale = P(0.5) / sqrt(largest);
+    scale = select(selected[0] < P(0.0), -scale, scale);
+    for (std::size_t k = 0; k < 4; ++k) {
+      q[k] = scale * selected[k];
+    }
+  }
+
+  // Newton's iteration X <- (X + X^-T) / 2 for the polar factor, with Higham's
+  // Frobenius norm scaling so that badly scaled inputs converge as quickly as
+  // nearly orthogonal ones. X^-T is the cofactor matrix over the determinant,
+  // and the rows of the cofactor matrix are cross products of the rows of X.
+  template <class P>
+  static constexpr void orthonormalizeKernel(const P (&M)[9], P (&R)[9]) {
+    P X[9];
+    P C[9];
+    P det = determinant(M, C);
+    for (std::size_t k = 0; k < 9; ++k) {
+      X[k] = M[k];
+    }
+    typename P::Mask singular = abs(det) < P(tolerance);
+
+    // Every step keeps the sign of the determinant, X ends on U V^T
+    for (int iteration = 0; iteration < maxPolarIterations; ++iteration) {
+      P detX = determinant(X, C);
+      P normX2 = P(0.0);
+      P normC2 = P(0.0);
+      for (std::size_t k = 0; k < 9; ++k) {
+        normX2 = fma(X[k], X[k], normX2);
+        normC2 = fma(C[k], C[k], normC2);
+      }
+
+      // gamma = sqrt(|X^-1| / |X|) balances the two terms of the average
+      P gamma = sqrt(sqrt(normC2 / normX2) / abs(detX));
+      P half = P(0.5) * gamma;
+      P halfInverse = P(0.5) / (gamma * detX);
+      P step2 = P(0.0);
+      for (std::size_t k = 0; k < 9; ++k) {
+        P next = half * X[k] + halfInverse * C[k];
+        step2 = fma(next - X[k], next - X[k], step2);
+        X[k] = next;
+      }
+      // nan never compares greater, so singular lanes do not hold this up
+      if (!any(step2 > P(polarTolerance))) {
+        break;
+      }
+    }
+
+    typename P::Mask reflected = det < P(0.0);
+    if (any(reflected)) {
+      flipSmallestDirection(M, reflected, X);
+    }
+
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = select(singular, P(k % 4 == 0 ? 1.0 : 0.0), X[k]);
+    }
+  }
+
+  // X = U V^T becomes U diag(1, 1, -1) V^T = X (I - 2 v v^T) in the reflected
+  // lanes, with v the singular vector of M whose singular value is smallest.
+  // The adjugate of H = X^T M = V S V^T has the products of pairs of singular
+  // values as its eigenvalues, so v is its dominant eigenvector. Squaring it
+  // over and over squares the ratio of the two largest eigenvalues each time
+  // and leaves a multiple of v v^T, or of the projection onto every v that
+  // ties.
+  template <class P>
+  static constexpr void flipSmallestDirection(const P (&M)[9],
+                                              typename P::Mask reflected,
+                                              P (&X)[9]) {
+    P H[9];
+    for (std::size_t row = 0; row < 3; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        P sum = P(0.0);
+        for (std::size_t k = 0; k < 3; ++k) {
+          sum = fma(X[3 * k + row], M[3 * k + col], sum);
+          sum = fma(X[3 * k + col], M[3 * k + row], sum);
+        }
+        H[3 * row + col] = P(0.5) * sum;
+      }
+    }
+    P A[9];
+    determinant(H, A);
+
+    for (int iteration = 0; iteration < maxPolarIterations; ++iteration) {
+      P square[9];
+      multiplyKernel(A, A, square);
+      // The trace of the square of a symmetric matrix is its squared norm
+      P inverseNorm2 = P(1.0) / (square[0] + square[4] + square[8]);
+      P step2 = P(0.0);
+      for (std::size_t k = 0; k < 9; ++k) {
+        P next = square[k] * inverseNorm2;
+        step2 = fma(next - A[k], next - A[k], step2);
+        A[k] = next;
+      }
+      if (!any(reflected & (step2 > P(polarTolerance)))) {
+        break;
+      }
+    }
+
+    // The longest column of v v^T is a multiple of v. Ties go to the last
+    // column, so diag(1, 1, -1) turns back into the identity.
+    P v[3] = {A[0], A[3], A[6]};
+    P length2 = A[0] * A[0] + A[3] * A[3] + A[6] * A[6];
+    for (std::size_t col = 1; col < 3; ++col) {
+      P columnLength2 = A[col] * A[col] + A[3 + col] * A[3 + col] +
+                        A[6 + col] * A[6 + col];
+      typename P::Mask isLonger = columnLength2 >= length2;
+      for (std::size_t row = 0; row < 3; ++row) {
+        v[row] = select(isLonger, A[3 * row + col], v[row]);
+      }
+      length2 = max(length2, columnLength2);
+    }
+
+    P scale = P(2.0) / length2;
+    P Xv[3];
+    for (std::size_t row = 0; row < 3; ++row) {
+      Xv[row] = scale * (X[3 * row] * v[0] + X[3 * row + 1] * v[1] +
+                         X[3 * row + 2] * v[2]);
+    }
+    for (std::size_t row = 0; row < 3; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        X[3 * row + col] = select(
+            reflected, X[3 * row + col] - Xv[row] * v[col], X[3 * row + col]);
+      }
+    }
+  }
+
+  // Determinant of the row major M, leaving its cofactor matrix in C
+  template <class P>
+  static constexpr P determinant(const P (&M)[9], P (&C)[9]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      std::size_t a = 3 * ((row + 1) % 3);
+      std::size_t b = 3 * ((row + 2) % 3);
+      C[3 * row] = M[a + 1] * M[b + 2] - M[a + 2] * M[b + 1];
+      C[3 * row + 1] = M[a + 2] * M[b] - M[a] * M[b + 2];
+      C[3 * row + 2] = M[a] * M[b + 1] - M[a + 1] * M[b];
+    }
+    return M[0] * C[0] + M[1] * C[1] + M[2] * C[2];
+  }
+
+  // Row major C = A * B
+  template <class P>
+  static constexpr void multiplyKernel(const P (&A)[9], const P (&B)[9],
+                                       P (&C)[9]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        C[3 * row + col] = A[3 * row] * B[col] + A[3 * row + 1] * B[3 + col] +
+                           A[3 * row + 2] * B[6 + col];
+      }
+    }
+  }
+};
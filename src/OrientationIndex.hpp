@@ -0,0 +1,295 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Nearest neighbour and radius queries by geodesic angle over a fixed set of
+// unit quaternions. The quaternions are flipped onto w >= 0 and split into a
+// balanced kd-tree in R^4, where the angle between two rotations grows with
+// the chordal distance |q -+ p|, so the tree prunes by the chord of the query
+// angle. The queries check both q and -q, so rotations near the w = 0 boundary
+// are found from either side.
+template <class Scalar> class BasicOrientationIndex {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+  // Rotations per leaf, scanned a register at a time
+  static constexpr std::size_t LEAF_SIZE = 64;
+
+  // Subtrees smaller than this are built on the thread that reached them
+  static constexpr std::size_t PARALLEL_SIZE = 1 << 16;
+
+  // Splitting coordinate and value of an inner node. The tree is implicit:
+  // node i has children 2 i + 1 and 2 i + 2, and the range of a node is halved
+  // between them, so the leaves need no storage of their own.
+  struct Node {
+    Scalar split;
+    int dimension;
+  };
+
+public:
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  struct Neighbor {
+    // Position of the rotation in the arrays the index was built from
+    std::size_t index;
+    // Angle of the rotation between the query and the neighbour, in [0, pi]
+    Scalar angle;
+  };
+
+  // Copies the rotations, so the arrays do not have to outlive the index
+  BasicOrientationIndex(const QuaternionArrays<const Scalar> &q,
+                        std::size_t count)
+      : mCount(count) {
+    while ((count >> mDepth) > LEAF_SIZE) {
+      ++mDepth;
+    }
+    mNodes.resize((std::size_t(1) << mDepth) - 1);
+
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      order[i] = i;
+    }
+    std::size_t numThreads =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    build(q, order, 0, 0, count, numThreads);
+
+    // Store the points in tree order and on one hemisphere, so every leaf is
+    // contiguous in each component
+    for (std::vector<Scalar> &component : mComponents) {
+      component.resize(count);
+    }
+    mIndices = std::move(order);
+    for (std::size_t i = 0; i < count; ++i) {
+      Scalar sign = q.components[0][mIndices[i]] < 0 ? -1 : 1;
+      for (std::size_t k = 0; k < 4; ++k) {
+        mComponents[k][i] = sign * q.components[k][mIndices[i]];
+      }
+    }
+  }
+
+  std::size_t size() const { return mCount; }
+
+  // Every rotation within angle of q, nearest first
+  std::vector<Neighbor> withinAngle(const Quaternion &q, Scalar angle) const {
+    // |q . p| >= cos(angle / 2) is |q -+ p|^2 <= 2 - 2 cos(angle / 2)
+    Scalar minimumDot = std::cos(std::min(angle, Scalar(M_PI)) / 2);
+    Scalar radius2 = 2 - 2 * minimumDot;
+    std::array<Scalar, 4> query = {q.w(), q.x(), q.y(), q.z()};
+
+    std::vector<Neighbor> hits;
+    search(query, [&]() { return radius2; },
+           [&](std::size_t i, Scalar dot) {
+             if (dot >= minimumDot) {
+               hits.push_back({i, dot});
+             }
+           });
+    return finish(query, std::move(hits));
+  }
+
+  // The k rotations nearest to q, nearest first
+  std::vector<Neighbor> nearest(const Quaternion &q, std::size_t k) const {
+    std::array<Scalar, 4> query = {q.w(), q.x(), q.y(), q.z()};
+
+    // Until finish the angle of a neighbour holds |q . p|. Ordered so the
+    // worst of the k best is on top.
+    auto isCloser = [](const Neighbor &a, const Neighbor &b) {
+      return a.angle > b.angle;
+    };
+    std::priority_queue<Neighbor, std::vector<Neighbor>, decltype(isCloser)>
+        best(isCloser);
+    if (k > 0) {
+      search(query,
+             [&]() {
+               return best.size() < k ? Scalar(4) : 2 - 2 * best.top().angle;
+             },
+             [&](std::size_t i, Scalar dot) {
+               if (best.size() < k) {
+                 best.push({i, dot});
+               } else if (dot > best.top().angle) {
+                 best.pop();
+                 best.push({i, dot});
+               }
+             });
+    }
+
+    std::vector<Neighbor> hits;
+    while (!best.empty()) {
+      hits.push_back(best.top());
+      best.pop();
+    }
+    return finish(query, std::move(hits));
+  }
+
+private:
+  std::size_t mCount;
+  int mDepth = 0;
+  std::vector<Node> mNodes;
+  std::array<std::vector<Scalar>, 4> mComponents;
+  std::vector<std::size_t> mIndices;
+
+  // Canonical coordinate k of rotation i of the input
+  static Scalar coordinate(const QuaternionArrays<const Scalar> &q,
+                           std::size_t i, int k) {
+    Scalar value = q.components[k][i];
+    return q.components[0][i] < 0 ? -value : value;
+  }
+
+  // Splits order[begin, end) at its median along the widest coordinate and
+  // recurses, handing one half to a new thread while threads are left
+  void build(const QuaternionArrays<const Scalar> &q,
+             std::vector<std::size_t> &order, std::size_t node,
+             std::size_t begin, std::size_t end, std::size_t numThreads) {
+    if (node >= mNodes.size()) {
+      return;
+    }
+
+    Scalar lower[4];
+    Scalar upper[4];
+    for (int k = 0; k < 4; ++k) {
+      lower[k] = upper[k] = coordinate(q, order[begin], k);
+    }
+    for (std::size_t i = begin + 1; i < end; ++i) {
+      for (int k = 0; k < 4; ++k) {
+        Scalar value = coordinate(q, order[i], k);
+        lower[k] = std::min(lower[k], value);
+        upper[k] = std::max(upper[k], value);
+      }
+    }
+    int dimension = 0;
+    for (int k = 1; k < 4; ++k) {
+      if (upper[k] - lower[k] > upper[dimension] - lower[dimension]) {
+        dimension = k;
+      }
+    }
+
+    std::size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle,
+                     order.begin() + end,
+                     [&](std::size_t a, std::size_t b) {
+                       return coordinate(q, a, dimension) <
+                              coordinate(q, b, dimension);
+                     });
+    mNodes[node] = {coordinate(q, order[middle], dimension), dimension};
+
+    if (numThreads > 1 && end - begin > PARALLEL_SIZE) {
+      std::thread left(&BasicOrientationIndex::build, this, std::cref(q),
+                       std::ref(order), 2 * node + 1, begin, middle,
+                       numThreads / 2);
+      build(q, order, 2 * node + 2, middle, end, numThreads - numThreads / 2);
+      left.join();
+    } else {
+      build(q, order, 2 * node + 1, begin, middle, 1);
+      build(q, order, 2 * node + 2, middle, end, 1);
+    }
+  }
+
+  // Depth first search that visits a child only if q or -q can be within the
+  // current radius of it. visit gets the tree position and |q . p| of every
+  // rotation in the leaves that are reached.
+  template <class Radius, class Visit>
+  void search(const std::array<Scalar, 4> &query, Radius &&radius2,
+              Visit &&visit) const {
+    searchNode(query, 0, 0, mCount, radius2, visit);
+  }
+
+  template <class Radius, class Visit>
+  void searchNode(const std::array<Scalar, 4> &query, std::size_t node,
+                  std::size_t begin, std::size_t end, Radius &radius2,
+                  Visit &visit) const {
+    if (node >= mNodes.size()) {
+      scanLeaf(query, begin, end, visit);
+      return;
+    }
+
+    const Node &split = mNodes[node];
+    std::size_t middle = begin + (end - begin) / 2;
+    Scalar offset = query[split.dimension] - split.split;
+
+    // The side of q first, -q sits on the other side of every split of a
+    // coordinate other than w
+    bool isLeftFirst = offset <= 0;
+    for (int side = 0; side < 2; ++side) {
+      bool isLeft = (side == 0) == isLeftFirst;
+
+      // Distance from q and from -q to the half space of the child
+      Scalar gapQ = isLeft ? std::max(offset, Scalar(0))
+                           : std::max(-offset, Scalar(0));
+      Scalar negatedOffset = -query[split.dimension] - split.split;
+      Scalar gapNegated = isLeft ? std::max(negatedOffset, Scalar(0))
+                                 : std::max(-negatedOffset, Scalar(0));
+      Scalar gap = std::min(gapQ, gapNegated);
+      if (gap * gap > radius2()) {
+        continue;
+      }
+      if (isLeft) {
+        searchNode(query, 2 * node + 1, begin, middle, radius2, visit);
+      } else {
+        searchNode(query, 2 * node + 2, middle, end, radius2, visit);
+      }
+    }
+  }
+
+  // |q . p| for a whole register of the leaf at once
+  template <class Visit>
+  void scanLeaf(const std::array<Scalar, 4> &query, std::size_t begin,
+                std::size_t end, Visit &visit) const {
+    Scalar dots[LEAF_SIZE + NativePack<Scalar>::width];
+    Kernels::forEachPack(end - begin, [&](auto tag, std::size_t offset) {
+      using P = typename decltype(tag)::type;
+      P dot = P(0.0);
+      for (std::size_t k = 0; k < 4; ++k) {
+        dot = dot +
+              P(query[k]) * P::load(mComponents[k].data() + begin + offset);
+      }
+      abs(dot).store(dots + offset);
+    });
+    for (std::size_t i = begin; i < end; ++i) {
+      visit(i, dots[i - begin]);
+    }
+  }
+
+  // Turns the tree positions and |q . p| of the hits into input indices and
+  // angles, nearest first. The angle comes from the chord and the sum, which
+  // unlike acos of the dot product keeps its digits for close rotations.
+  std::vector<Neighbor> finish(const std::array<Scalar, 4> &query,
+                               std::vector<Neighbor> hits) const {
+    for (Neighbor &hit : hits) {
+      std::size_t i = hit.index;
+      Scalar dot = 0;
+      for (std::size_t k = 0; k < 4; ++k) {
+        dot += query[k] * mComponents[k][i];
+      }
+      Scalar sign = dot < 0 ? -1 : 1;
+      Scalar chord2 = 0;
+      Scalar sum2 = 0;
+      for (std::size_t k = 0; k < 4; ++k) {
+        Scalar p = sign * mComponents[k][i];
+        chord2 += (query[k] - p) * (query[k] - p);
+        sum2 += (query[k] + p) * (query[k] + p);
+      }
+      hit.index = mIndices[i];
+      hit.angle = 4 * std::atan2(std::sqrt(chord2), std::sqrt(sum2));
+    }
+    std::sort(hits.begin(), hits.end(),
+              [](const Neighbor &a, const Neighbor &b) {
+                return a.angle < b.angle ||
+                       (a.angle == b.angle && a.index < b.index);
+              });
+    return hits;
+  }
+};
+
+using OrientationIndex = BasicOrientationIndex<double>;
+using OrientationIndexf = BasicOrientationIndex<float>;
@@ -0,0 +1,293 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// libstdc++ runs the parallel algorithms on TBB, which then has to be linked,
+// so they are only used when the build asks for them
+#ifdef PARALLEL_STL
+#include <compare>
+#include <execution>
+#include <iterator>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+// Runs the chunks of a batch across every hardware thread, through
+// std::for_each with std::execution::par when PARALLEL_STL is defined and
+// through a pool of threads that lives as long as the program otherwise. The
+// chunks are handed out whole, so as long as they do not share any state the
+// result is the same as running them one after another. Dispatching through
+// the pool allocates nothing, its threads are started on first use.
+class ParallelDispatch {
+public:
+  // Calls body(chunk) for every chunk in [0, numChunks), on the calling thread
+  // as well, and returns once all of them are done. Calls from inside a chunk
+  // are fine, the caller works through its own chunks instead of waiting. When
+  // a chunk throws, the chunks not yet started are skipped and the first
+  // exception is rethrown once the others are done.
+  template <class Body>
+  static void forEachChunk(std::size_t numChunks, Body &&body) {
+    if (numChunks <= 1 || numThreads() == 1) {
+      for (std::size_t chunk = 0; chunk < numChunks; ++chunk) {
+        body(chunk);
+      }
+      return;
+    }
+
+#ifdef PARALLEL_STL
+    // Not par_unseq, as the chunks may lock or dispatch again. An exception
+    // leaving the algorithm calls std::terminate, so it is kept until the end.
+    std::atomic<bool> isFailed = false;
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::for_each(std::execution::par, ChunkIterator{0},
+                  ChunkIterator{numChunks}, [&](std::size_t chunk) {
+                    if (isFailed) {
+                      return;
+                    }
+                    try {
+                      body(chunk);
+                    } catch (...) {
+                      std::lock_guard<std::mutex> lock(mutex);
+                      if (!exception) {
+                        exception = std::current_exception();
+                      }
+                      isFailed = true;
+                    }
+                  });
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+#else
+    auto task = [&](std::size_t chunk) { body(chunk); };
+    ThreadPool::instance().run(
+        numChunks,
+        [](void *context, std::size_t chunk) {
+          (*static_cast<decltype(task) *>(context))(chunk);
+        },
+        &task);
+#endif
+  }
+
+  // Elements per chunk so that what a chunk reads and writes fills half of the
+  // L2 cache, leaving the rest to the kernel and the next chunk's prefetches.
+  // Always a multiple of alignment, such as the width of a register.
+  static std::size_t chunkSize(std::size_t bytesPerElement,
+                               std::size_t alignment) {
+    std::size_t elements =
+        l2CacheSize() / 2 / std::max<std::size_t>(bytesPerElement, 1);
+    return std::max(alignment, elements - elements % alignment);
+  }
+
+  static std::size_t numThreads() {
+    static const std::size_t count =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    return count;
+  }
+
+private:
+#ifdef PARALLEL_STL
+  // Counts through the chunk indices, so the algorithm is handed a range
+  // without one being allocated
+  struct ChunkIterator {
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::size_t *;
+    using reference = std::size_t;
+
+    std::size_t chunk = 0;
+
+    std::size_t operator*() const { return chunk; }
+    std::size_t operator[](difference_type n) const { return chunk + n; }
+    ChunkIterator &operator++() { return ++chunk, *this; }
+    ChunkIterator &operator--() { return --chunk, *this; }
+    ChunkIterator operator++(int) { return {chunk++}; }
+    ChunkIterator operator--(int) { return {chunk--}; }
+    ChunkIterator &operator+=(difference_type n) { return chunk += n, *this; }
+    ChunkIterator &operator-=(difference_type n) { return chunk -= n, *this; }
+    friend ChunkIterator operator+(ChunkIterator it, difference_type n) {
+      return it += n;
+    }
+    friend ChunkIterator operator+(difference_type n, ChunkIterator it) {
+      return it += n;
+    }
+    friend ChunkIterator operator-(ChunkIterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(ChunkIterator a, ChunkIterator b) {
+      return static_cast<difference_type>(a.chunk - b.chunk);
+    }
+    friend auto operator<=>(ChunkIterator, ChunkIterator) = default;
+  };
+#endif
+
+  static std::size_t l2CacheSize() {
+    static const std::size_t size = [] {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+      long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      if (bytes > 0) {
+        return static_cast<std::size_t>(bytes);
+      }
+#endif
+      // Typical of a desktop core when the system does not say
+      return std::size_t(256) << 10;
+    }();
+    return size;
+  }
+
+  // One worker per hardware thread but the caller's. Each run is a job whose
+  // tasks are claimed one at a time from a shared counter by the caller and
+  // any idle worker. The job lives on the caller's stack and is queued in an
+  // intrusive list, the caller waits for every worker to let go of it before
+  // returning.
+  class ThreadPool {
+  public:
+    using Task = void (*)(void *context, std::size_t index);
+
+    static ThreadPool &instance() {
+      static ThreadPool pool;
+      return pool;
+    }
+
+    void run(std::size_t numTasks, Task task, void *context) {
+      Job job(task, context, numTasks);
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        *(mLast == nullptr ? &mFirst : &mLast->queued) = &job;
+        mLast = &job;
+      }
+      mWake.notify_all();
+
+      work(job);
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        dequeue(job);
+        mDone.wait(lock, [&] {
+          return job.numFinished == job.numTasks && job.numWorkers == 0;
+        });
+      }
+      if (job.exception) {
+        std::rethrow_exception(job.exception);
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsStopping = true;
+      }
+      mWake.notify_all();
+      for (std::thread &worker : mWorkers) {
+        worker.join();
+      }
+    }
+
+  private:
+    struct Job {
+      Job(Task task, void *context, std::size_t numTasks)
+          : task(task), context(context), numTasks(numTasks) {}
+
+      const Task task;
+      void *const context;
+      const std::size_t numTasks;
+      std::atomic<std::size_t> next = 0;
+      std::atomic<bool> isFailed = false;
+      // Guarded by the pool's mutex
+      std::size_t numFinished = 0;
+      std::size_t numWorkers = 0;
+      std::exception_ptr exception;
+      Job *queued = nullptr;
+    };
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    // Queue of the jobs that may have tasks left, guarded by mMutex
+    Job *mFirst = nullptr;
+    Job *mLast = nullptr;
+    std::vector<std::thread> mWorkers;
+    bool mIsStopping = false;
+
+    ThreadPool() {
+      for (std::size_t i = 1; i < numThreads(); ++i) {
+        mWorkers.emplace_back([this] { loop(); });
+      }
+    }
+
+    void loop() {
+      while (true) {
+        Job *job;
+        {
+          std::unique_lock<std::mutex> lock(mMutex);
+          mWake.wait(lock, [&] { return mIsStopping || mFirst != nullptr; });
+          if (mIsStopping) {
+            return;
+          }
+          job = mFirst;
+          ++job->numWorkers;
+        }
+        work(*job);
+
+        // The caller may return as soon as this lets go of the job
+        std::lock_guard<std::mutex> lock(mMutex);
+        dequeue(*job);
+        if (--job->numWorkers == 0 && job->numFinished == job->numTasks) {
+          mDone.notify_all();
+        }
+      }
+    }
+
+    // Runs tasks of job until there are none left to claim. Once one has
+    // thrown, the rest are claimed without being run.
+    void work(Job &job) {
+      while (true) {
+        std::size_t index = job.next.fetch_add(1);
+        if (index >= job.numTasks) {
+          return;
+        }
+        std::exception_ptr exception;
+        if (!job.isFailed) {
+          try {
+            job.task(job.context, index);
+          } catch (...) {
+            exception = std::current_exception();
+            job.isFailed = true;
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (exception && !job.exception) {
+          job.exception = exception;
+        }
+        if (++job.numFinished == job.numTasks) {
+          mDone.notify_all();
+        }
+      }
+    }
+
+    // Takes job off the queue, so no one else picks it up. Needs mMutex.
+    void dequeue(Job &job) {
+      Job *previous = nullptr;
+      for (Job *other = mFirst; other != nullptr; other = other->queued) {
+        if (other == &job) {
+          *(previous == nullptr ? &mFirst : &previous->queued) = job.queued;
+          if (mLast == &job) {
+            mLast = previous;
+          }
+          job.queued = nullptr;
+          return;
+        }
+        previous = other;
+      }
+    }
+  };
+};
@@ -43,10 +43,34 @@ void Rendering::updateGUI(RenderPassEncoder renderPass) {
     ImGui::Text("Which input would you like?");
     ImGui::Checkbox("Quaternion: ", &isQuaternion);
     ImGui::Checkbox("SO3: ", &isSO3);
+    ImGui::Checkbox("Euler Angles: ", &isEuler);
+    ImGui::Checkbox("Axis Angle: ", &isAxisAngle);
+    ImGui::Checkbox("SE3: ", &isSE3);
+    ImGui::Checkbox("Interpolation: ", &isInterpolation);
     ImGui::Checkbox("Lie Algebra: ", &isLieAlgebra);
+    ImGui::Checkbox("Sampling: ", &isSampling);
 
-    // Decision tree for each of the different display states
-    if (isQuaternion) {
+    // Decision tree for each of the different display states, the sampling
+    // glyphs are drawn instead of everything else
+    if (isSampling) {
+      // The glyphs are only regenerated when an input changes
+      bool isChanged = ImGui::RadioButton("Uniform", &samplingMethod, 0);
+      ImGui::SameLine();
+      isChanged |= ImGui::RadioButton("Hopf grid", &samplingMethod, 1);
+      if (samplingMethod == 0) {
+        ImGui::SetNextItemWidth(inputBoxSize);
+        isChanged |= ImGui::InputInt("Samples", &sampleCount, 0);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        isChanged |= ImGui::InputInt("Seed", &sampleSeed, 0);
+      } else {
+        isChanged |= ImGui::SliderInt("Level", &hopfLevel, 0, MAX_HOPF_LEVEL);
+      }
+      if (isChanged) {
+        updateSamples();
+      }
+      ImGui::Text("%d rotations, each drawn as its z axis", mGlyphCount);
+    } else if (isQuaternion) {
       ImGui::Text("Ex. 0, 0, 0, 1 is the identity quaternion");
       ImGui::SetNextItemWidth(inputBoxSize);
       ImGui::InputScalar("q0", IMGUI_DOUBLE_SCALAR,
@@ -60,6 +84,62 @@ void Rendering::updateGUI(RenderPassEncoder renderPass) {
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
       ImGui::InputScalar("q3", IMGUI_DOUBLE_SCALAR, &q0);
+      if (mIsQuaternionDegenerate) {
+        ImGui::Text("Degenerate quaternion, showing the last rotation");
+      }
+
+      // Integrated from gyro samples at the chosen rate, starting from the
+      // quaternion above
+      bool isChanged = ImGui::Checkbox("Gyro replay: ", &isReplaying);
+      if (isReplaying) {
+        isChanged |= ImGui::SliderInt("kHz", &mReplay.rate, 1, 8);
+        isChanged |= ImGui::RadioButton("Exp Euler", &mReplay.method, 0);
+        ImGui::SameLine();
+        isChanged |= ImGui::RadioButton("RK4", &mReplay.method, 1);
+        ImGui::SameLine();
+        isChanged |= ImGui::RadioButton("Magnus", &mReplay.method, 2);
+        ImGui::Text("%zu samples integrated this frame", mReplay.count);
+      }
+      if (isChanged && isReplaying) {
+        initReplay();
+      }
+
+      // Every filter runs over the log, the chosen one is shown above
+      ImGui::SetNextItemWidth(4 * inputBoxSize);
+      ImGui::InputText("IMU log", mFiltering.logPath,
+                       sizeof(mFiltering.logPath));
+      ImGui::SameLine();
+      if (ImGui::Button("Load")) {
+        loadImuLog();
+      }
+      if (!mFiltering.logError.empty()) {
+        ImGui::Text("%s", mFiltering.logError.c_str());
+      }
+      if (mFiltering.log) {
+        ImGui::Checkbox("Filter replay: ", &isFiltering);
+      }
+      if (isFiltering) {
+        ImGui::RadioButton("Madgwick", &mFiltering.shown, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("Mahony", &mFiltering.shown, 1);
+        ImGui::SameLine();
+        ImGui::RadioButton("ESKF", &mFiltering.shown, 2);
+        ImGui::Text("Sample %zu of %zu at %.0f Hz", mFiltering.sample,
+                    mFiltering.log->size(), 1 / mFiltering.log->dt());
+        Eigen::Quaterniond shown =
+            mFiltering.filters[mFiltering.shown].orientation();
+        ImGui::Text("From the shown one: Madgwick %.2f, Mahony %.2f, "
+                    "ESKF %.2f degrees",
+                    shown.angularDistance(mFiltering.filters[0].orientation()) *
+                        180 / M_PI,
+                    shown.angularDistance(mFiltering.filters[1].orientation()) *
+                        180 / M_PI,
+                    shown.angularDistance(mFiltering.filters[2].orientation()) *
+                        180 / M_PI);
+        Eigen::Vector3d bias = mFiltering.filters[2].bias();
+        ImGui::Text("ESKF gyro bias: %.4f, %.4f, %.4f rad/s", bias.x(),
+                    bias.y(), bias.z());
+      }
     } else if (isSO3) {
       ImGui::Text("SO3 Matrix:");
 
@@ -92,72 +172,320 @@ void Rendering::updateGUI(RenderPassEncoder renderPass) {
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
       ImGui::InputScalar("(2,2)", IMGUI_DOUBLE_SCALAR, &i22);
-    } else if (isLieAlgebra) {
-      ImGui::Checkbox("Subtract: ", &isSub);
+    } else if (isEuler) {
+      // Same order as RotationConversion::EulerOrder
+      static constexpr const char *EULER_ORDERS[] = {
+          "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX",
+          "XYX", "XZX", "YXY", "YZY", "ZXZ", "ZYZ"};
+      ImGui::Combo("Order", &eulerOrder, EULER_ORDERS,
+                   RotationConversion::NUM_EULER_ORDERS);
+      ImGui::Text("Intrinsic angles in degrees:");
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("e0", IMGUI_DOUBLE_SCALAR, &e0);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("e1", IMGUI_DOUBLE_SCALAR, &e1);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("e2", IMGUI_DOUBLE_SCALAR, &e2);
+
+      Eigen::Quaterniond q = LieAlgebra::matrixToQuaternion(eulerRotation());
+      ImGui::Text("Quaternion (%.3f, %.3f, %.3f, %.3f)", q.x(), q.y(), q.z(),
+                  q.w());
+    } else if (isAxisAngle) {
+      ImGui::Text("Axis:");
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("a0", IMGUI_DOUBLE_SCALAR, &a0);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("a1", IMGUI_DOUBLE_SCALAR, &a1);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("a2", IMGUI_DOUBLE_SCALAR, &a2);
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("Angle (degrees)", IMGUI_DOUBLE_SCALAR, &axisAngle);
+
+      // The same rotation in the Euler convention last picked
+      Eigen::Vector3d angles =
+          RotationConversion::matrixToEuler(
+              axisAngleRotation(),
+              static_cast<RotationConversion::EulerOrder>(eulerOrder)) *
+          (180.0 / M_PI);
+      ImGui::Text("Euler angles (%.3f, %.3f, %.3f)", angles.x(), angles.y(),
+                  angles.z());
+    } else if (isSE3) {
+      ImGui::Text("SE3 Rotation:");
 
-      // Left Hand Side SO3 Matrix
-      ImGui::Text("SO3 Matrix Left Hand Side:");
       // Row 1
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(0,0)", IMGUI_DOUBLE_SCALAR, &l100);
+      ImGui::InputScalar("(0,0)", IMGUI_DOUBLE_SCALAR, &i00);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(0,1)", IMGUI_DOUBLE_SCALAR, &l101);
+      ImGui::InputScalar("(0,1)", IMGUI_DOUBLE_SCALAR, &i01);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(0,2)", IMGUI_DOUBLE_SCALAR, &l102);
+      ImGui::InputScalar("(0,2)", IMGUI_DOUBLE_SCALAR, &i02);
 
       // Row 2
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(1,0)", IMGUI_DOUBLE_SCALAR, &l110);
+      ImGui::InputScalar("(1,0)", IMGUI_DOUBLE_SCALAR, &i10);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(1,1)", IMGUI_DOUBLE_SCALAR, &l111);
+      ImGui::InputScalar("(1,1)", IMGUI_DOUBLE_SCALAR, &i11);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(1,2)", IMGUI_DOUBLE_SCALAR, &l112);
+      ImGui::InputScalar("(1,2)", IMGUI_DOUBLE_SCALAR, &i12);
 
       // Row 2
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(2,0)", IMGUI_DOUBLE_SCALAR, &l120);
+      ImGui::InputScalar("(2,0)", IMGUI_DOUBLE_SCALAR, &i20);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(2,1)", IMGUI_DOUBLE_SCALAR, &l121);
+      ImGui::InputScalar("(2,1)", IMGUI_DOUBLE_SCALAR, &i21);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("l(2,2)", IMGUI_DOUBLE_SCALAR, &l122);
+      ImGui::InputScalar("(2,2)", IMGUI_DOUBLE_SCALAR, &i22);
+
+      // Translation
+      ImGui::Text("SE3 Translation:");
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("p0", IMGUI_DOUBLE_SCALAR, &p0);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("p1", IMGUI_DOUBLE_SCALAR, &p1);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(inputBoxSize);
+      ImGui::InputScalar("p2", IMGUI_DOUBLE_SCALAR, &p2);
+
+      // Twist that generates the pose
+      Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+      pose.topLeftCorner<3, 3>() = inputRotation();
+      pose.topRightCorner<3, 1>() << p0, p1, p2;
+      Eigen::Matrix<double, 6, 1> twist = SE3Algebra::logarithmicMap(pose);
+      ImGui::Text("se3: rho (%.3f, %.3f, %.3f) phi (%.3f, %.3f, %.3f)",
+                  twist(0), twist(1), twist(2), twist(3), twist(4), twist(5));
+    } else if (isInterpolation) {
+      // The table is rebuilt only when the method changes
+      bool isChanged = ImGui::RadioButton("Slerp", &mInterpolation.method, 0);
+      ImGui::SameLine();
+      isChanged |= ImGui::RadioButton("Squad", &mInterpolation.method, 1);
+      ImGui::SameLine();
+      isChanged |= ImGui::RadioButton("B-spline", &mInterpolation.method, 2);
+      if (isChanged) {
+        initInterpolation();
+      }
+
+      ImGui::Checkbox("Play: ", &mInterpolation.isPlaying);
+      if (ImGui::SliderFloat("Time", &mInterpolation.time,
+                             mInterpolation.interpolator->startTime(),
+                             mInterpolation.interpolator->endTime())) {
+        mInterpolation.isPlaying = false;
+      }
+
+      // Savitzky-Golay smoothing over this many samples either side
+      if (ImGui::SliderInt("Smoothing", &mVelocity.halfWindow, 0, 8)) {
+        initVelocity();
+      }
+      ImGui::Text("Angular velocity body (%.3f, %.3f, %.3f)",
+                  mVelocity.body.x(), mVelocity.body.y(), mVelocity.body.z());
+      ImGui::Text("Angular velocity world (%.3f, %.3f, %.3f)",
+                  mVelocity.world.x(), mVelocity.world.y(),
+                  mVelocity.world.z());
 
-      // RHS SO3 Matrix
-      ImGui::Text("SO3 Matrix Right Hand Side:");
+      ImGui::Text("Deviation from Slerp in degrees:");
+      ImGui::PlotLines("RMS", mInterpolation.deviation.data(),
+                       static_cast<int>(mInterpolation.deviation.size()), 0,
+                       nullptr, 0.0f, FLT_MAX, ImVec2(0, 80));
+      ImGui::Text("RMS %.3f median %.3f 95%% %.3f max %.3f",
+                  mInterpolation.summary.rmsGeodesic * 180.0f / M_PI,
+                  mInterpolation.median, mInterpolation.percentile,
+                  mInterpolation.summary.maxGeodesic * 180.0f / M_PI);
+    } else if (isLieAlgebra) {
+      // Only one operation is shown at a time
+      if (ImGui::Checkbox("Subtract: ", &isSub)) {
+        isSub = true;
+        isAdd = false;
+        isMean = false;
+        isPropagate = false;
+      }
+      ImGui::SameLine();
+      if (ImGui::Checkbox("Add: ", &isAdd)) {
+        isSub = false;
+        isAdd = true;
+        isMean = false;
+        isPropagate = false;
+      }
+      ImGui::SameLine();
+      if (ImGui::Checkbox("Mean: ", &isMean)) {
+        isSub = false;
+        isAdd = false;
+        isMean = true;
+        isPropagate = false;
+      }
+      ImGui::SameLine();
+      if (ImGui::Checkbox("Propagate: ", &isPropagate)) {
+        isSub = false;
+        isAdd = false;
+        isMean = false;
+        isPropagate = true;
+      }
+
+      // Left Hand Side SO3 Matrix
+      ImGui::Text(isMean ? "SO3 Matrix Center:" : "SO3 Matrix Left Hand Side:");
       // Row 1
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(0,0)", IMGUI_DOUBLE_SCALAR, &r100);
+      ImGui::InputScalar("l(0,0)", IMGUI_DOUBLE_SCALAR, &l100);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(0,1)", IMGUI_DOUBLE_SCALAR, &r101);
+      ImGui::InputScalar("l(0,1)", IMGUI_DOUBLE_SCALAR, &l101);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(0,2)", IMGUI_DOUBLE_SCALAR, &r102);
+      ImGui::InputScalar("l(0,2)", IMGUI_DOUBLE_SCALAR, &l102);
 
       // Row 2
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(1,0)", IMGUI_DOUBLE_SCALAR, &r110);
+      ImGui::InputScalar("l(1,0)", IMGUI_DOUBLE_SCALAR, &l110);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(1,1)", IMGUI_DOUBLE_SCALAR, &r111);
+      ImGui::InputScalar("l(1,1)", IMGUI_DOUBLE_SCALAR, &l111);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(1,2)", IMGUI_DOUBLE_SCALAR, &r112);
+      ImGui::InputScalar("l(1,2)", IMGUI_DOUBLE_SCALAR, &l112);
 
       // Row 2
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(2,0)", IMGUI_DOUBLE_SCALAR, &r120);
+      ImGui::InputScalar("l(2,0)", IMGUI_DOUBLE_SCALAR, &l120);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(2,1)", IMGUI_DOUBLE_SCALAR, &r121);
+      ImGui::InputScalar("l(2,1)", IMGUI_DOUBLE_SCALAR, &l121);
       ImGui::SameLine();
       ImGui::SetNextItemWidth(inputBoxSize);
-      ImGui::InputScalar("r(2,2) ", IMGUI_DOUBLE_SCALAR, &r122);
+      ImGui::InputScalar("l(2,2)", IMGUI_DOUBLE_SCALAR, &l122);
+
+      if (isAdd) {
+        // Tangent vector
+        ImGui::Text("so3 Vector Right Hand Side:");
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("t0", IMGUI_DOUBLE_SCALAR, &t0);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("t1", IMGUI_DOUBLE_SCALAR, &t1);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("t2", IMGUI_DOUBLE_SCALAR, &t2);
+      } else if (isMean) {
+        // Rotations are sampled as center * exp(noise)
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputInt("Samples", &mMean.sampleCount, 0);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("Spread", IMGUI_DOUBLE_SCALAR, &mMean.spread);
+
+        if (mMean.samples) {
+          const RotationAveraging::Statistics &statistics =
+              mMean.samples->statistics;
+          Eigen::Vector3d mean = LieAlgebra::logarithmicMap(statistics.mean);
+          Eigen::Vector3d sigma = statistics.covariance.diagonal().cwiseSqrt();
+          ImGui::Text("Karcher mean (%.3f, %.3f, %.3f) in %d iterations",
+                      mean.x(), mean.y(), mean.z(), statistics.iterations);
+          ImGui::Text("Standard deviation (%.3f, %.3f, %.3f)", sigma.x(),
+                      sigma.y(), sigma.z());
+        }
+        if (mMean.next.valid()) {
+          ImGui::Text("Sampling...");
+        }
+        if (!mMean.error.empty()) {
+          ImGui::Text("Sampling failed: %s", mMean.error.c_str());
+        }
+
+        // The samples near center * exp(query) are drawn as vectors
+        SearchState::Inputs &search = mSearch.inputs;
+        ImGui::Text("so3 Search Query:");
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("s0", IMGUI_DOUBLE_SCALAR, &search.query(0));
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("s1", IMGUI_DOUBLE_SCALAR, &search.query(1));
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("s2", IMGUI_DOUBLE_SCALAR, &search.query(2));
+        if (ImGui::RadioButton("Within", search.isRadius)) {
+          search.isRadius = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Nearest", !search.isRadius)) {
+          search.isRadius = false;
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        if (search.isRadius) {
+          ImGui::InputScalar("Degrees", IMGUI_DOUBLE_SCALAR, &search.degrees);
+        } else if (ImGui::InputInt("Neighbors", &search.neighbors, 0)) {
+          search.neighbors = std::max(search.neighbors, 0);
+        }
+        ImGui::Text("%zu hits drawn in %.3f ms", mSearch.hits.size(),
+                    mSearch.milliseconds);
+      } else {
+        // RHS SO3 Matrix
+        ImGui::Text("SO3 Matrix Right Hand Side:");
+        // Row 1
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(0,0)", IMGUI_DOUBLE_SCALAR, &r100);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(0,1)", IMGUI_DOUBLE_SCALAR, &r101);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(0,2)", IMGUI_DOUBLE_SCALAR, &r102);
+
+        // Row 2
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(1,0)", IMGUI_DOUBLE_SCALAR, &r110);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(1,1)", IMGUI_DOUBLE_SCALAR, &r111);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(1,2)", IMGUI_DOUBLE_SCALAR, &r112);
+
+        // Row 2
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(2,0)", IMGUI_DOUBLE_SCALAR, &r120);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(2,1)", IMGUI_DOUBLE_SCALAR, &r121);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(inputBoxSize);
+        ImGui::InputScalar("r(2,2) ", IMGUI_DOUBLE_SCALAR, &r122);
+
+        if (isPropagate) {
+          // Standard deviations in radians about each body axis
+          ImGui::Text("Left Hand Side Sigma:");
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("ls0", IMGUI_DOUBLE_SCALAR, &ls0);
+          ImGui::SameLine();
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("ls1", IMGUI_DOUBLE_SCALAR, &ls1);
+          ImGui::SameLine();
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("ls2", IMGUI_DOUBLE_SCALAR, &ls2);
+
+          ImGui::Text("Right Hand Side Sigma:");
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("rs0", IMGUI_DOUBLE_SCALAR, &rs0);
+          ImGui::SameLine();
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("rs1", IMGUI_DOUBLE_SCALAR, &rs1);
+          ImGui::SameLine();
+          ImGui::SetNextItemWidth(inputBoxSize);
+          ImGui::InputScalar("rs2", IMGUI_DOUBLE_SCALAR, &rs2);
+
+          Eigen::Vector3d sigma =
+              mPropagated.covariance.diagonal().cwiseMax(0.0).cwiseSqrt();
+          ImGui::Text("Composed sigma (%.3f, %.3f, %.3f)", sigma.x(),
+                      sigma.y(), sigma.z());
+        }
+      }
     }
 
     // Refresh rate
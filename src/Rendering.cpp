@@ -43,6 +43,18 @@ bool Rendering::init() {
 
   loadGeometry("vector.obj", 2);
 
+  // Principal axes of the spread about a mean
+  loadGeometry("vector.obj", 3);
+
+  loadGeometry("vector.obj", 4);
+
+  loadGeometry("vector.obj", 5);
+
+  // Samples found near a query orientation, or the uncertainty cone
+  loadGeometry("vector.obj", 6);
+
+  initInstanceBuffer();
+
   initUniformBuffer();
 
   adjustView(-0.25, 0.0, -2.0);
@@ -51,6 +63,12 @@ bool Rendering::init() {
 
   initGUI();
 
+  initInterpolation();
+
+  initVelocity();
+
+  updateSamples();
+
   mBeginFrame = std::chrono::system_clock::now();
   mEndFrame = mBeginFrame + inverseFPS;
 
@@ -112,7 +130,8 @@ void Rendering::updateFrame() {
 
   // State Machine For Rendering different meshes depending on which mode the
   // user has chosen
-  if (isQuaternion || isSO3) {
+  if (isQuaternion || isSO3 || isEuler || isAxisAngle || isSE3 ||
+      isInterpolation || isSampling) {
     adjustView(-0.25, 0.0, -2.0);
     // Update uniform buffer
     // Update view matrix
@@ -121,15 +140,23 @@ void Rendering::updateFrame() {
     mUniforms.modelMatrix = R1 * T1 * S;
     mQueue.writeBuffer(mUniformBuffer, offsetof(Uniform, modelMatrix),
                        &mUniforms.modelMatrix, sizeof(Uniform::modelMatrix));
+
+    if (isQuaternion && isReplaying) {
+      updateReplay();
+    }
+    if (isQuaternion && isFiltering) {
+      updateFiltering();
+    }
+
+    // The frame turns about the world angular velocity
+    if (isInterpolation) {
+      updateVelocity();
+      writeVector(2, VELOCITY_SCALE * mVelocity.world.cast<double>());
+    }
   } else if (isLieAlgebra) {
     adjustView(-1.0, 0.0, -7.0);
-    // Left hand side matrix
-    Eigen::Matrix3d lhsSO3;
-    lhsSO3 << l100, l101, l102, l110, l111, l112, l120, l121, l122;
-
-    // Right hand side matrix
-    Eigen::Matrix3d rhsSO3;
-    rhsSO3 << r100, r101, r102, r110, r111, r112, r120, r121, r122;
+    Eigen::Matrix3d lhsSO3 = leftRotation();
+    Eigen::Matrix3d rhsSO3 = rightRotation();
 
     // Depending on the desired operation
     Eigen::Vector3d desired = Eigen::Vector3d::Zero();
@@ -138,64 +165,57 @@ void Rendering::updateFrame() {
       // own inverse
       Eigen::Matrix3d composed = lhsSO3 * rhsSO3.transpose();
       desired = LieAlgebra::logarithmicMap(composed);
+    } else if (isAdd) {
+      // The vector shows what is being added, the coordinate frame shows the
+      // result (see writeRotation)
+      desired = Eigen::Vector3d(t0, t1, t2);
+    } else if (isMean) {
+      // The mean is drawn like any other result, with the principal axes of
+      // the spread next to it, once the first samples are in
+      updateMean(lhsSO3);
+      if (mMean.samples) {
+        updateSearch();
+        desired = LieAlgebra::logarithmicMap(mMean.samples->statistics.mean);
+        for (int k = 0; k < 3; ++k) {
+          writeVector(3 + k, mMean.samples->spreadAxes[k]);
+        }
+      }
+    } else if (isPropagate) {
+      // The composed rotation is drawn with a cone of glyphs around it
+      Eigen::Vector3d lhsSigma(ls0, ls1, ls2);
+      Eigen::Vector3d rhsSigma(rs0, rs1, rs2);
+      RotationUncertainty::Gaussian lhs = {
+          lhsSO3, lhsSigma.cwiseAbs2().asDiagonal()};
+      RotationUncertainty::Gaussian rhs = {
+          rhsSO3, rhsSigma.cwiseAbs2().asDiagonal()};
+      mPropagated = RotationUncertainty::compose(lhs, rhs);
+      updateCone();
+      desired = LieAlgebra::logarithmicMap(mPropagated.mean);
     }
 
-    Eigen::Vector3d v = Eigen::Vector3d::Zero();
-    v.x() = desired.x();
-    v.y() = -1 * desired.y();
-    v.z() = desired.z();
-
-    Eigen::HouseholderQR<Eigen::Matrix3d> qr;
-    Eigen::Matrix3d vectorMatrix;
-    vectorMatrix << v.x(), v.x(), v.x(), v.y(), v.y(), v.y() + 1, v.z(),
-        v.z() + 1, v.z(), qr.compute(vectorMatrix);
-
-    Eigen::Matrix3d reorderMatrix = Eigen::Matrix3d::Zero();
-    reorderMatrix(2, 1) = 1;
-    reorderMatrix(1, 0) = 1;
-    reorderMatrix(0, 2) = 1;
-
-    Eigen::Matrix3d rotation = qr.householderQ() * reorderMatrix;
-
-    // Make sure the signs of the vectors have not been changed by QR decomp
-    if (getSign(rotation.coeff(0, 2)) != getSign(v.coeff(0, 0)) ||
-        getSign(rotation.coeff(1, 2)) != getSign(v.coeff(1, 0)) ||
-        getSign(rotation.coeff(2, 2)) != getSign(v.coeff(2, 0))) {
-      rotation(0, 2) *= -1;
-      rotation(1, 2) *= -1;
-      rotation(2, 2) *= -1;
-      rotation(0, 1) *= -1;
-      rotation(1, 1) *= -1;
-      rotation(2, 1) *= -1;
-    }
-
-    mZScalar = v.norm();
-
-    rotationGLM = glm::transpose(
-        mat4x4(rotation.coeff(0, 0), rotation.coeff(0, 1), rotation.coeff(0, 2),
-               0, rotation.coeff(1, 0), rotation.coeff(1, 1),
-               rotation.coeff(1, 2), 0, rotation.coeff(2, 0),
-               rotation.coeff(2, 1), rotation.coeff(2, 2), 0, 0, 0, 0, 1));
-
-    mQueue.writeBuffer(mUniformBuffer,
-                       2 * mUniformStride + offsetof(Uniform, zScalar),
-                       &mZScalar, sizeof(Uniform::zScalar));
-
-    mQueue.writeBuffer(mUniformBuffer,
-                       2 * mUniformStride + offsetof(Uniform, rotation),
-                       &rotationGLM, sizeof(Uniform::rotation));
+    writeVector(2, desired);
   }
 
   // Determine which objects to render based on which mode we are in
   std::vector<size_t> toRender;
-  if (isQuaternion || isSO3) {
+  if (isSampling) {
+    toRender = {2};
+  } else if (isInterpolation) {
+    toRender = {0, 1, 2};
+  } else if (isQuaternion || isSO3 || isEuler || isAxisAngle || isSE3) {
     toRender = {0, 1};
+  } else if (isLieAlgebra && isMean && mMean.samples) {
+    toRender = {1, 2, 3, 4, 5, 6};
+  } else if (isLieAlgebra && isPropagate) {
+    toRender = {1, 2, 6};
   } else if (isLieAlgebra) {
     toRender = {1, 2};
   }
 
   // Set binding group
   uint32_t dynamicOffset = 0;
+  renderPass.setVertexBuffer(1, mInstanceBuffer, 0,
+                             MAX_NUM_INSTANCES * sizeof(InstanceAttributes));
   for (size_t i : toRender) {
     dynamicOffset = mUniformStride * mUniformIndices[i];
 
@@ -206,7 +226,19 @@ void Rendering::updateFrame() {
     // Set binding group
     renderPass.setBindGroup(0, mBindGroup, 1, &dynamicOffset);
 
-    renderPass.draw(mIndexCounts[i], 1, 0, 0); // changed
+    // The glyphs are one vector instanced once per sample or search hit
+    if (isSampling && i == 2) {
+      renderPass.draw(mIndexCounts[i], mGlyphCount, 0, 1);
+    } else if (i == 6 && isPropagate) {
+      renderPass.draw(mIndexCounts[i], NUM_CONE_GLYPHS, 0,
+                      FIRST_CONE_INSTANCE);
+    } else if (i == 6) {
+      renderPass.draw(mIndexCounts[i],
+                      static_cast<uint32_t>(mSearch.hits.size()), 0,
+                      FIRST_HIT_INSTANCE);
+    } else {
+      renderPass.draw(mIndexCounts[i], 1, 0, 0);
+    }
   }
 
   // We add the GUI drawing commands to the render pass
@@ -290,8 +322,8 @@ void Rendering::initAdapterAndDevice() {
     std::cout << "Initializing Device..." << std::endl;
   }
   RequiredLimits requiredLimits = Default;
-  requiredLimits.limits.maxVertexAttributes = 4;
-  requiredLimits.limits.maxVertexBuffers = 1;
+  requiredLimits.limits.maxVertexAttributes = 5;
+  requiredLimits.limits.maxVertexBuffers = 2;
   requiredLimits.limits.maxBufferSize = 150000 * sizeof(VertexAttributes);
   requiredLimits.limits.maxVertexBufferArrayStride = sizeof(VertexAttributes);
   requiredLimits.limits.minStorageBufferOffsetAlignment =
@@ -422,22 +454,608 @@ void Rendering::terminateDepthBuffer() {
   mDepthTexture.release();
 }
 
+Eigen::Matrix3d Rendering::inputRotation() const {
+  Eigen::Matrix3d input;
+  input << i00, i01, i02, i10, i11, i12, i20, i21, i22;
+  return LieAlgebra::orthonormalize(input);
+}
+
+Eigen::Matrix3d Rendering::leftRotation() const {
+  Eigen::Matrix3d lhs;
+  lhs << l100, l101, l102, l110, l111, l112, l120, l121, l122;
+  return LieAlgebra::orthonormalize(lhs);
+}
+
+Eigen::Matrix3d Rendering::rightRotation() const {
+  Eigen::Matrix3d rhs;
+  rhs << r100, r101, r102, r110, r111, r112, r120, r121, r122;
+  return LieAlgebra::orthonormalize(rhs);
+}
+
+Eigen::Matrix3d Rendering::eulerRotation() const {
+  Eigen::Vector3d angles(e0, e1, e2);
+  return RotationConversion::eulerToMatrix(
+      angles * (M_PI / 180.0),
+      static_cast<RotationConversion::EulerOrder>(eulerOrder));
+}
+
+Eigen::Matrix3d Rendering::axisAngleRotation() const {
+  Eigen::Vector3d axis(a0, a1, a2);
+  if (axis.norm() < 0.000001) {
+    return Eigen::Matrix3d::Identity();
+  }
+  return RotationConversion::axisAngleToMatrix(Eigen::AngleAxisd(
+      axisAngle * (M_PI / 180.0), axis.normalized()));
+}
+
+Eigen::Matrix3d Rendering::basisAlong(const Eigen::Vector3d &n) {
+  // The branchless construction of Duff et al., "Building an Orthonormal
+  // Basis, Revisited", which only needs a division
+  double sign = std::copysign(1.0, n.z());
+  double a = -1.0 / (sign + n.z());
+  double b = n.x() * n.y() * a;
+  Eigen::Matrix3d basis;
+  basis.col(0) << 1.0 + sign * n.x() * n.x() * a, sign * b, -sign * n.x();
+  basis.col(1) << b, sign + n.y() * n.y() * a, -n.y();
+  basis.col(2) = n;
+  return basis;
+}
+
+void Rendering::writeVector(int index, const Eigen::Vector3d &desired) {
+  Eigen::Vector3d v = Eigen::Vector3d::Zero();
+  v.x() = desired.x();
+  v.y() = -1 * desired.y();
+  v.z() = desired.z();
+
+  // The vector mesh points along z, so any right handed basis with v in its
+  // last column will do
+  mZScalar = v.norm();
+  Eigen::Vector3d n = Eigen::Vector3d::UnitZ();
+  if (mZScalar > 0) {
+    n = v / mZScalar;
+  }
+
+  mQueue.writeBuffer(mUniformBuffer,
+                     index * mUniformStride + offsetof(Uniform, zScalar),
+                     &mZScalar, sizeof(Uniform::zScalar));
+
+  writeTransform(index, transformOf(basisAlong(n)));
+}
+
+DualQuaternionAlgebraf::DualQuaternion
+Rendering::transformOf(const Eigen::Matrix3d &rotation,
+                       const Eigen::Vector3d &translation) {
+  // The uniform is single precision, so convert before doing any math
+  return DualQuaternionAlgebraf::fromRotationTranslation(
+      LieAlgebraf::matrixToQuaternion(rotation.cast<float>()),
+      translation.cast<float>());
+}
+
+void Rendering::writeTransform(
+    int index, const DualQuaternionAlgebraf::DualQuaternion &transform) {
+  std::array<float, 4> real = {transform.real.w(), transform.real.x(),
+                               transform.real.y(), transform.real.z()};
+  std::array<float, 4> dual = {transform.dual.w(), transform.dual.x(),
+                               transform.dual.y(), transform.dual.z()};
+  mQueue.writeBuffer(mUniformBuffer,
+                     index * mUniformStride + offsetof(Uniform, real), &real,
+                     sizeof(Uniform::real));
+  mQueue.writeBuffer(mUniformBuffer,
+                     index * mUniformStride + offsetof(Uniform, dual), &dual,
+                     sizeof(Uniform::dual));
+}
+
+Rendering::MeanSamples::MeanSamples(const Inputs &inputs) : inputs(inputs) {
+  if (inputs.count < 1 || !(inputs.spread > 0.0)) {
+    throw std::runtime_error("Mean samples need a count and a spread!");
+  }
+  // Each chunk draws its noise from a generator seeded with the chunk, so the
+  // samples only depend on the inputs and stay still while nothing changes
+  constexpr std::size_t chunkSize = 1 << 12;
+  std::size_t count = static_cast<std::size_t>(inputs.count);
+  std::array<std::vector<double>, 9> entries;
+  for (std::vector<double> &entry : entries) {
+    entry.resize(count);
+  }
+  ParallelDispatch::forEachChunk(
+      (count + chunkSize - 1) / chunkSize, [&](std::size_t chunk) {
+        std::mt19937 generator(static_cast<std::uint32_t>(chunk));
+        std::normal_distribution<double> normal(0.0, inputs.spread);
+        std::size_t end = std::min(count, (chunk + 1) * chunkSize);
+        for (std::size_t i = chunk * chunkSize; i < end; ++i) {
+          Eigen::Vector3d noise(normal(generator), normal(generator),
+                                normal(generator));
+          Eigen::Matrix3d sample =
+              inputs.center * LieAlgebra::exponentialMap(noise);
+          for (std::size_t k = 0; k < 9; ++k) {
+            entries[k][i] = sample.coeff(k / 3, k % 3);
+          }
+        }
+      });
+
+  RotationAveraging::SO3Arrays<const double> samples;
+  for (std::size_t k = 0; k < 9; ++k) {
+    samples.entries[k] = entries[k].data();
+  }
+  statistics = RotationAveraging::karcherMean(samples, count);
+
+  // The index is built once per set of samples and queried as often as the
+  // query moves
+  std::array<std::vector<double>, 4> components;
+  LieAlgebra::QuaternionArrays<double> quaternions;
+  for (std::size_t k = 0; k < 4; ++k) {
+    components[k].resize(count);
+    quaternions.components[k] = components[k].data();
+  }
+  LieAlgebra::matrixToQuaternion(samples, quaternions, count);
+  OrientationIndex::QuaternionArrays<const double> indexed;
+  for (std::size_t k = 0; k < 4; ++k) {
+    indexed.components[k] = components[k].data();
+  }
+  index = std::make_unique<OrientationIndex>(indexed, count);
+  packed = PackedQuaternions(indexed, count);
+
+  // Moved from the body frame of the mean into the world frame the vectors
+  // are drawn in
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(statistics.covariance);
+  for (int k = 0; k < 3; ++k) {
+    spreadAxes[k] = statistics.mean * solver.eigenvectors().col(k) *
+                    std::sqrt(std::max(solver.eigenvalues()(k), 0.0));
+  }
+}
+
+void Rendering::updateMean(const Eigen::Matrix3d &center) {
+  // Samples the worker has finished replace the ones drawn
+  if (mMean.next.valid() &&
+      mMean.next.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    // A failed build leaves the last samples drawn
+    try {
+      mMean.samples = mMean.next.get();
+      mMean.error.clear();
+    } catch (const std::exception &e) {
+      mMean.error = e.what();
+    }
+  }
+
+  // The noise needs a positive spread, and past pi the rotations wrap around
+  mMean.sampleCount = std::clamp(mMean.sampleCount, 1, MAX_MEAN_SAMPLES);
+  mMean.spread = mMean.spread > MIN_MEAN_SPREAD ? std::min(mMean.spread, M_PI)
+                                                : MIN_MEAN_SPREAD;
+
+  // Only resample when one of the inputs has changed, and one set at a time
+  // so that typing in a count does not start a build per keystroke
+  MeanSamples::Inputs inputs = {center, mMean.spread, mMean.sampleCount};
+  if (mMean.next.valid() || mMean.requested == inputs) {
+    return;
+  }
+  mMean.requested = inputs;
+  mMean.next = std::async(std::launch::async, [inputs] {
+    return std::shared_ptr<const MeanSamples>(
+        std::make_shared<MeanSamples>(inputs));
+  });
+}
+
+Rendering::InstanceAttributes
+Rendering::glyphAlong(const Eigen::Vector3d &desired) {
+  Eigen::Vector3d v(desired.x(), -desired.y(), desired.z());
+  double length = v.norm();
+  Eigen::Quaterniond orientation(basisAlong(
+      length > 0 ? Eigen::Vector3d(v / length) : Eigen::Vector3d::UnitZ()));
+  Eigen::Quaternionf rounded = orientation.cast<float>();
+  return {{rounded.w(), rounded.x(), rounded.y(), rounded.z()},
+          static_cast<float>(length)};
+}
+
+void Rendering::updateSearch() {
+  // Only query again when one of the inputs or the samples have changed
+  SearchState::Inputs &inputs = mSearch.inputs;
+  inputs.samples = mMean.samples;
+  if (inputs == mSearch.searched) {
+    return;
+  }
+  mSearch.searched = inputs;
+
+  const MeanSamples &samples = *inputs.samples;
+  Eigen::Quaterniond center = LieAlgebra::matrixToQuaternion(
+      samples.inputs.center * LieAlgebra::exponentialMap(inputs.query));
+  auto begin = std::chrono::steady_clock::now();
+  if (inputs.isRadius) {
+    mSearch.hits =
+        samples.index->withinAngle(center, inputs.degrees * M_PI / 180.0);
+  } else {
+    mSearch.hits = samples.index->nearest(
+        center, static_cast<std::size_t>(std::max(inputs.neighbors, 0)));
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  mSearch.milliseconds = elapsed.count();
+
+  // The nearest hits that fit in the instance buffer, each drawn as its
+  // tangent vector like the mean is
+  mSearch.hits.resize(
+      std::min<std::size_t>(mSearch.hits.size(), MAX_NUM_GLYPHS));
+  std::vector<InstanceAttributes> instances(mSearch.hits.size());
+  for (std::size_t i = 0; i < mSearch.hits.size(); ++i) {
+    Eigen::Quaterniond sample = samples.packed[mSearch.hits[i].index];
+    instances[i] = glyphAlong(LieAlgebra::quaternionLogarithmicMap(sample));
+  }
+  mQueue.writeBuffer(mInstanceBuffer,
+                     FIRST_HIT_INSTANCE * sizeof(InstanceAttributes),
+                     instances.data(),
+                     instances.size() * sizeof(InstanceAttributes));
+}
+
+void Rendering::updateCone() {
+  // mean exp(e) for e spread evenly over the one standard deviation ellipsoid,
+  // with the directions on a Fibonacci sphere
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(
+      mPropagated.covariance);
+  Eigen::Matrix3d scale =
+      solver.eigenvectors() *
+      solver.eigenvalues().cwiseMax(0.0).cwiseSqrt().asDiagonal();
+  double goldenAngle = M_PI * (3.0 - std::sqrt(5.0));
+  std::array<InstanceAttributes, NUM_CONE_GLYPHS> instances;
+  for (int i = 0; i < NUM_CONE_GLYPHS; ++i) {
+    double z = 1.0 - (2.0 * i + 1.0) / NUM_CONE_GLYPHS;
+    double r = std::sqrt(1.0 - z * z);
+    Eigen::Vector3d u(r * std::cos(goldenAngle * i),
+                      r * std::sin(goldenAngle * i), z);
+    instances[i] = glyphAlong(LieAlgebra::logarithmicMap(
+        mPropagated.mean * LieAlgebra::exponentialMap(scale * u)));
+  }
+  mQueue.writeBuffer(mInstanceBuffer,
+                     FIRST_CONE_INSTANCE * sizeof(InstanceAttributes),
+                     instances.data(), sizeof(instances));
+}
+
+void Rendering::updateSamples() {
+  // Both are capped by the size of the instance buffer
+  sampleCount = std::clamp(sampleCount, 1, MAX_NUM_GLYPHS);
+  hopfLevel = std::clamp(hopfLevel, 0, MAX_HOPF_LEVEL);
+  std::size_t count = samplingMethod == 0
+                          ? static_cast<std::size_t>(sampleCount)
+                          : RotationSamplerf::hopfGridSize(hopfLevel);
+  std::array<std::vector<float>, 4> components;
+  RotationSamplerf::QuaternionArrays<float> samples;
+  for (std::size_t k = 0; k < 4; ++k) {
+    components[k].resize(count);
+    samples.components[k] = components[k].data();
+  }
+  if (samplingMethod == 0) {
+    RotationSamplerf::uniform(static_cast<std::uint64_t>(sampleSeed), samples,
+                              count);
+  } else {
+    RotationSamplerf::hopfGrid(hopfLevel, samples);
+  }
+
+  std::vector<InstanceAttributes> instances(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    instances[i].orientation = {components[0][i], components[1][i],
+                                components[2][i], components[3][i]};
+    instances[i].length = 1.0f;
+  }
+  mQueue.writeBuffer(mInstanceBuffer, sizeof(InstanceAttributes),
+                     instances.data(), count * sizeof(InstanceAttributes));
+  mGlyphCount = static_cast<int>(count);
+}
+
+void Rendering::initInterpolation() {
+  // A tour of quarter and half turns about each axis, one second apart. The
+  // keyframes only depend on constants, so the compiler works them out.
+  using Tangent = LieAlgebraf::TangentValues;
+  using Quaternion = LieAlgebraf::QuaternionValues;
+  constexpr float quarterTurn = static_cast<float>(M_PI_2);
+  constexpr Quaternion aboutZ =
+      LieAlgebraf::quaternionExponentialMap(Tangent{0, 0, quarterTurn});
+  constexpr Quaternion aboutX =
+      LieAlgebraf::quaternionExponentialMap(Tangent{quarterTurn, 0, 0});
+  constexpr std::array<Quaternion, 6> tour = {
+      Quaternion{1, 0, 0, 0},
+      aboutZ,
+      LieAlgebraf::compose(aboutZ, aboutX),
+      LieAlgebraf::quaternionExponentialMap(Tangent{0, 2 * quarterTurn, 0}),
+      LieAlgebraf::inverse(aboutX),
+      Quaternion{1, 0, 0, 0}};
+
+  std::vector<Eigen::Quaternionf> keyframes;
+  std::vector<float> times;
+  for (const Quaternion &q : tour) {
+    keyframes.emplace_back(q[0], q[1], q[2], q[3]);
+    times.push_back(static_cast<float>(times.size()));
+  }
+
+  mInterpolation.interpolator = std::make_unique<RotationInterpolatorf>(
+      keyframes, times,
+      static_cast<RotationInterpolatorf::Method>(mInterpolation.method));
+  updateDeviation(keyframes, times);
+}
+
+void Rendering::updateDeviation(
+    const std::vector<Eigen::Quaternionf> &keyframes,
+    const std::vector<float> &times) {
+  // Both curves densely sampled over the whole tour, Slerp as the truth
+  constexpr std::size_t count = 1 << 14;
+  constexpr std::size_t windowLength = 1 << 7;
+  RotationInterpolatorf slerp(keyframes, times,
+                              RotationInterpolatorf::Method::Slerp);
+  std::vector<float> sampleTimes(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    sampleTimes[i] = times.front() + (times.back() - times.front()) *
+                                         static_cast<float>(i) / (count - 1);
+  }
+
+  std::array<std::vector<float>, 4> components;
+  LieAlgebraf::QuaternionArrays<float> quaternions;
+  for (std::size_t k = 0; k < 4; ++k) {
+    components[k].resize(count);
+    quaternions.components[k] = components[k].data();
+  }
+  LieAlgebraf::QuaternionArrays<const float> evaluated;
+  for (std::size_t k = 0; k < 4; ++k) {
+    evaluated.components[k] = components[k].data();
+  }
+  std::array<std::array<std::vector<float>, 9>, 2> entries;
+  std::array<LieAlgebraf::SO3Arrays<float>, 2> matrices;
+  std::array<RotationErrorMetricsf::SO3Arrays<const float>, 2> series;
+  for (std::size_t curve = 0; curve < 2; ++curve) {
+    for (std::size_t k = 0; k < 9; ++k) {
+      entries[curve][k].resize(count);
+      matrices[curve].entries[k] = entries[curve][k].data();
+      series[curve].entries[k] = entries[curve][k].data();
+    }
+    const RotationInterpolatorf &interpolator =
+        curve == 0 ? *mInterpolation.interpolator : slerp;
+    interpolator.evaluate(sampleTimes.data(), quaternions, count);
+    LieAlgebraf::quaternionToMatrix(evaluated, matrices[curve], count);
+  }
+
+  RotationErrorMetricsf metrics(windowLength);
+  metrics.add(series[0], series[1], count);
+  mInterpolation.deviation.clear();
+  for (const RotationErrorMetricsf::Window &window : metrics.windows()) {
+    mInterpolation.deviation.push_back(window.rmsGeodesic * 180.0f / M_PI);
+  }
+  mInterpolation.summary = metrics.summary();
+  mInterpolation.median = metrics.geodesicPercentile(0.5f) * 180.0f / M_PI;
+  mInterpolation.percentile = metrics.geodesicPercentile(0.95f) * 180.0f / M_PI;
+}
+
+void Rendering::initVelocity() {
+  // Enough samples for the first velocity to have its whole window, which
+  // makes the last one that of the current time
+  std::size_t count = 2 * static_cast<std::size_t>(mVelocity.halfWindow) + 2;
+  mVelocity.estimator = std::make_unique<AngularVelocityEstimatorf>(
+      VELOCITY_STEP, static_cast<std::size_t>(mVelocity.halfWindow));
+  mVelocity.times.resize(count);
+  for (std::vector<float> &component : mVelocity.quaternions) {
+    component.resize(count);
+  }
+  for (std::vector<float> &entry : mVelocity.orientations) {
+    entry.resize(count);
+  }
+  for (std::size_t k = 0; k < 3; ++k) {
+    mVelocity.bodyVelocities[k].resize(count);
+    mVelocity.worldVelocities[k].resize(count);
+  }
+}
+
+void Rendering::updateVelocity() {
+  std::size_t count = mVelocity.times.size();
+  std::size_t delay = mVelocity.estimator->delay();
+  for (std::size_t i = 0; i < count; ++i) {
+    mVelocity.times[i] =
+        mInterpolation.time +
+        (static_cast<float>(i) - static_cast<float>(count - 1 - delay)) *
+            VELOCITY_STEP;
+  }
+
+  RotationInterpolatorf::QuaternionArrays<float> quaternions;
+  LieAlgebraf::QuaternionArrays<const float> samples;
+  for (std::size_t k = 0; k < 4; ++k) {
+    quaternions.components[k] = mVelocity.quaternions[k].data();
+    samples.components[k] = mVelocity.quaternions[k].data();
+  }
+  mInterpolation.interpolator->evaluate(mVelocity.times.data(), quaternions,
+                                        count);
+
+  LieAlgebraf::SO3Arrays<float> matrices;
+  AngularVelocityEstimatorf::SO3Arrays<const float> orientations;
+  for (std::size_t k = 0; k < 9; ++k) {
+    matrices.entries[k] = mVelocity.orientations[k].data();
+    orientations.entries[k] = mVelocity.orientations[k].data();
+  }
+  LieAlgebraf::quaternionToMatrix(samples, matrices, count);
+
+  AngularVelocityEstimatorf::TangentArrays<float> body;
+  AngularVelocityEstimatorf::TangentArrays<float> world;
+  for (std::size_t k = 0; k < 3; ++k) {
+    body.components[k] = mVelocity.bodyVelocities[k].data();
+    world.components[k] = mVelocity.worldVelocities[k].data();
+  }
+  mVelocity.estimator->reset();
+  mVelocity.estimator->process(orientations, body, world, count);
+  for (std::size_t k = 0; k < 3; ++k) {
+    mVelocity.body(k) = mVelocity.bodyVelocities[k][count - 1];
+    mVelocity.world(k) = mVelocity.worldVelocities[k][count - 1];
+  }
+}
+
+Eigen::Vector3d Rendering::replayGyro(double time) {
+  constexpr double coningFrequency = 2 * M_PI * 40.0;
+  constexpr double coningAmplitude = 0.3;
+  return Eigen::Vector3d(
+      1.2 * std::sin(0.9 * time) +
+          coningAmplitude * std::cos(coningFrequency * time),
+      0.8 * std::cos(0.5 * time) +
+          coningAmplitude * std::sin(coningFrequency * time),
+      0.6 + 0.4 * std::sin(1.7 * time));
+}
+
+void Rendering::initReplay() {
+  // The replay starts wherever the typed quaternion is
+  mReplay.integrator = std::make_unique<RotationIntegrator>(
+      1.0 / (1000.0 * mReplay.rate),
+      static_cast<RotationIntegrator::Method>(mReplay.method),
+      mQuaternionInput.last());
+  mReplay.sample = 0;
+  mReplay.count = 0;
+  mReplay.clock = glfwGetTime();
+}
+
+void Rendering::updateReplay() {
+  // Every sample due since the last frame, dropping anything past a second
+  // behind after a stall
+  double dt = 1.0 / (1000.0 * mReplay.rate);
+  double now = glfwGetTime();
+  mReplay.clock = std::max(mReplay.clock, now - 1.0);
+  std::size_t count = static_cast<std::size_t>((now - mReplay.clock) / dt);
+  if (count == 0) {
+    return;
+  }
+  mReplay.clock += static_cast<double>(count) * dt;
+
+  // The buffers only grow, so a steady frame rate allocates nothing
+  RotationIntegrator::TangentArrays<const double> rates;
+  RotationIntegrator::QuaternionArrays<double> orientations;
+  for (std::size_t k = 0; k < 3; ++k) {
+    mReplay.rates[k].resize(std::max(mReplay.rates[k].size(), count));
+    rates.components[k] = mReplay.rates[k].data();
+  }
+  for (std::size_t k = 0; k < 4; ++k) {
+    mReplay.orientations[k].resize(
+        std::max(mReplay.orientations[k].size(), count));
+    orientations.components[k] = mReplay.orientations[k].data();
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    Eigen::Vector3d rate =
+        replayGyro(static_cast<double>(mReplay.sample + i) * dt);
+    for (std::size_t k = 0; k < 3; ++k) {
+      mReplay.rates[k][i] = rate(k);
+    }
+  }
+  mReplay.integrator->integrate(rates, orientations, count);
+  mReplay.sample += count;
+  mReplay.count = count;
+
+  Eigen::Quaterniond q = mReplay.integrator->orientation();
+  q0 = q.w();
+  q1 = q.x();
+  q2 = q.y();
+  q3 = q.z();
+}
+
+void Rendering::loadImuLog() {
+  try {
+    mFiltering.log = std::make_unique<ImuLog>(mFiltering.logPath);
+  } catch (const std::runtime_error &error) {
+    mFiltering.logError = error.what();
+    isFiltering = false;
+    return;
+  }
+  mFiltering.logError.clear();
+  isFiltering = true;
+  isReplaying = false;
+  initFiltering();
+}
+
+void Rendering::initFiltering() {
+  // Every filter starts from the orientation the first sample points at
+  ImuLog::ImuArrays<const double> imu = mFiltering.log->arrays();
+  Eigen::Vector3d accelerometer(imu.accelerometer[0][0],
+                                imu.accelerometer[1][0],
+                                imu.accelerometer[2][0]);
+  Eigen::Vector3d magnetometer = Eigen::Vector3d::Zero();
+  if (imu.magnetometer[0] != nullptr) {
+    magnetometer << imu.magnetometer[0][0], imu.magnetometer[1][0],
+        imu.magnetometer[2][0];
+  }
+  Eigen::Quaterniond initial =
+      AttitudeFilter::align(accelerometer, magnetometer);
+
+  mFiltering.filters.clear();
+  for (AttitudeFilter::Method method :
+       {AttitudeFilter::Method::Madgwick, AttitudeFilter::Method::Mahony,
+        AttitudeFilter::Method::ErrorStateKalman}) {
+    mFiltering.filters.emplace_back(mFiltering.log->dt(), method,
+                                    AttitudeFilter::Parameters(), initial);
+  }
+  mFiltering.sample = 0;
+  mFiltering.clock = glfwGetTime();
+}
+
+void Rendering::updateFiltering() {
+  // The samples of the log due since the last frame at its own rate, starting
+  // over once it runs out
+  if (mFiltering.sample == mFiltering.log->size()) {
+    initFiltering();
+  }
+  double dt = mFiltering.log->dt();
+  double now = glfwGetTime();
+  mFiltering.clock = std::max(mFiltering.clock, now - 1.0);
+  std::size_t count =
+      std::min(static_cast<std::size_t>((now - mFiltering.clock) / dt),
+               mFiltering.log->size() - mFiltering.sample);
+  if (count == 0) {
+    return;
+  }
+  mFiltering.clock += static_cast<double>(count) * dt;
+
+  // The buffers only grow, so a steady frame rate allocates nothing
+  std::array<AttitudeFilter::QuaternionArrays<double>, NUM_FILTERS>
+      orientations;
+  for (std::size_t filter = 0; filter < NUM_FILTERS; ++filter) {
+    for (std::size_t k = 0; k < 4; ++k) {
+      std::vector<double> &component = mFiltering.orientations[filter][k];
+      component.resize(std::max(component.size(), count));
+      orientations[filter].components[k] = component.data();
+    }
+  }
+  AttitudeFilter::processAll(mFiltering.filters.data(), orientations.data(),
+                             NUM_FILTERS,
+                             mFiltering.log->arrays(mFiltering.sample), count);
+  mFiltering.sample += count;
+
+  Eigen::Quaterniond q = mFiltering.filters[mFiltering.shown].orientation();
+  q0 = q.w();
+  q1 = q.x();
+  q2 = q.y();
+  q3 = q.z();
+}
+
 void Rendering::writeRotation() {
   if (isQuaternion) {
-    SE3 = transpose(mat4x4(
-        2 * (std::pow(q0, 2) + std::pow(q1, 2)) - 1, 2 * (q1 * q2 - q0 * q3),
-        2 * (q1 * q3 + q0 * q2), 0, 2 * (q1 * q2 + q0 * q3),
-        2 * (std::pow(q0, 2) + std::pow(q2, 2)) - 1, 2 * (q2 * q3 - q0 * q1), 0,
-        2 * (q1 * q3 - q0 * q2), 2 * (q2 * q3 + q0 * q1),
-        2 * (std::pow(q0, 2) + std::pow(q3, 2)) - 1, 0, 0, 0, 0, 1));
+    // Canonicalized, so what is typed in does not have to be a unit
+    // quaternion
+    Eigen::Quaterniond q = mQuaternionInput.canonicalize(
+        Eigen::Quaterniond(q0, q1, q2, q3), mIsQuaternionDegenerate);
+    mTransform = DualQuaternionAlgebraf::fromRotationTranslation(
+        q.cast<float>(), Eigen::Vector3f::Zero());
   } else if (isSO3) {
-    SE3 = transpose(mat4x4(i00, i01, i02, 0, i10, i11, i12, 0, i20, i21, i22, 0,
-                           0, 0, 0, 1));
+    mTransform = transformOf(inputRotation());
+  } else if (isEuler || isAxisAngle) {
+    mTransform = transformOf(isEuler ? eulerRotation() : axisAngleRotation());
+  } else if (isInterpolation) {
+    const RotationInterpolatorf &interpolator = *mInterpolation.interpolator;
+    if (mInterpolation.isPlaying) {
+      float duration = interpolator.endTime() - interpolator.startTime();
+      mInterpolation.time =
+          interpolator.startTime() +
+          std::fmod(static_cast<float>(glfwGetTime()), duration);
+    }
+    Eigen::Quaternionf q = interpolator.evaluate(mInterpolation.time);
+    mTransform = DualQuaternionAlgebraf::fromRotationTranslation(
+        q, Eigen::Vector3f::Zero());
+  } else if (isSE3) {
+    // The translation goes into the dual part, which the shader applies to
+    // positions but not to normals
+    mTransform = transformOf(inputRotation(), Eigen::Vector3d(p0, p1, p2));
+  } else if (isLieAlgebra && isAdd) {
+    mTransform = transformOf(
+        LieAlgebra::plus(leftRotation(), Eigen::Vector3d(t0, t1, t2)));
   }
 
-  mQueue.writeBuffer(mUniformBuffer,
-                     mUniformStride + offsetof(Uniform, rotation), &SE3,
-                     sizeof(Uniform::rotation));
+  writeTransform(1, mTransform);
 }
 
 ShaderModule Rendering::loadShaderModule(const std::filesystem::path &path,
@@ -514,9 +1132,29 @@ void Rendering::initRenderPipeline() {
   vertexBufferLayout.arrayStride = sizeof(VertexAttributes);
   vertexBufferLayout.stepMode = VertexStepMode::Vertex;
 
+  // Orientation and length of each instance
+  std::vector<VertexAttribute> instanceAttributes(2);
+  instanceAttributes[0].shaderLocation = 3;
+  instanceAttributes[0].format = VertexFormat::Float32x4;
+  instanceAttributes[0].offset = offsetof(InstanceAttributes, orientation);
+
+  instanceAttributes[1].shaderLocation = 4;
+  instanceAttributes[1].format = VertexFormat::Float32;
+  instanceAttributes[1].offset = offsetof(InstanceAttributes, length);
+
+  VertexBufferLayout instanceBufferLayout;
+  instanceBufferLayout.attributeCount =
+      static_cast<uint32_t>(instanceAttributes.size());
+  instanceBufferLayout.attributes = instanceAttributes.data();
+  instanceBufferLayout.arrayStride = sizeof(InstanceAttributes);
+  instanceBufferLayout.stepMode = VertexStepMode::Instance;
+
+  // One buffer for the mesh and one for the instances
+  std::array<VertexBufferLayout, 2> vertexBufferLayouts = {
+      vertexBufferLayout, instanceBufferLayout};
   pipelineDesc.vertex.bufferCount =
-      1; // Since I'm just using one buffer with offsets this stays at 1
-  pipelineDesc.vertex.buffers = &vertexBufferLayout;
+      static_cast<uint32_t>(vertexBufferLayouts.size());
+  pipelineDesc.vertex.buffers = vertexBufferLayouts.data();
 
   pipelineDesc.vertex.module = mShaderModule;
   pipelineDesc.vertex.entryPoint =
@@ -716,11 +1354,24 @@ void Rendering::initVertexBuffer() {
       static_cast<int>(mVertexDatas[mVertexDatas.size() - 1].size()));
 }
 
+void Rendering::initInstanceBuffer() {
+  BufferDescriptor bufferDesc;
+  bufferDesc.size = MAX_NUM_INSTANCES * sizeof(InstanceAttributes);
+  bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
+  bufferDesc.mappedAtCreation = false;
+  mInstanceBuffer = mDevice.createBuffer(bufferDesc);
+
+  InstanceAttributes identity = {{1.0f, 0.0f, 0.0f, 0.0f}, 1.0f};
+  mQueue.writeBuffer(mInstanceBuffer, 0, &identity, sizeof(identity));
+}
+
 void Rendering::terminateGeometry() {
   for (auto buff : mVertexBuffers) {
     buff.destroy();
     buff.release();
   }
+  mInstanceBuffer.destroy();
+  mInstanceBuffer.release();
 }
 
 void Rendering::terminateUniforms() {
@@ -752,8 +1403,7 @@ void Rendering::initBindGroup() {
 
 void Rendering::terminateBindGroup() { mBindGroup.release(); }
 
-void Rendering::initUniform(int index, const mat4x4 &rotation, float x, float y,
-                            float z) {
+void Rendering::initUniform(int index, float x, float y, float z) {
   // View from which the
   vec3 focalPoint(x, y, z);
 
@@ -784,7 +1434,8 @@ void Rendering::initUniform(int index, const mat4x4 &rotation, float x, float y,
 
   mUniforms.zScalar = 1.0f;
   mUniforms.color = {0.0f, 1.0f, 0.4f, 1.0f};
-  mUniforms.rotation = rotation;
+  mUniforms.real = {1.0f, 0.0f, 0.0f, 0.0f};
+  mUniforms.dual = {0.0f, 0.0f, 0.0f, 0.0f};
 
   mQueue.writeBuffer(mUniformBuffer, index * mUniformStride, &mUniforms,
                      sizeof(Uniform));
@@ -808,8 +1459,6 @@ void Rendering::initUniformBuffer() {
 
 void Rendering::adjustView(float x, float y, float z) {
   for (size_t i = 0; i < MAX_NUM_UNIFORMS; ++i) {
-    initUniform(
-        i, transpose(mat4x4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1)), x,
-        y, z);
+    initUniform(i, x, y, z);
   }
 }
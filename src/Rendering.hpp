@@ -4,10 +4,14 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <math.h>
+#include <memory>
+#include <random>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -40,11 +44,26 @@
 
 // EIGEN
 #include <Eigen/Core>
-#include <Eigen/QR>
+#include <Eigen/Eigenvalues>
 
 // Codebase
+#include "AngularVelocity.hpp"
+#include "AttitudeFilter.hpp"
+#include "Averaging.hpp"
+#include "Canonicalization.hpp"
+#include "Compression.hpp"
+#include "Conversion.hpp"
+#include "DualQuaternion.hpp"
+#include "ErrorMetrics.hpp"
 #include "GLFW.hpp"
+#include "Integration.hpp"
+#include "Interpolation.hpp"
 #include "LieAlgebra.hpp"
+#include "OrientationIndex.hpp"
+#include "Parallel.hpp"
+#include "SE3Algebra.hpp"
+#include "Sampling.hpp"
+#include "Uncertainty.hpp"
 #include "utils.hpp"
 
 #ifdef DEBUG
@@ -62,7 +81,10 @@ private:
     glm::mat4x4 projectionMatrix;
     glm::mat4x4 viewMatrix;
     glm::mat4x4 modelMatrix;
-    glm::mat4x4 rotation;
+    // Rigid transform of the mesh as a w, x, y, z dual quaternion, half the
+    // size of a matrix and still rigid after blending
+    std::array<float, 4> real;
+    std::array<float, 4> dual;
     // Color
     std::array<float, 4> color;
     // How far the mesh should scale in z direction (vector)
@@ -80,6 +102,13 @@ private:
     glm::vec3 color;
   };
 
+  // Fields each instance will have, a w, x, y, z quaternion that turns the
+  // mesh before the uniform rotation does and a stretch along its z axis
+  struct InstanceAttributes {
+    std::array<float, 4> orientation;
+    float length;
+  };
+
   // Window
   GLFW::WindowPtr mWindow = nullptr;
 
@@ -126,10 +155,14 @@ private:
   std::vector<wgpu::Buffer> mVertexBuffers;
   std::vector<int> mUniformIndices;
 
+  // Slot 0 holds the identity for every ordinary draw, the glyphs follow it
+  wgpu::Buffer mInstanceBuffer = nullptr;
+
   // Uniforms
   wgpu::Buffer mUniformBuffer = nullptr;
   Uniform mUniforms;
-  glm::mat4x4 SE3;
+  DualQuaternionAlgebraf::DualQuaternion mTransform = {
+      Eigen::Quaternionf::Identity(), Eigen::Quaternionf(0, 0, 0, 0)};
   float mZScalar = 1.0f;
 
   // Uniform Vars
@@ -149,6 +182,41 @@ private:
   double q1 = 0.0;
   double q2 = 0.0;
   double q3 = 0.0;
+  // What is typed in, normalized and kept on the hemisphere of the last frame.
+  // A degenerate quaternion keeps the last rotation on screen.
+  QuaternionCanonicalizer mQuaternionInput;
+  bool mIsQuaternionDegenerate = false;
+
+  // The quaternion integrated from a replayed gyro stream instead of typed in
+  bool isReplaying = false;
+  struct ReplayState {
+    int rate = 1;
+    int method = 2;
+    std::unique_ptr<RotationIntegrator> integrator;
+    std::size_t sample = 0;
+    double clock = 0.0;
+    // Samples integrated in the last frame
+    std::size_t count = 0;
+    std::array<std::vector<double>, 3> rates;
+    std::array<std::vector<double>, 4> orientations;
+  };
+  ReplayState mReplay;
+
+  // The quaternion estimated from a loaded IMU log by every attitude filter
+  // side by side, the shown one drives the view
+  static constexpr std::size_t NUM_FILTERS = 3;
+  bool isFiltering = false;
+  struct FilterState {
+    char logPath[256] = "";
+    int shown = 2;
+    std::string logError;
+    std::unique_ptr<ImuLog> log;
+    std::vector<AttitudeFilter> filters;
+    std::size_t sample = 0;
+    double clock = 0.0;
+    std::array<std::array<std::vector<double>, 4>, NUM_FILTERS> orientations;
+  };
+  FilterState mFiltering;
 
   // SO3 Matrix
   bool isSO3 = false;
@@ -156,6 +224,52 @@ private:
   double i10 = 0, i11 = 1, i12 = 0;
   double i20 = 0, i21 = 0, i22 = 1;
 
+  // Euler angles in degrees, in the convention picked from the list
+  bool isEuler = false;
+  int eulerOrder = static_cast<int>(RotationConversion::EulerOrder::ZYX);
+  double e0 = 0, e1 = 0, e2 = 0;
+
+  // Axis and angle in degrees, the axis does not need to be unit length
+  bool isAxisAngle = false;
+  double a0 = 0, a1 = 0, a2 = 1;
+  double axisAngle = 0;
+
+  // SE3 Matrix, the rotation is shared with the SO3 matrix inputs
+  bool isSE3 = false;
+  double p0 = 0, p1 = 0, p2 = 0;
+
+  // Keyframe interpolation
+  bool isInterpolation = false;
+  struct InterpolationState {
+    bool isPlaying = true;
+    int method = 0;
+    float time = 0.0f;
+    std::unique_ptr<RotationInterpolatorf> interpolator;
+    // How far the chosen method strays from Slerp through the same keyframes,
+    // the RMS of each window in degrees for the plot
+    std::vector<float> deviation;
+    RotationErrorMetricsf::Summary summary;
+    float median = 0.0f;
+    float percentile = 0.0f;
+  };
+  InterpolationState mInterpolation;
+
+  // Angular velocity of the interpolated rotation, estimated from a stream of
+  // samples of the curve that ends at the current time and drawn as a vector
+  struct VelocityState {
+    int halfWindow = 0;
+    std::unique_ptr<AngularVelocityEstimatorf> estimator;
+    std::vector<float> times;
+    std::array<std::vector<float>, 4> quaternions;
+    std::array<std::vector<float>, 9> orientations;
+    std::array<std::vector<float>, 3> bodyVelocities;
+    std::array<std::vector<float>, 3> worldVelocities;
+    // Those of the current time
+    Eigen::Vector3f body = Eigen::Vector3f::Zero();
+    Eigen::Vector3f world = Eigen::Vector3f::Zero();
+  };
+  VelocityState mVelocity;
+
   // Lie minus operation
   bool isLieAlgebra = false;
 
@@ -172,7 +286,84 @@ private:
   double r100 = 1, r101 = 0, r102 = 0;
   double r110 = 0, r111 = 1, r112 = 0;
   double r120 = 0, r121 = 0, r122 = 1;
-  glm::mat4x4 rotationGLM;
+
+  // Tangent vector that is added onto the left hand side
+  double t0 = 0, t1 = 0, t2 = 0;
+
+  // Rotations scattered about a center, their mean and spread and an index
+  // over them. Built all at once from the inputs and only read after that.
+  struct MeanSamples {
+    struct Inputs {
+      Eigen::Matrix3d center = Eigen::Matrix3d::Identity();
+      double spread = 0.0;
+      int count = 0;
+
+      bool operator==(const Inputs &) const = default;
+    };
+
+    explicit MeanSamples(const Inputs &inputs);
+
+    Inputs inputs;
+    RotationAveraging::Statistics statistics;
+    // One standard deviation along each principal axis, in the world frame
+    std::array<Eigen::Vector3d, 3> spreadAxes;
+    std::unique_ptr<OrientationIndex> index;
+    // Packed once the mean and the index are built, which is all the search
+    // needs of them
+    PackedQuaternions packed;
+  };
+
+  // Mean of rotations scattered about the left hand side. The samples are
+  // rebuilt on another thread when the count, spread or center change, the
+  // frames draw the last ones built until the next ones are in.
+  bool isMean = false;
+  struct MeanState {
+    int sampleCount = 100000;
+    double spread = 0.3;
+    std::shared_ptr<const MeanSamples> samples;
+    std::future<std::shared_ptr<const MeanSamples>> next;
+    // Inputs of the last build started, kept when it fails so that the same
+    // inputs are not built again every frame
+    MeanSamples::Inputs requested;
+    std::string error;
+  };
+  MeanState mMean;
+
+  // Samples near center * exp(query), found through the index of the mean
+  // samples and drawn as a vector glyph each
+  struct SearchState {
+    struct Inputs {
+      std::shared_ptr<const MeanSamples> samples;
+      Eigen::Vector3d query = Eigen::Vector3d::Zero();
+      bool isRadius = true;
+      double degrees = 10.0;
+      int neighbors = 100;
+
+      bool operator==(const Inputs &) const = default;
+    };
+
+    // What is typed in and what the hits were found for
+    Inputs inputs;
+    Inputs searched;
+    std::vector<OrientationIndex::Neighbor> hits;
+    double milliseconds = 0.0;
+  };
+  SearchState mSearch;
+
+  // Composition of two uncertain rotations, each with a standard deviation in
+  // radians about the axes of its own body frame
+  bool isPropagate = false;
+  double ls0 = 0.05, ls1 = 0.05, ls2 = 0.2;
+  double rs0 = 0.1, rs1 = 0.02, rs2 = 0.02;
+  RotationUncertainty::Gaussian mPropagated;
+
+  // Rotation samples drawn as a vector glyph each
+  bool isSampling = false;
+  int samplingMethod = 0;
+  int sampleCount = 1000;
+  int sampleSeed = 0;
+  int hopfLevel = 1;
+  int mGlyphCount = 0;
 
   // CONSTANTS
   size_t mUniformStride;
@@ -185,8 +376,32 @@ private:
   static constexpr int IMGUI_DOUBLE_SCALAR = 9;
   static constexpr int IMGUI_FLOAT_SCALAR = 8;
 
+  // Seconds between the samples the angular velocity is estimated from, and
+  // the seconds of rotation its vector is drawn as
+  static constexpr float VELOCITY_STEP = 0.01f;
+  static constexpr float VELOCITY_SCALE = 0.25f;
+
   // Maximum number of uniforms for the meshes
-  static constexpr int MAX_NUM_UNIFORMS = 3;
+  static constexpr int MAX_NUM_UNIFORMS = 7;
+
+  // The finest Hopf grid that is drawn and the glyphs it needs
+  static constexpr int MAX_HOPF_LEVEL = 2;
+  static constexpr int MAX_NUM_GLYPHS = 72 << (3 * MAX_HOPF_LEVEL);
+
+  // Bounds on the inputs of the mean samples
+  static constexpr int MAX_MEAN_SAMPLES = 1 << 22;
+  static constexpr double MIN_MEAN_SPREAD = 1e-6;
+
+  // The identity, the sampling glyphs and then the search hit glyphs
+  static constexpr int FIRST_HIT_INSTANCE = MAX_NUM_GLYPHS + 1;
+
+  // Glyphs drawn out to the one standard deviation ellipsoid of a propagated
+  // rotation, after the search hits
+  static constexpr int NUM_CONE_GLYPHS = 64;
+  static constexpr int FIRST_CONE_INSTANCE =
+      FIRST_HIT_INSTANCE + MAX_NUM_GLYPHS;
+  static constexpr int MAX_NUM_INSTANCES =
+      FIRST_CONE_INSTANCE + NUM_CONE_GLYPHS;
 
   // Max mesh buffer size
   static constexpr int MAX_BUFFER_SIZE = 1000000 * sizeof(VertexAttributes);
@@ -224,11 +439,11 @@ private:
 
   void loadGeometry(const std::string &url, int uniformID);
   void initVertexBuffer();
+  void initInstanceBuffer();
   void terminateGeometry();
 
   void initUniformBuffer();
-  void initUniform(int index, const glm::mat4x4 &rotation, float x, float y,
-                   float z);
+  void initUniform(int index, float x, float y, float z);
   void terminateUniforms();
 
   void initBindGroup();
@@ -238,6 +453,62 @@ private:
   void terminateGUI();
   void updateGUI(wgpu::RenderPassEncoder renderPass);
 
+  // The matrices typed into the GUI, projected onto SO3 so that rounded or
+  // mistyped entries still describe a rotation
+  Eigen::Matrix3d inputRotation() const;
+  Eigen::Matrix3d leftRotation() const;
+  Eigen::Matrix3d rightRotation() const;
+
+  // The Euler and axis angle inputs as rotation matrices
+  Eigen::Matrix3d eulerRotation() const;
+  Eigen::Matrix3d axisAngleRotation() const;
+
+  // A right handed basis with n in its last column
+  static Eigen::Matrix3d basisAlong(const Eigen::Vector3d &n);
+
+  void writeVector(int index, const Eigen::Vector3d &desired);
+
+  // The rigid transform the shader applies to the mesh of the uniform at index
+  static DualQuaternionAlgebraf::DualQuaternion
+  transformOf(const Eigen::Matrix3d &rotation,
+              const Eigen::Vector3d &translation = Eigen::Vector3d::Zero());
+  void writeTransform(int index,
+                      const DualQuaternionAlgebraf::DualQuaternion &transform);
+
+  // A vector glyph drawn like writeVector draws desired
+  static InstanceAttributes glyphAlong(const Eigen::Vector3d &desired);
+
+  // Takes the samples the worker has finished and starts it on the next ones
+  // when the inputs differ, without waiting on it
+  void updateMean(const Eigen::Matrix3d &center);
+
+  void updateSearch();
+
+  void updateCone();
+
+  void updateSamples();
+
+  void initInterpolation();
+
+  void updateDeviation(const std::vector<Eigen::Quaternionf> &keyframes,
+                       const std::vector<float> &times);
+
+  void initVelocity();
+  void updateVelocity();
+
+  // Gyro rates of a tumbling body with a fast coning vibration on top, what
+  // an IMU on a vehicle measures
+  static Eigen::Vector3d replayGyro(double time);
+
+  void initReplay();
+  void updateReplay();
+
+  // Reads the log at the typed path and starts the filters on it, keeping the
+  // error when it cannot
+  void loadImuLog();
+  void initFiltering();
+  void updateFiltering();
+
   void writeRotation();
 
   void adjustView(float x, float y, float z);
@@ -0,0 +1,297 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <array>
+#include <cstddef>
+
+// Rigid body transforms. A pose is the homogeneous matrix [R t; 0 1] and its
+// tangent is the twist (rho, phi) with phi the so3 rotation vector, so that
+// exp(rho, phi) = [exp(phi) V(phi) rho; 0 1] with V the left Jacobian of SO3.
+template <class Scalar> class BasicSE3Algebra {
+private:
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Matrix4 = Eigen::Matrix<Scalar, 4, 4>;
+  using Matrix6 = Eigen::Matrix<Scalar, 6, 6>;
+  using Vector6 = Eigen::Matrix<Scalar, 6, 1>;
+
+public:
+  // Structure of arrays view over a batch of poses, entries[4 * row + col]
+  // covers the top three rows of the homogeneous matrix, so entries 3, 7 and
+  // 11 are the translation
+  template <class T> struct SE3Arrays {
+    std::array<T *, 12> entries;
+  };
+
+  // Structure of arrays view over a batch of twists, rho then phi
+  template <class T> struct TwistArrays {
+    std::array<T *, 6> components;
+  };
+
+  // Row major 6x6 matrices such as the adjoint
+  template <class T> struct Matrix6Arrays {
+    std::array<T *, 36> entries;
+  };
+
+  static Matrix4 exponentialMap(const Vector6 &se3) {
+    Pack<Scalar, 1> xi[6];
+    Pack<Scalar, 1> M[12];
+    for (std::size_t k = 0; k < 6; ++k) {
+      xi[k] = se3.coeff(k);
+    }
+    exponentialMapKernel(xi, M);
+    return toMatrix(M);
+  }
+
+  static void exponentialMap(const TwistArrays<const Scalar> &se3,
+                             const SE3Arrays<Scalar> &SE3, std::size_t count) {
+    Kernels::parallelForEachPack(count, 18, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P xi[6];
+      P M[12];
+      Kernels::load(se3.components, index, xi);
+      exponentialMapKernel(xi, M);
+      Kernels::store(M, index, SE3.entries);
+    });
+  }
+
+  // Unique for rotations of at most pi
+  static Vector6 logarithmicMap(const Matrix4 &SE3) {
+    Pack<Scalar, 1> M[12];
+    Pack<Scalar, 1> xi[6];
+    fromMatrix(SE3, M);
+    logarithmicMapKernel(M, xi);
+
+    Vector6 se3;
+    for (std::size_t k = 0; k < 6; ++k) {
+      se3(k) = xi[k].v;
+    }
+    return se3;
+  }
+
+  static void logarithmicMap(const SE3Arrays<const Scalar> &SE3,
+                             const TwistArrays<Scalar> &se3,
+                             std::size_t count) {
+    Kernels::parallelForEachPack(count, 18, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P M[12];
+      P xi[6];
+      Kernels::load(SE3.entries, index, M);
+      logarithmicMapKernel(M, xi);
+      Kernels::store(xi, index, se3.components);
+    });
+  }
+
+  // Maps a twist in the frame of SE3 to the world frame:
+  // SE3 exp(xi) = exp(Ad(SE3) xi) SE3
+  static Matrix6 adjoint(const Matrix4 &SE3) {
+    Pack<Scalar, 1> M[12];
+    Pack<Scalar, 1> A[36];
+    fromMatrix(SE3, M);
+    adjointKernel(M, A);
+
+    Matrix6 adjoint;
+    for (std::size_t k = 0; k < 36; ++k) {
+      adjoint(k / 6, k % 6) = A[k].v;
+    }
+    return adjoint;
+  }
+
+  static void adjoint(const SE3Arrays<const Scalar> &SE3,
+                      const Matrix6Arrays<Scalar> &adjoint,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 48, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P M[12];
+      P A[36];
+      Kernels::load(SE3.entries, index, M);
+      adjointKernel(M, A);
+      Kernels::store(A, index, adjoint.entries);
+    });
+  }
+
+  static Matrix4 compose(const Matrix4 &lhs, const Matrix4 &rhs) {
+    Pack<Scalar, 1> a[12];
+    Pack<Scalar, 1> b[12];
+    Pack<Scalar, 1> M[12];
+    fromMatrix(lhs, a);
+    fromMatrix(rhs, b);
+    composeKernel(a, b, M);
+    return toMatrix(M);
+  }
+
+  static void compose(const SE3Arrays<const Scalar> &lhs,
+                      const SE3Arrays<const Scalar> &rhs,
+                      const SE3Arrays<Scalar> &result, std::size_t count) {
+    Kernels::parallelForEachPack(count, 36, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[12];
+      P b[12];
+      P M[12];
+      Kernels::load(lhs.entries, index, a);
+      Kernels::load(rhs.entries, index, b);
+      composeKernel(a, b, M);
+      Kernels::store(M, index, result.entries);
+    });
+  }
+
+  // [R^T -R^T t; 0 1]
+  static Matrix4 inverse(const Matrix4 &SE3) {
+    Pack<Scalar, 1> M[12];
+    Pack<Scalar, 1> inverse[12];
+    fromMatrix(SE3, M);
+    inverseKernel(M, inverse);
+    return toMatrix(inverse);
+  }
+
+  static void inverse(const SE3Arrays<const Scalar> &SE3,
+                      const SE3Arrays<Scalar> &result, std::size_t count) {
+    Kernels::parallelForEachPack(count, 24, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P M[12];
+      P inverse[12];
+      Kernels::load(SE3.entries, index, M);
+      inverseKernel(M, inverse);
+      Kernels::store(inverse, index, result.entries);
+    });
+  }
+
+private:
+  static void fromMatrix(const Matrix4 &SE3, Pack<Scalar, 1> (&M)[12]) {
+    for (std::size_t k = 0; k < 12; ++k) {
+      M[k] = SE3.coeff(k / 4, k % 4);
+    }
+  }
+
+  static Matrix4 toMatrix(const Pack<Scalar, 1> (&M)[12]) {
+    Matrix4 SE3 = Matrix4::Identity();
+    for (std::size_t k = 0; k < 12; ++k) {
+      SE3(k / 4, k % 4) = M[k].v;
+    }
+    return SE3;
+  }
+
+  template <class P>
+  static void rotation(const P (&M)[12], P (&R)[9]) {
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[k] = M[4 * (k / 3) + k % 3];
+    }
+  }
+
+  template <class P>
+  static void assemble(const P (&R)[9], const P (&t)[3], P (&M)[12]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        M[4 * row + col] = R[3 * row + col];
+      }
+      M[4 * row + 3] = t[row];
+    }
+  }
+
+  // Row major y = A * x
+  template <class P>
+  static void multiplyVector(const P (&A)[9], const P (&x)[3], P (&y)[3]) {
+    for (std::size_t row = 0; row < 3; ++row) {
+      y[row] =
+          A[3 * row] * x[0] + A[3 * row + 1] * x[1] + A[3 * row + 2] * x[2];
+    }
+  }
+
+  template <class P>
+  static void exponentialMapKernel(const P (&xi)[6], P (&M)[12]) {
+    P rho[3] = {xi[0], xi[1], xi[2]};
+    P phi[3] = {xi[3], xi[4], xi[5]};
+
+    // One set of coefficients serves both matrices, since sin(theta) / theta
+    // = 1 - theta^2 C
+    P theta2 = phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2];
+    P B;
+    P C;
+    Kernels::jacobianCoefficients(theta2, B, C);
+    P R[9];
+    P V[9];
+    Kernels::skewPolynomialKernel(phi, theta2, P(1.0) - theta2 * C, B, R);
+    Kernels::skewPolynomialKernel(phi, theta2, B, C, V);
+
+    P t[3];
+    multiplyVector(V, rho, t);
+    assemble(R, t, M);
+  }
+
+  template <class P>
+  static void logarithmicMapKernel(const P (&M)[12], P (&xi)[6]) {
+    P R[9];
+    rotation(M, R);
+    P phi[3];
+    Kernels::logarithmicMapKernel(R, phi);
+
+    // rho = V^-1 t
+    P theta2 = phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2];
+    P inverseV[9];
+    Kernels::skewPolynomialKernel(phi, theta2, P(-0.5),
+                                  Kernels::inverseJacobianCoefficient(theta2),
+                                  inverseV);
+    P t[3] = {M[3], M[7], M[11]};
+    P rho[3];
+    multiplyVector(inverseV, t, rho);
+
+    for (std::size_t k = 0; k < 3; ++k) {
+      xi[k] = rho[k];
+      xi[k + 3] = phi[k];
+    }
+  }
+
+  // [R [t]x R; 0 R]
+  template <class P>
+  static void adjointKernel(const P (&M)[12], P (&A)[36]) {
+    P R[9];
+    rotation(M, R);
+    P t[3] = {M[3], M[7], M[11]};
+    P skew[9] = {P(0.0), -t[2], t[1], t[2], P(0.0), -t[0], -t[1], t[0], P(0.0)};
+    P skewR[9];
+    Kernels::multiplyKernel(skew, R, skewR);
+
+    for (std::size_t row = 0; row < 3; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        A[6 * row + col] = R[3 * row + col];
+        A[6 * row + col + 3] = skewR[3 * row + col];
+        A[6 * (row + 3) + col] = P(0.0);
+        A[6 * (row + 3) + col + 3] = R[3 * row + col];
+      }
+    }
+  }
+
+  template <class P>
+  static void composeKernel(const P (&a)[12], const P (&b)[12], P (&M)[12]) {
+    P Ra[9];
+    P Rb[9];
+    rotation(a, Ra);
+    rotation(b, Rb);
+    P R[9];
+    Kernels::multiplyKernel(Ra, Rb, R);
+
+    P tb[3] = {b[3], b[7], b[11]};
+    P t[3];
+    multiplyVector(Ra, tb, t);
+    t[0] = t[0] + a[3];
+    t[1] = t[1] + a[7];
+    t[2] = t[2] + a[11];
+    assemble(R, t, M);
+  }
+
+  template <class P>
+  static void inverseKernel(const P (&M)[12], P (&inverse)[12]) {
+    P RT[9];
+    for (std::size_t k = 0; k < 9; ++k) {
+      RT[k] = M[4 * (k % 3) + k / 3];
+    }
+    P t[3] = {M[3], M[7], M[11]};
+    P RTt[3];
+    multiplyVector(RT, t, RTt);
+    P negated[3] = {-RTt[0], -RTt[1], -RTt[2]};
+    assemble(RT, negated, inverse);
+  }
+};
+
+using SE3Algebra = BasicSE3Algebra<double>;
+using SE3Algebraf = BasicSE3Algebra<float>;
@@ -0,0 +1,190 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Uniformly distributed and gridded rotations in bulk. Every rotation is a pure
+// function of the seed or grid level and its index, so a batch can be split
+// across threads any way at all and still come out bit identical.
+template <class Scalar> class BasicRotationSampler {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Quaternion = Eigen::Quaternion<Scalar>;
+
+public:
+  template <class T>
+  using QuaternionArrays = typename SO3::template QuaternionArrays<T>;
+
+  // Rotation number index of the stream seed, drawn uniformly with respect to
+  // the Haar measure by Shoemake's subgroup algorithm
+  static Quaternion uniform(std::uint64_t seed, std::uint64_t index) {
+    Pack<Scalar, 1> q[4];
+    uniformKernel(seed, index, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  // Rotations first to first + count - 1 of the stream seed, so a long stream
+  // can be produced in pieces
+  static void uniform(std::uint64_t seed, const QuaternionArrays<Scalar> &q,
+                      std::size_t count, std::uint64_t first = 0) {
+    Kernels::parallelForEachPack(count, 4, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P quaternion[4];
+      uniformKernel(seed, first + index, quaternion);
+      Kernels::store(quaternion, index, q.components);
+    });
+  }
+
+  // Yershova et al.'s Hopf fibration grid: the HEALPix grid with 12 * 4^level
+  // cells on the sphere times 6 * 2^level angles about each direction. Level 0
+  // has 72 rotations and every level makes the cells half as wide.
+  static std::size_t hopfGridSize(int level) {
+    return std::size_t(72) << (3 * level);
+  }
+
+  static Quaternion hopfGrid(int level, std::uint64_t index) {
+    Pack<Scalar, 1> q[4];
+    hopfGridKernel(level, index, q);
+    return Quaternion(q[0].v, q[1].v, q[2].v, q[3].v);
+  }
+
+  // q must hold hopfGridSize(level) rotations
+  static void hopfGrid(int level, const QuaternionArrays<Scalar> &q) {
+    Kernels::parallelForEachPack(
+        hopfGridSize(level), 4, [&](auto tag, std::size_t index) {
+          using P = typename decltype(tag)::type;
+          P quaternion[4];
+          hopfGridKernel(level, index, quaternion);
+          Kernels::store(quaternion, index, q.components);
+        });
+  }
+
+private:
+  // SplitMix64's output function, which turns consecutive counters into
+  // independent looking 64 bit words
+  static constexpr std::uint64_t mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  // Draw number counter of the stream seed in [0, 1), with as many random bits
+  // as the mantissa holds
+  static Scalar random(std::uint64_t seed, std::uint64_t counter) {
+    std::uint64_t bits = mix(mix(seed) + (counter + 1) * 0x9E3779B97F4A7C15ULL);
+    if constexpr (std::is_same_v<Scalar, float>) {
+      return static_cast<float>(bits >> 40) * 0x1.0p-24f;
+    } else {
+      return static_cast<double>(bits >> 11) * 0x1.0p-53;
+    }
+  }
+
+  // Centre of a HEALPix cell in the ring ordering, as z = cos(theta) and phi
+  static void healpixCenter(std::uint64_t nside, std::uint64_t pixel,
+                            double &z, double &phi) {
+    std::uint64_t numPixels = 12 * nside * nside;
+    std::uint64_t capPixels = 2 * nside * (nside - 1);
+    double inverseArea = 4.0 / static_cast<double>(numPixels);
+    if (pixel < capPixels) {
+      std::uint64_t ring =
+          (1 + static_cast<std::uint64_t>(std::sqrt(1.0 + 2.0 * pixel))) / 2;
+      std::uint64_t ringPixel = pixel + 1 - 2 * ring * (ring - 1);
+      z = 1.0 - static_cast<double>(ring * ring) * inverseArea;
+      phi = (static_cast<double>(ringPixel) - 0.5) * M_PI_2 /
+            static_cast<double>(ring);
+    } else if (pixel < numPixels - capPixels) {
+      std::uint64_t offset = pixel - capPixels;
+      std::uint64_t ring = offset / (4 * nside) + nside;
+      std::uint64_t ringPixel = offset % (4 * nside) + 1;
+      double shift = (ring + nside) % 2 == 1 ? 1.0 : 0.5;
+      z = static_cast<double>(2 * nside) - static_cast<double>(ring);
+      z *= 2.0 / (3.0 * static_cast<double>(nside));
+      phi = (static_cast<double>(ringPixel) - shift) * M_PI_2 /
+            static_cast<double>(nside);
+    } else {
+      // Mirror of the north cap, with rings counted from the south pole
+      std::uint64_t offset = numPixels - pixel;
+      std::uint64_t ring =
+          (1 + static_cast<std::uint64_t>(std::sqrt(2.0 * offset - 1.0))) / 2;
+      std::uint64_t ringPixel = 4 * ring + 1 - (offset - 2 * ring * (ring - 1));
+      z = static_cast<double>(ring * ring) * inverseArea - 1.0;
+      phi = (static_cast<double>(ringPixel) - 0.5) * M_PI_2 /
+            static_cast<double>(ring);
+    }
+  }
+
+  // q = (sqrt(u1) cos(2 pi u3), sqrt(1 - u1) sin(2 pi u2),
+  //      sqrt(1 - u1) cos(2 pi u2), sqrt(u1) sin(2 pi u3))
+  template <class P>
+  static void uniformKernel(std::uint64_t seed, std::uint64_t index,
+                            P (&q)[4]) {
+    constexpr std::size_t width = P::width;
+    Scalar u[3][width];
+    for (std::size_t lane = 0; lane < width; ++lane) {
+      for (std::size_t k = 0; k < 3; ++k) {
+        u[k][lane] = random(seed, 3 * (index + lane) + k);
+      }
+    }
+
+    P u1 = P::load(u[0]);
+    P outer = sqrt(P(1.0) - u1);
+    P inner = sqrt(u1);
+    P sine[2];
+    P cosine[2];
+    for (std::size_t k = 0; k < 2; ++k) {
+      SimdMath::sincos(P(2.0 * M_PI) * P::load(u[k + 1]), sine[k], cosine[k]);
+    }
+    q[0] = inner * cosine[1];
+    q[1] = outer * sine[0];
+    q[2] = outer * cosine[0];
+    q[3] = inner * sine[1];
+  }
+
+  // Hopf coordinates, with theta and phi the direction and psi the angle
+  // about it: q = (cos(theta / 2) cos(psi / 2), cos(theta / 2) sin(psi / 2),
+  //                sin(theta / 2) cos(phi + psi / 2),
+  //                sin(theta / 2) sin(phi + psi / 2))
+  template <class P>
+  static void hopfGridKernel(int level, std::uint64_t index, P (&q)[4]) {
+    constexpr std::size_t width = P::width;
+    std::uint64_t nside = std::uint64_t(1) << level;
+    std::uint64_t numAngles = 6 * nside;
+    Scalar z[width];
+    Scalar phi[width];
+    Scalar halfPsi[width];
+    for (std::size_t lane = 0; lane < width; ++lane) {
+      std::uint64_t point = index + lane;
+      double cellZ;
+      double cellPhi;
+      healpixCenter(nside, point / numAngles, cellZ, cellPhi);
+      z[lane] = static_cast<Scalar>(cellZ);
+      phi[lane] = static_cast<Scalar>(cellPhi);
+      halfPsi[lane] = static_cast<Scalar>(
+          M_PI * (static_cast<double>(point % numAngles) + 0.5) /
+          static_cast<double>(numAngles));
+    }
+
+    P cosTheta = P::load(z);
+    P cosHalfTheta = sqrt(max(P(0.5) + P(0.5) * cosTheta, P(0.0)));
+    P sinHalfTheta = sqrt(max(P(0.5) - P(0.5) * cosTheta, P(0.0)));
+    P halfAngle = P::load(halfPsi);
+    P sinPsi;
+    P cosPsi;
+    SimdMath::sincos(halfAngle, sinPsi, cosPsi);
+    P sinPhi;
+    P cosPhi;
+    SimdMath::sincos(P::load(phi) + halfAngle, sinPhi, cosPhi);
+    q[0] = cosHalfTheta * cosPsi;
+    q[1] = cosHalfTheta * sinPsi;
+    q[2] = sinHalfTheta * cosPhi;
+    q[3] = sinHalfTheta * sinPhi;
+  }
+};
+
+using RotationSampler = BasicRotationSampler<double>;
+using RotationSamplerf = BasicRotationSampler<float>;
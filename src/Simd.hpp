@@ -0,0 +1,700 @@
+#pragma once
+
+// STL
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// Intrinsics
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// A Pack is a fixed number of scalars that live in one SIMD register. The batch
+// math is written once against this interface and then instantiated for the
+// widest register the target supports, with Width = 1 as the portable
+// fallback that is also used for the tail of every batch.
+template <class Scalar, std::size_t Width> class Pack;
+
+// Whether any lane of a comparison held, for loops that run until every lane
+// has converged. The Mask of the scalar pack is a plain bool.
+constexpr bool any(bool mask) { return mask; }
+
+// Every operation of the scalar pack is constexpr, so the kernels can also be
+// evaluated at compile time. The functions of <cmath> are not constexpr until
+// C++26, so constant evaluation uses plain arithmetic in their place.
+template <class S> class Pack<S, 1> {
+public:
+  using Scalar = S;
+  static constexpr std::size_t width = 1;
+  using Mask = bool;
+
+  Scalar v;
+
+  Pack() = default;
+  constexpr Pack(Scalar s) : v(s) {}
+
+  static constexpr Pack load(const Scalar *ptr) { return Pack(*ptr); }
+  constexpr void store(Scalar *ptr) const { *ptr = v; }
+
+  friend constexpr Pack operator+(Pack a, Pack b) { return a.v + b.v; }
+  friend constexpr Pack operator-(Pack a, Pack b) { return a.v - b.v; }
+  friend constexpr Pack operator*(Pack a, Pack b) { return a.v * b.v; }
+  friend constexpr Pack operator/(Pack a, Pack b) { return a.v / b.v; }
+  friend constexpr Pack operator-(Pack a) { return -a.v; }
+
+  friend constexpr Mask operator<(Pack a, Pack b) { return a.v < b.v; }
+  friend constexpr Mask operator>(Pack a, Pack b) { return a.v > b.v; }
+  friend constexpr Mask operator<=(Pack a, Pack b) { return a.v <= b.v; }
+  friend constexpr Mask operator>=(Pack a, Pack b) { return a.v >= b.v; }
+
+  friend constexpr Pack sqrt(Pack a) {
+    if (std::is_constant_evaluated()) {
+      return constantSqrt(a.v);
+    }
+    return std::sqrt(a.v);
+  }
+  friend constexpr Pack abs(Pack a) {
+    if (std::is_constant_evaluated()) {
+      return a.v < 0 ? -a.v : a.v;
+    }
+    return std::fabs(a.v);
+  }
+  friend constexpr Pack min(Pack a, Pack b) { return a.v < b.v ? a.v : b.v; }
+  friend constexpr Pack max(Pack a, Pack b) { return a.v > b.v ? a.v : b.v; }
+  friend constexpr Pack fma(Pack a, Pack b, Pack c) { return a.v * b.v + c.v; }
+  friend constexpr Pack copysign(Pack mag, Pack sign) {
+    if (std::is_constant_evaluated()) {
+      // -0 is taken as positive, which no kernel depends on
+      Scalar magnitude = mag.v < 0 ? -mag.v : mag.v;
+      return sign.v < 0 ? -magnitude : magnitude;
+    }
+    return std::copysign(mag.v, sign.v);
+  }
+  friend constexpr Pack select(Mask m, Pack a, Pack b) { return m ? a : b; }
+
+private:
+  // Newton's method from above decreases monotonically onto the root, so it
+  // stops once a step no longer makes progress
+  static constexpr Scalar constantSqrt(Scalar x) {
+    if (!(x > 0)) {
+      return x == 0 ? x : std::numeric_limits<Scalar>::quiet_NaN();
+    }
+    Scalar root = x > 1 ? x : Scalar(1);
+    while (true) {
+      Scalar next = (root + x / root) / 2;
+      if (!(next < root)) {
+        return root;
+      }
+      root = next;
+    }
+  }
+};
+
+#if defined(__SSE2__)
+template <> class Pack<double, 2> {
+public:
+  using Scalar = double;
+  static constexpr std::size_t width = 2;
+
+  // Lanes are all ones where the comparison held
+  struct Mask {
+    __m128d m;
+    friend Mask operator&(Mask a, Mask b) { return {_mm_and_pd(a.m, b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {_mm_or_pd(a.m, b.m)}; }
+    friend Mask operator!(Mask a) {
+      return {_mm_xor_pd(a.m, _mm_castsi128_pd(_mm_set1_epi64x(-1)))};
+    }
+    friend bool any(Mask a) { return _mm_movemask_pd(a.m) != 0; }
+  };
+
+  __m128d v;
+
+  Pack() = default;
+  Pack(double s) : v(_mm_set1_pd(s)) {}
+  Pack(__m128d r) : v(r) {}
+
+  static Pack load(const double *ptr) { return _mm_loadu_pd(ptr); }
+  void store(double *ptr) const { _mm_storeu_pd(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm_add_pd(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm_sub_pd(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm_mul_pd(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm_div_pd(a.v, b.v); }
+  friend Pack operator-(Pack a) { return _mm_xor_pd(a.v, signBit()); }
+
+  friend Mask operator<(Pack a, Pack b) { return {_mm_cmplt_pd(a.v, b.v)}; }
+  friend Mask operator>(Pack a, Pack b) { return {_mm_cmpgt_pd(a.v, b.v)}; }
+  friend Mask operator<=(Pack a, Pack b) { return {_mm_cmple_pd(a.v, b.v)}; }
+  friend Mask operator>=(Pack a, Pack b) { return {_mm_cmpge_pd(a.v, b.v)}; }
+
+  friend Pack sqrt(Pack a) { return _mm_sqrt_pd(a.v); }
+  friend Pack abs(Pack a) { return _mm_andnot_pd(signBit(), a.v); }
+  friend Pack min(Pack a, Pack b) { return _mm_min_pd(a.v, b.v); }
+  friend Pack max(Pack a, Pack b) { return _mm_max_pd(a.v, b.v); }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+    return _mm_add_pd(_mm_mul_pd(a.v, b.v), c.v);
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    return _mm_or_pd(_mm_andnot_pd(signBit(), mag.v),
+                     _mm_and_pd(signBit(), sign.v));
+  }
+  // SSE2 has no blend instruction, so the lanes are merged bitwise
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v));
+  }
+
+private:
+  static __m128d signBit() { return _mm_set1_pd(-0.0); }
+};
+
+template <> class Pack<float, 4> {
+public:
+  using Scalar = float;
+  static constexpr std::size_t width = 4;
+
+  // Lanes are all ones where the comparison held
+  struct Mask {
+    __m128 m;
+    friend Mask operator&(Mask a, Mask b) { return {_mm_and_ps(a.m, b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {_mm_or_ps(a.m, b.m)}; }
+    friend Mask operator!(Mask a) {
+      return {_mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1)))};
+    }
+    friend bool any(Mask a) { return _mm_movemask_ps(a.m) != 0; }
+  };
+
+  __m128 v;
+
+  Pack() = default;
+  Pack(float s) : v(_mm_set1_ps(s)) {}
+  Pack(__m128 r) : v(r) {}
+
+  static Pack load(const float *ptr) { return _mm_loadu_ps(ptr); }
+  void store(float *ptr) const { _mm_storeu_ps(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm_add_ps(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm_sub_ps(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm_mul_ps(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm_div_ps(a.v, b.v); }
+  friend Pack operator-(Pack a) { return _mm_xor_ps(a.v, signBit()); }
+
+  friend Mask operator<(Pack a, Pack b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+  friend Mask operator>(Pack a, Pack b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+  friend Mask operator<=(Pack a, Pack b) { return {_mm_cmple_ps(a.v, b.v)}; }
+  friend Mask operator>=(Pack a, Pack b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+
+  friend Pack sqrt(Pack a) { return _mm_sqrt_ps(a.v); }
+  friend Pack abs(Pack a) { return _mm_andnot_ps(signBit(), a.v); }
+  friend Pack min(Pack a, Pack b) { return _mm_min_ps(a.v, b.v); }
+  friend Pack max(Pack a, Pack b) { return _mm_max_ps(a.v, b.v); }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+    return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    return _mm_or_ps(_mm_andnot_ps(signBit(), mag.v),
+                     _mm_and_ps(signBit(), sign.v));
+  }
+  // SSE2 has no blend instruction, so the lanes are merged bitwise
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v));
+  }
+
+private:
+  static __m128 signBit() { return _mm_set1_ps(-0.0f); }
+};
+#endif
+
+#if defined(__AVX2__)
+template <> class Pack<double, 4> {
+public:
+  using Scalar = double;
+  static constexpr std::size_t width = 4;
+
+  // Lanes are all ones where the comparison held
+  struct Mask {
+    __m256d m;
+    friend Mask operator&(Mask a, Mask b) { return {_mm256_and_pd(a.m, b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {_mm256_or_pd(a.m, b.m)}; }
+    friend Mask operator!(Mask a) {
+      return {_mm256_xor_pd(a.m, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)))};
+    }
+    friend bool any(Mask a) { return _mm256_movemask_pd(a.m) != 0; }
+  };
+
+  __m256d v;
+
+  Pack() = default;
+  Pack(double s) : v(_mm256_set1_pd(s)) {}
+  Pack(__m256d r) : v(r) {}
+
+  static Pack load(const double *ptr) { return _mm256_loadu_pd(ptr); }
+  void store(double *ptr) const { _mm256_storeu_pd(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm256_add_pd(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm256_sub_pd(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm256_mul_pd(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm256_div_pd(a.v, b.v); }
+  friend Pack operator-(Pack a) { return _mm256_xor_pd(a.v, signBit()); }
+
+  friend Mask operator<(Pack a, Pack b) {
+    return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)};
+  }
+  friend Mask operator>(Pack a, Pack b) {
+    return {_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)};
+  }
+  friend Mask operator<=(Pack a, Pack b) {
+    return {_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)};
+  }
+  friend Mask operator>=(Pack a, Pack b) {
+    return {_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)};
+  }
+
+  friend Pack sqrt(Pack a) { return _mm256_sqrt_pd(a.v); }
+  friend Pack abs(Pack a) { return _mm256_andnot_pd(signBit(), a.v); }
+  friend Pack min(Pack a, Pack b) { return _mm256_min_pd(a.v, b.v); }
+  friend Pack max(Pack a, Pack b) { return _mm256_max_pd(a.v, b.v); }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+#if defined(__FMA__)
+    return _mm256_fmadd_pd(a.v, b.v, c.v);
+#else
+    return _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v);
+#endif
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    return _mm256_or_pd(_mm256_andnot_pd(signBit(), mag.v),
+                        _mm256_and_pd(signBit(), sign.v));
+  }
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm256_blendv_pd(b.v, a.v, m.m);
+  }
+
+private:
+  static __m256d signBit() { return _mm256_set1_pd(-0.0); }
+};
+
+template <> class Pack<float, 8> {
+public:
+  using Scalar = float;
+  static constexpr std::size_t width = 8;
+
+  // Lanes are all ones where the comparison held
+  struct Mask {
+    __m256 m;
+    friend Mask operator&(Mask a, Mask b) { return {_mm256_and_ps(a.m, b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {_mm256_or_ps(a.m, b.m)}; }
+    friend Mask operator!(Mask a) {
+      return {_mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))};
+    }
+    friend bool any(Mask a) { return _mm256_movemask_ps(a.m) != 0; }
+  };
+
+  __m256 v;
+
+  Pack() = default;
+  Pack(float s) : v(_mm256_set1_ps(s)) {}
+  Pack(__m256 r) : v(r) {}
+
+  static Pack load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+  void store(float *ptr) const { _mm256_storeu_ps(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm256_add_ps(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm256_sub_ps(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm256_mul_ps(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm256_div_ps(a.v, b.v); }
+  friend Pack operator-(Pack a) { return _mm256_xor_ps(a.v, signBit()); }
+
+  friend Mask operator<(Pack a, Pack b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)};
+  }
+  friend Mask operator>(Pack a, Pack b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+  }
+  friend Mask operator<=(Pack a, Pack b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)};
+  }
+  friend Mask operator>=(Pack a, Pack b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)};
+  }
+
+  friend Pack sqrt(Pack a) { return _mm256_sqrt_ps(a.v); }
+  friend Pack abs(Pack a) { return _mm256_andnot_ps(signBit(), a.v); }
+  friend Pack min(Pack a, Pack b) { return _mm256_min_ps(a.v, b.v); }
+  friend Pack max(Pack a, Pack b) { return _mm256_max_ps(a.v, b.v); }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a.v, b.v, c.v);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v);
+#endif
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    return _mm256_or_ps(_mm256_andnot_ps(signBit(), mag.v),
+                        _mm256_and_ps(signBit(), sign.v));
+  }
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm256_blendv_ps(b.v, a.v, m.m);
+  }
+
+private:
+  static __m256 signBit() { return _mm256_set1_ps(-0.0f); }
+};
+#endif
+
+#if defined(__AVX512F__)
+template <> class Pack<double, 8> {
+public:
+  using Scalar = double;
+  static constexpr std::size_t width = 8;
+
+  // One bit per lane
+  struct Mask {
+    __mmask8 m;
+    friend Mask operator&(Mask a, Mask b) { return {__mmask8(a.m & b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {__mmask8(a.m | b.m)}; }
+    friend Mask operator!(Mask a) { return {__mmask8(~a.m)}; }
+    friend bool any(Mask a) { return a.m != 0; }
+  };
+
+  __m512d v;
+
+  Pack() = default;
+  Pack(double s) : v(_mm512_set1_pd(s)) {}
+  Pack(__m512d r) : v(r) {}
+
+  static Pack load(const double *ptr) { return _mm512_loadu_pd(ptr); }
+  void store(double *ptr) const { _mm512_storeu_pd(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm512_add_pd(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm512_sub_pd(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm512_mul_pd(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm512_div_pd(a.v, b.v); }
+  friend Pack operator-(Pack a) {
+    return _mm512_castsi512_pd(_mm512_xor_si512(
+        _mm512_castpd_si512(a.v), _mm512_set1_epi64(INT64_MIN)));
+  }
+
+  friend Mask operator<(Pack a, Pack b) {
+    return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)};
+  }
+  friend Mask operator>(Pack a, Pack b) {
+    return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ)};
+  }
+  friend Mask operator<=(Pack a, Pack b) {
+    return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ)};
+  }
+  friend Mask operator>=(Pack a, Pack b) {
+    return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ)};
+  }
+
+  // The zero masked forms sidestep a spurious -Wmaybe-uninitialized that GCC 12
+  // raises for the unmasked ones
+  friend Pack sqrt(Pack a) { return _mm512_maskz_sqrt_pd(ALL_LANES, a.v); }
+  friend Pack abs(Pack a) { return _mm512_abs_pd(a.v); }
+  friend Pack min(Pack a, Pack b) {
+    return _mm512_maskz_min_pd(ALL_LANES, a.v, b.v);
+  }
+  friend Pack max(Pack a, Pack b) {
+    return _mm512_maskz_max_pd(ALL_LANES, a.v, b.v);
+  }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+    return _mm512_fmadd_pd(a.v, b.v, c.v);
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    __m512i signBit = _mm512_set1_epi64(INT64_MIN);
+    return _mm512_castsi512_pd(_mm512_ternarylogic_epi64(
+        signBit, _mm512_castpd_si512(mag.v), _mm512_castpd_si512(sign.v),
+        0xAC));
+  }
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm512_mask_blend_pd(m.m, b.v, a.v);
+  }
+
+private:
+  static constexpr __mmask8 ALL_LANES = 0xFF;
+};
+
+template <> class Pack<float, 16> {
+public:
+  using Scalar = float;
+  static constexpr std::size_t width = 16;
+
+  // One bit per lane
+  struct Mask {
+    __mmask16 m;
+    friend Mask operator&(Mask a, Mask b) { return {__mmask16(a.m & b.m)}; }
+    friend Mask operator|(Mask a, Mask b) { return {__mmask16(a.m | b.m)}; }
+    friend Mask operator!(Mask a) { return {__mmask16(~a.m)}; }
+    friend bool any(Mask a) { return a.m != 0; }
+  };
+
+  __m512 v;
+
+  Pack() = default;
+  Pack(float s) : v(_mm512_set1_ps(s)) {}
+  Pack(__m512 r) : v(r) {}
+
+  static Pack load(const float *ptr) { return _mm512_loadu_ps(ptr); }
+  void store(float *ptr) const { _mm512_storeu_ps(ptr, v); }
+
+  friend Pack operator+(Pack a, Pack b) { return _mm512_add_ps(a.v, b.v); }
+  friend Pack operator-(Pack a, Pack b) { return _mm512_sub_ps(a.v, b.v); }
+  friend Pack operator*(Pack a, Pack b) { return _mm512_mul_ps(a.v, b.v); }
+  friend Pack operator/(Pack a, Pack b) { return _mm512_div_ps(a.v, b.v); }
+  friend Pack operator-(Pack a) {
+    return _mm512_castsi512_ps(_mm512_xor_si512(
+        _mm512_castps_si512(a.v), _mm512_set1_epi32(INT32_MIN)));
+  }
+
+  friend Mask operator<(Pack a, Pack b) {
+    return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)};
+  }
+  friend Mask operator>(Pack a, Pack b) {
+    return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)};
+  }
+  friend Mask operator<=(Pack a, Pack b) {
+    return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)};
+  }
+  friend Mask operator>=(Pack a, Pack b) {
+    return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)};
+  }
+
+  // See Pack<double, 8> for why the zero masked forms are used
+  friend Pack sqrt(Pack a) { return _mm512_maskz_sqrt_ps(ALL_LANES, a.v); }
+  friend Pack abs(Pack a) { return _mm512_abs_ps(a.v); }
+  friend Pack min(Pack a, Pack b) {
+    return _mm512_maskz_min_ps(ALL_LANES, a.v, b.v);
+  }
+  friend Pack max(Pack a, Pack b) {
+    return _mm512_maskz_max_ps(ALL_LANES, a.v, b.v);
+  }
+  friend Pack fma(Pack a, Pack b, Pack c) {
+    return _mm512_fmadd_ps(a.v, b.v, c.v);
+  }
+  friend Pack copysign(Pack mag, Pack sign) {
+    __m512i signBit = _mm512_set1_epi32(INT32_MIN);
+    return _mm512_castsi512_ps(_mm512_ternarylogic_epi32(
+        signBit, _mm512_castps_si512(mag.v), _mm512_castps_si512(sign.v),
+        0xAC));
+  }
+  friend Pack select(Mask m, Pack a, Pack b) {
+    return _mm512_mask_blend_ps(m.m, b.v, a.v);
+  }
+
+private:
+  static constexpr __mmask16 ALL_LANES = 0xFFFF;
+};
+#endif
+
+// The widest pack the compiler has been allowed to emit for this target
+#if defined(__AVX512F__)
+template <class Scalar>
+using NativePack = Pack<Scalar, 64 / sizeof(Scalar)>;
+#elif defined(__AVX2__)
+template <class Scalar>
+using NativePack = Pack<Scalar, 32 / sizeof(Scalar)>;
+#elif defined(__SSE2__)
+template <class Scalar>
+using NativePack = Pack<Scalar, 16 / sizeof(Scalar)>;
+#else
+template <class Scalar> using NativePack = Pack<Scalar, 1>;
+#endif
+
+// How closely the elementary functions have to follow the true result. Exact
+// is within a couple of ulps, High within 1e-7 and Low within 1e-4 absolute,
+// which is plenty for anything that only ends up on screen. Single precision
+// can not resolve 1e-7 near pi, so there High is limited by float rounding.
+enum class Accuracy { Exact, High, Low };
+
+// Elementary functions built out of the Pack primitives so that they vectorize
+// without relying on a vector libm. Single precision packs use shorter
+// polynomials that are accurate to float rounding.
+class SimdMath {
+private:
+  // Cephes atan rational approximation on [0, 0.66]
+  static constexpr double ATAN_P[] = {
+      -8.750608600031904122785E-1, -1.615753718733365076637E1,
+      -7.500855792314704667340E1, -1.228866684490136173410E2,
+      -6.485021904942025371773E1};
+  static constexpr double ATAN_Q[] = {
+      2.485846490142306297962E1, 1.650270098316988542046E2,
+      4.328810604912902668951E2, 4.853903996359136964868E2,
+      1.945506571482613964425E2};
+
+  // Cephes atanf polynomial on [0, tan(pi / 8)]
+  static constexpr float ATAN_PF[] = {8.05374449538e-2f, -1.38776856032E-1f,
+                                      1.99777106478E-1f, -3.33329491539E-1f};
+
+  // Minimax polynomials of atan(x) / x in x^2 over all of [0, 1], so they need
+  // neither the shift by pi / 4 nor a division. The max absolute error of
+  // atan is 3.8e-8 for ATAN_HIGH and 1.2e-5 for ATAN_LOW.
+  static constexpr double ATAN_HIGH[] = {
+      -4.05456711990572861e-03, 2.18629577332634164e-02,
+      -5.59123269496348618e-02, 9.64219738070944335e-02,
+      -1.39086295931252785e-01, 1.99465656669523863e-01,
+      -3.33298607867719616e-01, 9.99999335579529396e-01};
+  static constexpr double ATAN_LOW[] = {
+      2.08451133806170862e-02, -8.51563498651853714e-02,
+      1.80159294820768998e-01, -3.30304785975333413e-01,
+      9.99866329566126515e-01};
+
+  // Low order bits of pi / 4 that are lost when it is rounded to a double
+  static constexpr double PI_4_LOW = 3.061616997868382943065E-17;
+
+  template <class P>
+  static constexpr bool isFloat = std::is_same_v<typename P::Scalar, float>;
+
+  template <class P, std::size_t N>
+  static constexpr P polynomial(const double (&coefficients)[N], P x) {
+    P result = P(coefficients[0]);
+    for (std::size_t i = 1; i < N; ++i) {
+      result = fma(result, x, P(coefficients[i]));
+    }
+    return result;
+  }
+
+  // atan(x) for x in [0, 1]
+  template <Accuracy accuracy, class P> static constexpr P atanUnit(P x) {
+    if constexpr (accuracy == Accuracy::High) {
+      return x * polynomial(ATAN_HIGH, x * x);
+    } else if constexpr (accuracy == Accuracy::Low) {
+      return x * polynomial(ATAN_LOW, x * x);
+    } else {
+      return atanUnitExact(x);
+    }
+  }
+
+  template <class P> static constexpr P atanUnitExact(P x) {
+    // Larger arguments are shifted by pi / 4 to stay in the range where the
+    // approximation is accurate
+    typename P::Mask shifted = x > P(isFloat<P> ? 0.4142135623730950 : 0.66);
+    P reduced = select(shifted, (x - P(1.0)) / (x + P(1.0)), x);
+    P z = reduced * reduced;
+
+    if constexpr (isFloat<P>) {
+      P poly = P(ATAN_PF[0]);
+      for (int i = 1; i < 4; ++i) {
+        poly = fma(poly, z, P(ATAN_PF[i]));
+      }
+      P result = fma(reduced * z, poly, reduced);
+      return result + select(shifted, P(M_PI_4), P(0.0));
+    } else {
+      P num = P(ATAN_P[0]);
+      for (int i = 1; i < 5; ++i) {
+        num = fma(num, z, P(ATAN_P[i]));
+      }
+      P den = z + P(ATAN_Q[0]);
+      for (int i = 1; i < 5; ++i) {
+        den = fma(den, z, P(ATAN_Q[i]));
+      }
+      P result = fma(reduced, z * num / den, reduced);
+      return result + select(shifted, P(M_PI_4) + P(PI_4_LOW), P(0.0));
+    }
+  }
+
+  // Cephes sin and cos polynomials on [-pi / 4, pi / 4]
+  static constexpr double SIN_P[] = {
+      1.58962301576546568060E-10, -2.50507477628578072866E-8,
+      2.75573136213857245213E-6,  -1.98412698295895385996E-4,
+      8.33333333332211858878E-3,  -1.66666666666666307295E-1};
+  static constexpr double COS_P[] = {
+      -1.13585365213876817300E-11, 2.08757008419747316778E-9,
+      -2.75573141792967388112E-7,  2.48015872888517045348E-5,
+      -1.38888888888730564116E-3,  4.16666666666665929218E-2};
+  static constexpr float SIN_PF[] = {-1.9515295891E-4f, 8.3321608736E-3f,
+                                     -1.6666654611E-1f};
+  static constexpr float COS_PF[] = {2.443315711809948E-5f,
+                                     -1.388731625493765E-3f,
+                                     4.166664568298827E-2f};
+
+  // pi / 2 split in three so that k * pi / 2 is exact for moderate k
+  static constexpr double PI_2_HIGH = 1.57079625129699707031E0;
+  static constexpr double PI_2_MID = 7.54978941586159635335E-8;
+  static constexpr double PI_2_LOW = 5.39030285815811905290E-15;
+  static constexpr float PI_2_HIGHF = 1.5703125f;
+  static constexpr float PI_2_MIDF = 4.837512969970703125E-4f;
+  static constexpr float PI_2_LOWF = 7.54978995489188216E-8f;
+
+  // Adding and subtracting 1.5 * 2^52 (1.5 * 2^23 for float) rounds to the
+  // nearest integer
+  static constexpr double ROUNDING = 6755399441055744.0;
+  static constexpr float ROUNDINGF = 12582912.0f;
+
+  template <class P> static constexpr P round(P x) {
+    P rounding = P(isFloat<P> ? ROUNDINGF : ROUNDING);
+    return (x + rounding) - rounding;
+  }
+
+public:
+  // Four quadrant arctangent, accurate to a couple of ulps unless a lower
+  // accuracy is asked for
+  template <Accuracy accuracy = Accuracy::Exact, class P>
+  static constexpr P atan2(P y, P x) {
+    P ax = abs(x);
+    P ay = abs(y);
+    P big = max(ax, ay);
+    P small = min(ax, ay);
+
+    // Guarded so that atan2(0, 0) = 0 instead of nan
+    P ratio = select(big > P(0.0), small / big, P(0.0));
+    P angle = atanUnit<accuracy>(ratio);
+    angle = select(ay > ax, P(M_PI_2) - angle, angle);
+    angle = select(x < P(0.0), P(M_PI) - angle, angle);
+    return copysign(angle, y);
+  }
+
+  // Sine and cosine together, accurate to a couple of ulps for |x| < 2^20
+  // (2^13 for float)
+  template <class P>
+  static constexpr void sincos(P x, P &sine, P &cosine) {
+    // Reduce to r in [-pi / 4, pi / 4] with x = r + k * pi / 2
+    P k = round(x * P(M_2_PI));
+    P r;
+    if constexpr (isFloat<P>) {
+      r = x - k * P(PI_2_HIGHF);
+      r = r - k * P(PI_2_MIDF);
+      r = r - k * P(PI_2_LOWF);
+    } else {
+      r = x - k * P(PI_2_HIGH);
+      r = r - k * P(PI_2_MID);
+      r = r - k * P(PI_2_LOW);
+    }
+
+    P z = r * r;
+    P s;
+    P c;
+    if constexpr (isFloat<P>) {
+      P sinPoly = P(SIN_PF[0]);
+      P cosPoly = P(COS_PF[0]);
+      for (int i = 1; i < 3; ++i) {
+        sinPoly = fma(sinPoly, z, P(SIN_PF[i]));
+        cosPoly = fma(cosPoly, z, P(COS_PF[i]));
+      }
+      s = fma(r * z, sinPoly, r);
+      c = fma(z * z, cosPoly, P(1.0) - P(0.5) * z);
+    } else {
+      P sinPoly = P(SIN_P[0]);
+      P cosPoly = P(COS_P[0]);
+      for (int i = 1; i < 6; ++i) {
+        sinPoly = fma(sinPoly, z, P(SIN_P[i]));
+        cosPoly = fma(cosPoly, z, P(COS_P[i]));
+      }
+      s = fma(r * z, sinPoly, r);
+      c = fma(z * z, cosPoly, P(1.0) - P(0.5) * z);
+    }
+
+    // Quadrant k mod 4, folded into {-2, -1, 0, 1, 2}
+    P quadrant = k - P(4.0) * round(k * P(0.25));
+    P absQuadrant = abs(quadrant);
+    typename P::Mask swap = (absQuadrant > P(0.5)) & (absQuadrant < P(1.5));
+    typename P::Mask negateSin = (quadrant > P(1.5)) | (quadrant < P(-0.5));
+    typename P::Mask negateCos = (quadrant > P(0.5)) | (quadrant < P(-1.5));
+
+    sine = select(swap, c, s);
+    sine = select(negateSin, -sine, sine);
+    cosine = select(swap, s, c);
+    cosine = select(negateCos, -cosine, cosine);
+  }
+};
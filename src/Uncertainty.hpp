@@ -0,0 +1,305 @@
+#pragma once
+#include "LieAlgebra.hpp"
+#include "LieAlgebraKernels.hpp"
+#include <Eigen/Core>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+// Rotations with a Gaussian tangent uncertainty, R = mean exp(e) with
+// e ~ N(0, covariance) in the body frame of the mean, the frame the covariance
+// of RotationAveraging is in. Propagation is to first order: the mean goes
+// through the operation and the covariance through its Jacobians, where the
+// adjoint of SO3 is the rotation matrix itself. The kernels are a few dozen
+// multiplies each, so a filter can afford them on every sample of a fast
+// stream, and the batch forms cover whole logs at once.
+template <class Scalar> class BasicRotationUncertainty {
+private:
+  using SO3 = BasicLieAlgebra<Scalar>;
+  using Kernels = LieAlgebraKernels<Scalar>;
+  using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+  using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+
+public:
+  template <class T> using SO3Arrays = typename SO3::template SO3Arrays<T>;
+  template <class T>
+  using Matrix3Arrays = typename SO3::template Matrix3Arrays<T>;
+  template <class T>
+  using TangentArrays = typename SO3::template TangentArrays<T>;
+
+  struct Gaussian {
+    Matrix3 mean;
+    Matrix3 covariance;
+  };
+
+  // The mean and the rotations one spread along each principal square root
+  // of the covariance to either side
+  static constexpr std::size_t NUM_SIGMA_POINTS = 7;
+
+  // lhs rhs for independent lhs and rhs. Moving exp(e_lhs) past the mean of
+  // rhs turns it by the adjoint rhs^T, so the covariance is
+  // rhs^T lhs rhs + rhs.
+  static Gaussian compose(const Gaussian &lhs, const Gaussian &rhs) {
+    Pack<Scalar, 1> a[9];
+    Pack<Scalar, 1> A[9];
+    Pack<Scalar, 1> b[9];
+    Pack<Scalar, 1> B[9];
+    Pack<Scalar, 1> R[9];
+    Pack<Scalar, 1> C[9];
+    fromMatrix(lhs.mean, a);
+    fromMatrix(lhs.covariance, A);
+    fromMatrix(rhs.mean, b);
+    fromMatrix(rhs.covariance, B);
+    composeKernel(a, A, b, B, R, C);
+    return {toMatrix(R), toMatrix(C)};
+  }
+
+  static void compose(const SO3Arrays<const Scalar> &lhs,
+                      const Matrix3Arrays<const Scalar> &lhsCovariance,
+                      const SO3Arrays<const Scalar> &rhs,
+                      const Matrix3Arrays<const Scalar> &rhsCovariance,
+                      const SO3Arrays<Scalar> &mean,
+                      const Matrix3Arrays<Scalar> &covariance,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 54, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[9];
+      P A[9];
+      P b[9];
+      P B[9];
+      P R[9];
+      P C[9];
+      Kernels::load(lhs.entries, index, a);
+      Kernels::load(lhsCovariance.entries, index, A);
+      Kernels::load(rhs.entries, index, b);
+      Kernels::load(rhsCovariance.entries, index, B);
+      composeKernel(a, A, b, B, R, C);
+      Kernels::store(R, index, mean.entries);
+      Kernels::store(C, index, covariance.entries);
+    });
+  }
+
+  // R^T = exp(-e) mean^T = mean^T exp(-mean e), so the covariance is turned
+  // into the world frame
+  static Gaussian inverse(const Gaussian &rotation) {
+    Pack<Scalar, 1> a[9];
+    Pack<Scalar, 1> A[9];
+    Pack<Scalar, 1> R[9];
+    Pack<Scalar, 1> C[9];
+    fromMatrix(rotation.mean, a);
+    fromMatrix(rotation.covariance, A);
+    inverseKernel(a, A, R, C);
+    return {toMatrix(R), toMatrix(C)};
+  }
+
+  static void inverse(const SO3Arrays<const Scalar> &SO3Set,
+                      const Matrix3Arrays<const Scalar> &covarianceSet,
+                      const SO3Arrays<Scalar> &mean,
+                      const Matrix3Arrays<Scalar> &covariance,
+                      std::size_t count) {
+    Kernels::parallelForEachPack(count, 36, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[9];
+      P A[9];
+      P R[9];
+      P C[9];
+      Kernels::load(SO3Set.entries, index, a);
+      Kernels::load(covarianceSet.entries, index, A);
+      inverseKernel(a, A, R, C);
+      Kernels::store(R, index, mean.entries);
+      Kernels::store(C, index, covariance.entries);
+    });
+  }
+
+  // rotation exp(so3 + d) with d ~ N(0, tangentCovariance), one step of a
+  // gyro integration. exp(so3 + d) = exp(so3) exp(Jr(so3) d), so the
+  // covariance is exp(so3)^T covariance exp(so3) + Jr Q Jr^T.
+  static Gaussian plus(const Gaussian &rotation, const Vector3 &so3,
+                       const Matrix3 &tangentCovariance) {
+    Pack<Scalar, 1> a[9];
+    Pack<Scalar, 1> A[9];
+    Pack<Scalar, 1> Q[9];
+    Pack<Scalar, 1> R[9];
+    Pack<Scalar, 1> C[9];
+    Pack<Scalar, 1> w[3] = {so3.x(), so3.y(), so3.z()};
+    fromMatrix(rotation.mean, a);
+    fromMatrix(rotation.covariance, A);
+    fromMatrix(tangentCovariance, Q);
+    plusKernel(a, A, w, Q, R, C);
+    return {toMatrix(R), toMatrix(C)};
+  }
+
+  static void plus(const SO3Arrays<const Scalar> &SO3Set,
+                   const Matrix3Arrays<const Scalar> &covarianceSet,
+                   const TangentArrays<const Scalar> &so3,
+                   const Matrix3Arrays<const Scalar> &tangentCovariance,
+                   const SO3Arrays<Scalar> &mean,
+                   const Matrix3Arrays<Scalar> &covariance,
+                   std::size_t count) {
+    Kernels::parallelForEachPack(count, 48, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[9];
+      P A[9];
+      P w[3];
+      P Q[9];
+      P R[9];
+      P C[9];
+      Kernels::load(SO3Set.entries, index, a);
+      Kernels::load(covarianceSet.entries, index, A);
+      Kernels::load(so3.components, index, w);
+      Kernels::load(tangentCovariance.entries, index, Q);
+      plusKernel(a, A, w, Q, R, C);
+      Kernels::store(R, index, mean.entries);
+      Kernels::store(C, index, covariance.entries);
+    });
+  }
+
+  // The mean followed by mean exp(+spread L e_k) and mean exp(-spread L e_k)
+  // for each column k of the Cholesky factor L of the covariance. The default
+  // spread is the unscented transform's sqrt(3) with the mean weighted 0.
+  static std::array<Matrix3, NUM_SIGMA_POINTS>
+  sigmaPoints(const Gaussian &rotation, Scalar spread = std::sqrt(Scalar(3))) {
+    Pack<Scalar, 1> a[9];
+    Pack<Scalar, 1> A[9];
+    Pack<Scalar, 1> points[NUM_SIGMA_POINTS][9];
+    fromMatrix(rotation.mean, a);
+    fromMatrix(rotation.covariance, A);
+    sigmaPointsKernel(a, A, Pack<Scalar, 1>(spread), points);
+
+    std::array<Matrix3, NUM_SIGMA_POINTS> matrices;
+    for (std::size_t i = 0; i < NUM_SIGMA_POINTS; ++i) {
+      matrices[i] = toMatrix(points[i]);
+    }
+    return matrices;
+  }
+
+  static void
+  sigmaPoints(const SO3Arrays<const Scalar> &SO3Set,
+              const Matrix3Arrays<const Scalar> &covarianceSet,
+              const std::array<SO3Arrays<Scalar>, NUM_SIGMA_POINTS> &points,
+              std::size_t count, Scalar spread = std::sqrt(Scalar(3))) {
+    Kernels::parallelForEachPack(count, 81, [&](auto tag, std::size_t index) {
+      using P = typename decltype(tag)::type;
+      P a[9];
+      P A[9];
+      P R[NUM_SIGMA_POINTS][9];
+      Kernels::load(SO3Set.entries, index, a);
+      Kernels::load(covarianceSet.entries, index, A);
+      sigmaPointsKernel(a, A, P(spread), R);
+      for (std::size_t i = 0; i < NUM_SIGMA_POINTS; ++i) {
+        Kernels::store(R[i], index, points[i].entries);
+      }
+    });
+  }
+
+private:
+  static void fromMatrix(const Matrix3 &matrix, Pack<Scalar, 1> (&M)[9]) {
+    for (std::size_t k = 0; k < 9; ++k) {
+      M[k] = matrix.coeff(k / 3, k % 3);
+    }
+  }
+
+  static Matrix3 toMatrix(const Pack<Scalar, 1> (&M)[9]) {
+    Matrix3 matrix;
+    for (std::size_t k = 0; k < 9; ++k) {
+      matrix(k / 3, k % 3) = M[k].v;
+    }
+    return matrix;
+  }
+
+  template <class P> static void transpose(const P (&A)[9], P (&T)[9]) {
+    for (std::size_t k = 0; k < 9; ++k) {
+      T[k] = A[3 * (k % 3) + k / 3];
+    }
+  }
+
+  // Row major A S A^T
+  template <class P>
+  static void congruenceKernel(const P (&A)[9], const P (&S)[9], P (&C)[9]) {
+    P AS[9];
+    P At[9];
+    Kernels::multiplyKernel(A, S, AS);
+    transpose(A, At);
+    Kernels::multiplyKernel(AS, At, C);
+  }
+
+  template <class P>
+  static void composeKernel(const P (&a)[9], const P (&A)[9], const P (&b)[9],
+                            const P (&B)[9], P (&R)[9], P (&C)[9]) {
+    P bt[9];
+    Kernels::multiplyKernel(a, b, R);
+    transpose(b, bt);
+    congruenceKernel(bt, A, C);
+    for (std::size_t k = 0; k < 9; ++k) {
+      C[k] = C[k] + B[k];
+    }
+  }
+
+  template <class P>
+  static void inverseKernel(const P (&a)[9], const P (&A)[9], P (&R)[9],
+                            P (&C)[9]) {
+    transpose(a, R);
+    congruenceKernel(a, A, C);
+  }
+
+  template <class P>
+  static void plusKernel(const P (&a)[9], const P (&A)[9], const P (&w)[3],
+                         const P (&Q)[9], P (&R)[9], P (&C)[9]) {
+    P E[9];
+    P Et[9];
+    P J[9];
+    P JQJt[9];
+    Kernels::exponentialMapKernel(w, E);
+    Kernels::multiplyKernel(a, E, R);
+    transpose(E, Et);
+    congruenceKernel(Et, A, C);
+    Kernels::rightJacobianKernel(w, J);
+    congruenceKernel(J, Q, JQJt);
+    for (std::size_t k = 0; k < 9; ++k) {
+      C[k] = C[k] + JQJt[k];
+    }
+  }
+
+  // Row major lower triangular L with L L^T = S. A direction without variance
+  // gets a zero column instead of a division by zero, so semidefinite
+  // covariances such as a yaw only uncertainty are fine.
+  template <class P> static void choleskyKernel(const P (&S)[9], P (&L)[9]) {
+    auto inverseOf = [](P d) {
+      return select(d > P(Kernels::tolerance),
+                    P(1.0) / max(d, P(Kernels::tolerance)), P(0.0));
+    };
+    L[0] = sqrt(max(S[0], P(0.0)));
+    P inverse0 = inverseOf(L[0]);
+    L[3] = S[3] * inverse0;
+    L[6] = S[6] * inverse0;
+    L[4] = sqrt(max(S[4] - L[3] * L[3], P(0.0)));
+    L[7] = (S[7] - L[6] * L[3]) * inverseOf(L[4]);
+    L[8] = sqrt(max(S[8] - L[6] * L[6] - L[7] * L[7], P(0.0)));
+    L[1] = L[2] = L[5] = P(0.0);
+  }
+
+  template <class P>
+  static void sigmaPointsKernel(const P (&a)[9], const P (&A)[9], P spread,
+                                P (&R)[NUM_SIGMA_POINTS][9]) {
+    P L[9];
+    choleskyKernel(A, L);
+    for (std::size_t k = 0; k < 9; ++k) {
+      R[0][k] = a[k];
+    }
+    for (std::size_t col = 0; col < 3; ++col) {
+      for (std::size_t side = 0; side < 2; ++side) {
+        P sign = P(side == 0 ? 1.0 : -1.0);
+        P w[3];
+        for (std::size_t row = 0; row < 3; ++row) {
+          w[row] = sign * spread * L[3 * row + col];
+        }
+        P E[9];
+        Kernels::exponentialMapKernel(w, E);
+        Kernels::multiplyKernel(a, E, R[1 + 2 * col + side]);
+      }
+    }
+  }
+};
+
+using RotationUncertainty = BasicRotationUncertainty<double>;
+using RotationUncertaintyf = BasicRotationUncertainty<float>;
@@ -2,7 +2,7 @@
 #include <iostream>
 
 // Gets the sign of a number
-inline int getSign(double num) {
+constexpr int getSign(double num) {
   if (num < 0)
     return -1;
   return 1;
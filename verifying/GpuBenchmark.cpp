@@ -0,0 +1,263 @@
+#define WEBGPU_CPP_IMPLEMENTATION
+#include <webgpu/webgpu.hpp>
+
+#include "GpuLieAlgebra.hpp"
+#include "LieAlgebra.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Batch size at which the compute shaders overtake the SIMD kernels of
+// LieAlgebraf on the CPU, for each of log, exp and compose. The GPU time covers
+// the upload, the dispatch and the read back, what a caller pays that needs
+// the result back on the CPU. With --software the fallback adapter is used,
+// such as a software Vulkan driver, so the shaders can be checked on machines
+// without a GPU. Exits with 1 when the GPU disagrees with the CPU or a read
+// back fails.
+
+namespace {
+
+constexpr std::size_t MIN_COUNT = 1 << 8;
+constexpr std::size_t MAX_COUNT = 1 << 20;
+constexpr int NUM_REPEATS = 10;
+
+// Both run the same single precision formulas, this only catches real bugs
+constexpr float TOLERANCE = 1e-3f;
+
+template <class Function> double secondsPerRun(Function &&function) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_REPEATS; ++i) {
+    function();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count() / NUM_REPEATS;
+}
+
+wgpu::ShaderModule loadShaderModule(const std::string &path,
+                                    wgpu::Device device) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Shader File did not open");
+  }
+  std::stringstream source;
+  source << file.rdbuf();
+  std::string code = source.str();
+
+  wgpu::ShaderModuleWGSLDescriptor shaderModuleDesc;
+  shaderModuleDesc.chain.next = nullptr;
+  shaderModuleDesc.chain.sType = wgpu::SType::ShaderModuleWGSLDescriptor;
+  shaderModuleDesc.code = code.c_str();
+  wgpu::ShaderModuleDescriptor shaderDesc;
+  shaderDesc.nextInChain = &shaderModuleDesc.chain;
+  return device.createShaderModule(shaderDesc);
+}
+
+// N planes of count floats
+template <std::size_t N> struct Planes {
+  std::array<std::vector<float>, N> values;
+
+  explicit Planes(std::size_t count) {
+    for (std::vector<float> &plane : values) {
+      plane.resize(count);
+    }
+  }
+
+  float maxDifference(const Planes &other) const {
+    float difference = 0;
+    for (std::size_t k = 0; k < N; ++k) {
+      for (std::size_t i = 0; i < values[k].size(); ++i) {
+        difference =
+            std::max(difference, std::abs(values[k][i] - other.values[k][i]));
+      }
+    }
+    return difference;
+  }
+};
+
+template <class T> LieAlgebraf::SO3Arrays<T> so3View(Planes<9> &planes) {
+  LieAlgebraf::SO3Arrays<T> arrays;
+  for (std::size_t k = 0; k < 9; ++k) {
+    arrays.entries[k] = planes.values[k].data();
+  }
+  return arrays;
+}
+
+template <class T>
+LieAlgebraf::TangentArrays<T> tangentView(Planes<3> &planes) {
+  LieAlgebraf::TangentArrays<T> arrays;
+  for (std::size_t k = 0; k < 3; ++k) {
+    arrays.components[k] = planes.values[k].data();
+  }
+  return arrays;
+}
+
+template <class T>
+LieAlgebraf::QuaternionArrays<T> quaternionView(Planes<4> &planes) {
+  LieAlgebraf::QuaternionArrays<T> arrays;
+  for (std::size_t k = 0; k < 4; ++k) {
+    arrays.components[k] = planes.values[k].data();
+  }
+  return arrays;
+}
+
+struct Result {
+  double cpuSeconds;
+  double gpuSeconds;
+  float difference;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool isSoftware = argc > 1 && std::strcmp(argv[1], "--software") == 0;
+
+  wgpu::Instance instance = wgpu::createInstance(wgpu::InstanceDescriptor{});
+  wgpu::RequestAdapterOptions adapterOpts{};
+  adapterOpts.forceFallbackAdapter = isSoftware;
+  wgpu::Adapter adapter = instance.requestAdapter(adapterOpts);
+  if (!adapter) {
+    std::printf("No %s adapter\n", isSoftware ? "fallback" : "WebGPU");
+    return 1;
+  }
+  wgpu::DeviceDescriptor deviceDesc;
+  deviceDesc.label = "Benchmark Device";
+  wgpu::Device device = adapter.requestDevice(deviceDesc);
+
+  wgpu::ShaderModule module =
+      loadShaderModule(RESOURCE_DIR "/lie_algebra.wgsl", device);
+  bool isAccurate = true;
+  bool isRead = true;
+  {
+    GpuLieAlgebra gpu(device, module);
+    std::size_t maxCount = std::min(MAX_COUNT, gpu.maxCount());
+
+    // Rotations of every angle up to pi, so both sides of the log take the
+    // branch near pi as well, and random unit quaternions
+    std::mt19937 generator(42);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> angle(0.0f,
+                                                static_cast<float>(M_PI));
+    Planes<3> tangents(maxCount);
+    Planes<4> lhs(maxCount);
+    Planes<4> rhs(maxCount);
+    for (std::size_t i = 0; i < maxCount; ++i) {
+      Eigen::Vector3f axis(normal(generator), normal(generator),
+                           normal(generator));
+      Eigen::Vector3f w = angle(generator) * axis.normalized();
+      Eigen::Vector4f a(normal(generator), normal(generator),
+                        normal(generator), normal(generator));
+      Eigen::Vector4f b(normal(generator), normal(generator),
+                        normal(generator), normal(generator));
+      a.normalize();
+      b.normalize();
+      for (std::size_t k = 0; k < 4; ++k) {
+        if (k < 3) {
+          tangents.values[k][i] = w(k);
+        }
+        lhs.values[k][i] = a(k);
+        rhs.values[k][i] = b(k);
+      }
+    }
+    Planes<9> matrices(maxCount);
+    LieAlgebraf::exponentialMap(tangentView<const float>(tangents),
+                                so3View<float>(matrices), maxCount);
+
+    std::printf("%s adapter, %zu threads on the CPU\n",
+                isSoftware ? "Fallback" : "Default",
+                ParallelDispatch::numThreads());
+    const char *names[3] = {"log", "exp", "compose"};
+    std::array<std::size_t, 3> crossover = {0, 0, 0};
+    for (std::size_t count = MIN_COUNT; count <= maxCount; count *= 4) {
+      Planes<3> cpuTangents(count);
+      Planes<3> gpuTangents(count);
+      Planes<9> cpuMatrices(count);
+      Planes<9> gpuMatrices(count);
+      Planes<4> cpuQuaternions(count);
+      Planes<4> gpuQuaternions(count);
+      auto readBack = [&](const auto &arrays) {
+        gpu.readBack(arrays, [&](bool isDone) { isRead &= isDone; });
+        gpu.wait();
+      };
+
+      std::array<Result, 3> results;
+      results[0].cpuSeconds = secondsPerRun([&] {
+        LieAlgebraf::logarithmicMap(so3View<const float>(matrices),
+                                    tangentView<float>(cpuTangents), count);
+      });
+      results[0].gpuSeconds = secondsPerRun([&] {
+        gpu.logarithmicMap(so3View<const float>(matrices), count);
+        readBack(tangentView<float>(gpuTangents));
+      });
+      results[0].difference = cpuTangents.maxDifference(gpuTangents);
+
+      results[1].cpuSeconds = secondsPerRun([&] {
+        LieAlgebraf::exponentialMap(tangentView<const float>(tangents),
+                                    so3View<float>(cpuMatrices), count);
+      });
+      results[1].gpuSeconds = secondsPerRun([&] {
+        gpu.exponentialMap(tangentView<const float>(tangents), count);
+        readBack(so3View<float>(gpuMatrices));
+      });
+      results[1].difference = cpuMatrices.maxDifference(gpuMatrices);
+
+      results[2].cpuSeconds = secondsPerRun([&] {
+        LieAlgebraf::compose(quaternionView<const float>(lhs),
+                             quaternionView<const float>(rhs),
+                             quaternionView<float>(cpuQuaternions), count);
+      });
+      results[2].gpuSeconds = secondsPerRun([&] {
+        gpu.compose(quaternionView<const float>(lhs),
+                    quaternionView<const float>(rhs), count);
+        readBack(quaternionView<float>(gpuQuaternions));
+      });
+      results[2].difference = cpuQuaternions.maxDifference(gpuQuaternions);
+
+      for (std::size_t kernel = 0; kernel < 3; ++kernel) {
+        const Result &result = results[kernel];
+        std::printf("%-8s %8zu: CPU %10.1f us, GPU %10.1f us, max "
+                    "difference %.2e\n",
+                    names[kernel], count, result.cpuSeconds * 1e6,
+                    result.gpuSeconds * 1e6, result.difference);
+        if (crossover[kernel] == 0 && result.gpuSeconds < result.cpuSeconds) {
+          crossover[kernel] = count;
+        }
+        isAccurate &= result.difference <= TOLERANCE;
+      }
+    }
+
+    for (std::size_t kernel = 0; kernel < 3; ++kernel) {
+      if (crossover[kernel] == 0) {
+        std::printf("%-8s the CPU is faster up to %zu\n", names[kernel],
+                    maxCount);
+      } else {
+        std::printf("%-8s the GPU is faster from %zu\n", names[kernel],
+                    crossover[kernel]);
+      }
+    }
+  }
+
+  module.release();
+  device.release();
+  adapter.release();
+  instance.release();
+  if (!isRead) {
+    std::printf("A GPU read back failed\n");
+    return 1;
+  }
+  if (!isAccurate) {
+    std::printf("The GPU disagrees with the CPU by more than %.0e\n",
+                TOLERANCE);
+    return 1;
+  }
+  return 0;
+}
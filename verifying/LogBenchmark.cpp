@@ -0,0 +1,145 @@
+#include "LieAlgebra.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+// Compares a per matrix logarithmic map, Eigen's conversion to an angle and an
+// axis, against the structure of arrays batch kernel in double and single
+// precision, at every Accuracy, on the same set of rotations. The per matrix
+// LieAlgebra::logarithmicMap runs the batch kernel on one lane, so it is no
+// reference.
+
+namespace {
+
+constexpr std::size_t NUM_ROTATIONS = 1 << 20;
+constexpr int NUM_REPEATS = 10;
+
+template <class Function> double secondsPerRun(Function &&function) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_REPEATS; ++i) {
+    function();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count() / NUM_REPEATS;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 generator(42);
+  std::normal_distribution<double> normal;
+  std::uniform_real_distribution<double> uniform(0.0, M_PI);
+
+  // Mostly random rotations with a share of the theta = 0 and theta = pi edge
+  // cases so the batch kernel cannot win by skipping them
+  std::vector<Eigen::Matrix3d> matrices(NUM_ROTATIONS);
+  std::vector<Eigen::Vector3d> truth(NUM_ROTATIONS);
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    Eigen::Vector3d axis(normal(generator), normal(generator),
+                         normal(generator));
+    axis.normalize();
+    double angle = uniform(generator);
+    if (i % 16 == 0) {
+      angle = 0.0;
+    } else if (i % 16 == 1) {
+      angle = M_PI;
+    }
+    matrices[i] = Eigen::AngleAxisd(angle, axis).toRotationMatrix();
+    truth[i] = angle * axis;
+  }
+
+  std::array<std::vector<double>, 9> entries;
+  for (std::size_t k = 0; k < 9; ++k) {
+    entries[k].resize(NUM_ROTATIONS);
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      entries[k][i] = matrices[i].coeff(k / 3, k % 3);
+    }
+  }
+  std::array<std::vector<double>, 3> components;
+  for (auto &component : components) {
+    component.resize(NUM_ROTATIONS);
+  }
+  std::array<std::vector<float>, 9> entriesf;
+  for (std::size_t k = 0; k < 9; ++k) {
+    entriesf[k].assign(entries[k].begin(), entries[k].end());
+  }
+  std::array<std::vector<float>, 3> componentsf;
+  for (auto &component : componentsf) {
+    component.resize(NUM_ROTATIONS);
+  }
+
+  LieAlgebra::SO3Arrays<const double> SO3;
+  for (std::size_t k = 0; k < 9; ++k) {
+    SO3.entries[k] = entries[k].data();
+  }
+  LieAlgebra::TangentArrays<double> so3;
+  for (std::size_t k = 0; k < 3; ++k) {
+    so3.components[k] = components[k].data();
+  }
+  LieAlgebraf::SO3Arrays<const float> SO3f;
+  for (std::size_t k = 0; k < 9; ++k) {
+    SO3f.entries[k] = entriesf[k].data();
+  }
+  LieAlgebraf::TangentArrays<float> so3f;
+  for (std::size_t k = 0; k < 3; ++k) {
+    so3f.components[k] = componentsf[k].data();
+  }
+
+  std::vector<Eigen::Vector3d> perMatrixResults(NUM_ROTATIONS);
+  double perMatrix = secondsPerRun([&] {
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      Eigen::AngleAxisd angleAxis(matrices[i]);
+      perMatrixResults[i] = angleAxis.angle() * angleAxis.axis();
+    }
+  });
+
+  // theta = pi has two valid answers, so compare against both
+  auto error = [&](const Eigen::Vector3d &w, std::size_t i) {
+    return std::min((w - truth[i]).norm(), (w + truth[i]).norm());
+  };
+  double perMatrixError = 0.0;
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    perMatrixError = std::max(perMatrixError, error(perMatrixResults[i], i));
+  }
+
+  std::printf("SIMD width: %zu doubles\n", NativePack<double>::width);
+  std::printf("Per matrix:      %.3e rotations/s, max error %.3e\n",
+              NUM_ROTATIONS / perMatrix, perMatrixError);
+
+  // Every accuracy is its own instantiation of the batch kernels
+  auto benchmark = [&](auto constant, const char *name) {
+    constexpr Accuracy accuracy = decltype(constant)::value;
+    double batched = secondsPerRun([&] {
+      LieAlgebra::logarithmicMap<accuracy>(SO3, so3, NUM_ROTATIONS);
+    });
+    double batchedFloat = secondsPerRun([&] {
+      LieAlgebraf::logarithmicMap<accuracy>(SO3f, so3f, NUM_ROTATIONS);
+    });
+
+    double batchedError = 0.0;
+    double batchedFloatError = 0.0;
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      Eigen::Vector3d w(components[0][i], components[1][i], components[2][i]);
+      Eigen::Vector3d wf(componentsf[0][i], componentsf[1][i],
+                         componentsf[2][i]);
+      batchedError = std::max(batchedError, error(w, i));
+      batchedFloatError = std::max(batchedFloatError, error(wf, i));
+    }
+
+    std::printf("Batched (%5s): %.3e rotations/s, max error %.3e (%.2fx)\n",
+                name, NUM_ROTATIONS / batched, batchedError,
+                perMatrix / batched);
+    std::printf("Float   (%5s): %.3e rotations/s, max error %.3e (%.2fx)\n",
+                name, NUM_ROTATIONS / batchedFloat, batchedFloatError,
+                perMatrix / batchedFloat);
+  };
+  benchmark(std::integral_constant<Accuracy, Accuracy::Exact>(), "exact");
+  benchmark(std::integral_constant<Accuracy, Accuracy::High>(), "1e-7");
+  benchmark(std::integral_constant<Accuracy, Accuracy::Low>(), "1e-4");
+  return 0;
+}
@@ -1,16 +1,375 @@
-#include <iostream>
-#include <manif/impl/rn/Rn.h>
-#include <manif/impl/se3/SE3.h>
+#include "ErrorMetrics.hpp"
+#include "LieAlgebra.hpp"
+#include "Parallel.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <manif/impl/so3/SO3.h>
 #include <manif/impl/so3/SO3Tangent.h>
+#include <random>
+#include <vector>
 
-int main(){
+// Runs the LieAlgebra log, exp and compose against manif's SO3d on the same
+// rotations, reporting the time per operation, the throughput of each core and
+// the worst angular error against a long double ground truth. Exits with 1 if
+// any of LieAlgebra's errors is past TOLERANCE, so it can gate regressions in
+// speed and correctness alike.
 
-    manif::SO3d a{0,1,0, 0};
+namespace {
 
-    manif::SO3Tangentd SO3tan = a.log(); 
+constexpr std::size_t NUM_ROTATIONS = 1 << 20;
+constexpr int NUM_REPEATS = 5;
 
-    std::cout << SO3tan << std::endl;
+// Radians, a couple of thousand ulps of pi
+constexpr double TOLERANCE = 1e-12;
 
-    return 0;
-}
\ No newline at end of file
+// Rotations are dealt round robin from these, so every chunk of the batch
+// kernels sees the edge cases too
+enum Case { RANDOM, NEAR_ZERO, NEAR_PI, NUM_CASES };
+constexpr const char *CASE_NAMES[NUM_CASES] = {"random", "theta~0",
+                                               "theta~pi"};
+Case caseOf(std::size_t i) {
+  return i % 4 < 2 ? RANDOM : static_cast<Case>(i % 4 - 1);
+}
+
+using Vector3l = Eigen::Matrix<long double, 3, 1>;
+using Quaternionl = Eigen::Quaternion<long double>;
+
+template <class Function> double secondsPerRun(Function &&function) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_REPEATS; ++i) {
+    function();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count() / NUM_REPEATS;
+}
+
+// Every row of the report, errors split by case
+struct Measurement {
+  const char *operation;
+  const char *implementation;
+  double seconds;
+  std::size_t numThreads;
+  std::array<double, NUM_CASES> maxError;
+  bool isChecked;
+};
+
+std::array<double, NUM_CASES> maxByCase(const std::vector<double> &errors) {
+  std::array<double, NUM_CASES> maxError = {};
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    // A nan is as bad as it gets
+    double error = std::isnan(errors[i]) ? INFINITY : errors[i];
+    maxError[caseOf(i)] = std::max(maxError[caseOf(i)], error);
+  }
+  return maxError;
+}
+
+// Angle between each computed rotation and the truth
+std::vector<double> angularErrors(const std::array<std::vector<double>, 9> &R,
+                                  const std::array<std::vector<double>, 9> &T) {
+  RotationErrorMetrics::SO3Arrays<const double> estimate;
+  RotationErrorMetrics::SO3Arrays<const double> truth;
+  for (std::size_t k = 0; k < 9; ++k) {
+    estimate.entries[k] = R[k].data();
+    truth.entries[k] = T[k].data();
+  }
+  std::vector<double> geodesic(NUM_ROTATIONS);
+  std::vector<double> chordal(NUM_ROTATIONS);
+  RotationErrorMetrics::errors(estimate, truth, geodesic.data(),
+                               chordal.data(), NUM_ROTATIONS);
+  return geodesic;
+}
+
+void setMatrix(std::array<std::vector<double>, 9> &entries, std::size_t i,
+               const Eigen::Matrix3d &R) {
+  for (std::size_t k = 0; k < 9; ++k) {
+    entries[k][i] = R.coeff(k / 3, k % 3);
+  }
+}
+
+std::array<std::vector<double>, 9> matrixArrays() {
+  std::array<std::vector<double>, 9> entries;
+  for (std::vector<double> &entry : entries) {
+    entry.resize(NUM_ROTATIONS);
+  }
+  return entries;
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 generator(42);
+  std::normal_distribution<double> normal;
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  // Random rotations are uniform over SO3, the edge cases are logarithmically
+  // spread from 1e-16 to 1e-3 radians away from 0 and pi, hitting both
+  // exactly now and then
+  std::vector<Vector3l> tangents(NUM_ROTATIONS);
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    Vector3l axis(normal(generator), normal(generator), normal(generator));
+    axis.normalize();
+    long double offset =
+        i % 64 < 4 ? 0 : std::pow(10.0L, -16 + 13 * uniform(generator));
+    long double angle;
+    switch (caseOf(i)) {
+    case RANDOM: {
+      Quaternionl q(normal(generator), normal(generator), normal(generator),
+                    normal(generator));
+      q.normalize();
+      Eigen::AngleAxis<long double> axisAngle(q);
+      angle = axisAngle.angle();
+      axis = axisAngle.axis();
+      break;
+    }
+    case NEAR_ZERO:
+      angle = offset;
+      break;
+    default:
+      angle = M_PIl - offset;
+      break;
+    }
+    tangents[i] = angle * axis;
+  }
+
+  std::vector<Quaternionl> truth(NUM_ROTATIONS);
+  std::vector<Eigen::Matrix3d> matrices(NUM_ROTATIONS);
+  std::vector<Eigen::Vector3d> so3(NUM_ROTATIONS);
+  std::vector<Eigen::Quaterniond> quaternions(NUM_ROTATIONS);
+  std::vector<manif::SO3d> manifRotations(NUM_ROTATIONS);
+  std::vector<manif::SO3Tangentd> manifTangents(NUM_ROTATIONS);
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    long double angle = tangents[i].norm();
+    Vector3l axis = angle > 0 ? Vector3l(tangents[i] / angle)
+                              : Vector3l::UnitX();
+    truth[i] = Quaternionl(Eigen::AngleAxis<long double>(angle, axis));
+    matrices[i] = truth[i].toRotationMatrix().cast<double>();
+    so3[i] = tangents[i].cast<double>();
+    quaternions[i] = truth[i].cast<double>();
+    manifRotations[i] = manif::SO3d(quaternions[i]);
+    manifTangents[i] = manif::SO3Tangentd(so3[i]);
+  }
+
+  // Both sides of each composition come from the same set, the second one
+  // from the other end of it
+  auto other = [](std::size_t i) { return NUM_ROTATIONS - 1 - i; };
+
+  std::array<std::vector<double>, 9> expected = matrixArrays();
+  std::array<std::vector<double>, 9> expectedComposed = matrixArrays();
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    setMatrix(expected, i, matrices[i]);
+    Quaternionl composed = truth[i] * truth[other(i)];
+    setMatrix(expectedComposed, i,
+              composed.toRotationMatrix().cast<double>());
+  }
+
+  // The structure of arrays copies the batch kernels run on
+  std::array<std::vector<double>, 9> entries = matrixArrays();
+  std::array<std::vector<double>, 3> components;
+  std::array<std::vector<double>, 4> quaternionComponents;
+  std::array<std::vector<double>, 4> otherComponents;
+  for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+    setMatrix(entries, i, matrices[i]);
+  }
+  for (std::size_t k = 0; k < 3; ++k) {
+    components[k].resize(NUM_ROTATIONS);
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      components[k][i] = so3[i](k);
+    }
+  }
+  for (std::size_t k = 0; k < 4; ++k) {
+    quaternionComponents[k].resize(NUM_ROTATIONS);
+    otherComponents[k].resize(NUM_ROTATIONS);
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      // Eigen keeps w last, the arrays keep it first
+      quaternionComponents[k][i] = quaternions[i].coeffs()((k + 3) % 4);
+      otherComponents[k][i] = quaternions[other(i)].coeffs()((k + 3) % 4);
+    }
+  }
+  LieAlgebra::SO3Arrays<const double> SO3;
+  for (std::size_t k = 0; k < 9; ++k) {
+    SO3.entries[k] = entries[k].data();
+  }
+  LieAlgebra::TangentArrays<const double> tangentsIn;
+  for (std::size_t k = 0; k < 3; ++k) {
+    tangentsIn.components[k] = components[k].data();
+  }
+  LieAlgebra::QuaternionArrays<const double> lhs;
+  LieAlgebra::QuaternionArrays<const double> rhs;
+  for (std::size_t k = 0; k < 4; ++k) {
+    lhs.components[k] = quaternionComponents[k].data();
+    rhs.components[k] = otherComponents[k].data();
+  }
+
+  std::vector<Measurement> measurements;
+  std::size_t numThreads = ParallelDispatch::numThreads();
+  std::vector<double> errors(NUM_ROTATIONS);
+
+  // Logarithmic map, against the tangent it was made from. At theta = pi
+  // both w and -w are right.
+  auto logError = [&](const Eigen::Vector3d &w, std::size_t i) {
+    Vector3l difference = w.cast<long double>() - tangents[i];
+    Vector3l flipped = w.cast<long double>() + tangents[i];
+    long double error = difference.norm();
+    if (caseOf(i) == NEAR_PI) {
+      error = std::min(error, flipped.norm());
+    }
+    return static_cast<double>(error);
+  };
+  {
+    std::vector<Eigen::Vector3d> results(NUM_ROTATIONS);
+    double seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        results[i] = manifRotations[i].log().coeffs();
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      errors[i] = logError(results[i], i);
+    }
+    measurements.push_back(
+        {"log", "manif", seconds, 1, maxByCase(errors), false});
+
+    seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        results[i] = LieAlgebra::logarithmicMap(matrices[i]);
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      errors[i] = logError(results[i], i);
+    }
+    measurements.push_back(
+        {"log", "LieAlgebra", seconds, 1, maxByCase(errors), true});
+
+    std::array<std::vector<double>, 3> output;
+    LieAlgebra::TangentArrays<double> outputArrays;
+    for (std::size_t k = 0; k < 3; ++k) {
+      output[k].resize(NUM_ROTATIONS);
+      outputArrays.components[k] = output[k].data();
+    }
+    seconds = secondsPerRun(
+        [&] { LieAlgebra::logarithmicMap(SO3, outputArrays, NUM_ROTATIONS); });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      errors[i] = logError(
+          Eigen::Vector3d(output[0][i], output[1][i], output[2][i]), i);
+    }
+    measurements.push_back({"log", "LieAlgebra batch", seconds, numThreads,
+                            maxByCase(errors), true});
+  }
+
+  // Exponential map, against the matrix of the tangent
+  {
+    std::array<std::vector<double>, 9> output = matrixArrays();
+    std::vector<manif::SO3d> results(NUM_ROTATIONS);
+    double seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        results[i] = manifTangents[i].exp();
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      setMatrix(output, i, results[i].rotation());
+    }
+    measurements.push_back({"exp", "manif", seconds, 1,
+                            maxByCase(angularErrors(output, expected)),
+                            false});
+
+    std::vector<Eigen::Matrix3d> matrixResults(NUM_ROTATIONS);
+    seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        matrixResults[i] = LieAlgebra::exponentialMap(so3[i]);
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      setMatrix(output, i, matrixResults[i]);
+    }
+    measurements.push_back({"exp", "LieAlgebra", seconds, 1,
+                            maxByCase(angularErrors(output, expected)), true});
+
+    LieAlgebra::SO3Arrays<double> outputArrays;
+    for (std::size_t k = 0; k < 9; ++k) {
+      outputArrays.entries[k] = output[k].data();
+    }
+    seconds = secondsPerRun([&] {
+      LieAlgebra::exponentialMap(tangentsIn, outputArrays, NUM_ROTATIONS);
+    });
+    measurements.push_back({"exp", "LieAlgebra batch", seconds, numThreads,
+                            maxByCase(angularErrors(output, expected)), true});
+  }
+
+  // Composition, against the long double product
+  {
+    std::array<std::vector<double>, 9> output = matrixArrays();
+    std::vector<manif::SO3d> results(NUM_ROTATIONS);
+    double seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        results[i] = manifRotations[i].compose(manifRotations[other(i)]);
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      setMatrix(output, i, results[i].rotation());
+    }
+    measurements.push_back({"compose", "manif", seconds, 1,
+                            maxByCase(angularErrors(output, expectedComposed)),
+                            false});
+
+    std::vector<Eigen::Quaterniond> quaternionResults(NUM_ROTATIONS);
+    seconds = secondsPerRun([&] {
+      for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+        quaternionResults[i] =
+            LieAlgebra::compose(quaternions[i], quaternions[other(i)]);
+      }
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      setMatrix(output, i, quaternionResults[i].toRotationMatrix());
+    }
+    measurements.push_back({"compose", "LieAlgebra", seconds, 1,
+                            maxByCase(angularErrors(output, expectedComposed)),
+                            true});
+
+    std::array<std::vector<double>, 4> composed;
+    LieAlgebra::QuaternionArrays<double> composedArrays;
+    for (std::size_t k = 0; k < 4; ++k) {
+      composed[k].resize(NUM_ROTATIONS);
+      composedArrays.components[k] = composed[k].data();
+    }
+    seconds = secondsPerRun([&] {
+      LieAlgebra::compose(lhs, rhs, composedArrays, NUM_ROTATIONS);
+    });
+    for (std::size_t i = 0; i < NUM_ROTATIONS; ++i) {
+      setMatrix(output, i,
+                Eigen::Quaterniond(composed[0][i], composed[1][i],
+                                   composed[2][i], composed[3][i])
+                    .toRotationMatrix());
+    }
+    measurements.push_back({"compose", "LieAlgebra batch", seconds,
+                            numThreads,
+                            maxByCase(angularErrors(output, expectedComposed)),
+                            true});
+  }
+
+  std::printf("%zu rotations, %zu threads, SIMD width %zu doubles\n",
+              NUM_ROTATIONS, numThreads, NativePack<double>::width);
+  std::printf("%-8s %-17s %8s %12s", "", "", "ns/op", "Mop/s/core");
+  for (const char *name : CASE_NAMES) {
+    std::printf(" %10s", name);
+  }
+  std::printf("\n");
+
+  bool isPassing = true;
+  for (const Measurement &measurement : measurements) {
+    double rate = NUM_ROTATIONS / measurement.seconds;
+    std::printf("%-8s %-17s %8.2f %12.2f", measurement.operation,
+                measurement.implementation, 1e9 / rate,
+                rate / measurement.numThreads / 1e6);
+    bool isFailing = false;
+    for (double error : measurement.maxError) {
+      std::printf(" %10.2e", error);
+      isFailing |= measurement.isChecked && !(error <= TOLERANCE);
+    }
+    std::printf("%s\n", isFailing ? "  FAIL" : "");
+    isPassing &= !isFailing;
+  }
+  return isPassing ? 0 : 1;
+}